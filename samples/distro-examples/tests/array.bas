@@ -313,4 +313,60 @@ next i
 m[1,2,3,4,5,6]=999
 if (999 <> m[1,2,3,4,5,6]) then
   throw "e"
-endif
\ No newline at end of file
+endif
+rem --- assigned arrays and maps are copied when written
+a = [1, 2, [3, 4]]
+b = a
+b(0) = 10
+b(2)(1) = 40
+if (a(0) != 1 or a(2)(1) != 4) then throw "copy on write 1"
+if (b(0) != 10 or b(2)(1) != 40) then throw "copy on write 2"
+append b, 5
+delete b, 0
+c = [3, 1, 2]
+d = c
+sort d
+if (len(a) != 3 or len(b) != 3 or c(0) != 3 or d(0) != 1) then throw "copy on write 3"
+sub modify(byval x, byref y)
+  x(0) = 99
+  y(0) = 99
+end
+b = a
+modify(a, b)
+if (a(0) != 1 or b(0) != 99) then throw "copy on write 4"
+a = {"x": 1, "y": {"z": 2}}
+b = a
+b.x = 3
+b.y.z = 4
+if (a.x != 1 or a.y.z != 2 or b.x != 3 or b.y.z != 4) then throw "copy on write 5"
+a = [1, [2]]
+a(1)(0) = a
+a(0) = a
+if (str(a) != "[[1,[[1,[2]]]],[[1,[2]]]]") then throw "copy on write 6"
+rem --- a BYREF element is written into the array it came from
+dim p(3)
+p(1) = 1
+sub byref_copy(byref x)
+  q = p
+  x = 5
+  if (q(1) != 1) then throw "copy on write 7"
+end
+byref_copy p(1)
+if (p(1) != 5) then throw "copy on write 8"
+dim p(3)
+sub byref_write(byref x)
+  q = p
+  p(2) = 1
+  x = 5
+end
+byref_write p(1)
+if (str(p) != "[0,5,1,0]") then throw "copy on write 9"
+p = {"k": 1}
+sub byref_field(byref x)
+  q = p
+  p.z = 1
+  x = 42
+  if (q.k != 1) then throw "copy on write 10"
+end
+byref_field p.k
+if (p.k != 42) then throw "copy on write 11"
@@ -0,0 +1,50 @@
+'
+' CHAIN keeps the compiled sources in memory, the same source is
+' only compiled once
+'
+
+hits = fre(-60)
+misses = fre(-61)
+
+env "CHAINCOUNT=0"
+for i = 1 to 5
+  chain "env \"CHAINCOUNT=\" + (val(env(\"CHAINCOUNT\")) + 1)"
+next
+if (env("CHAINCOUNT") <> "5") then throw "count: " + env("CHAINCOUNT")
+if (fre(-61) - misses <> 1) then throw "misses: " + (fre(-61) - misses)
+if (fre(-60) - hits <> 4) then throw "hits: " + (fre(-60) - hits)
+
+' the lines of an array
+dim code
+code << "n = 0"
+code << "for i = 1 to 10"
+code << "  n = n + i"
+code << "next"
+code << "env \"CHAINSUM=\" + n"
+for i = 1 to 3
+  chain code
+next
+if (env("CHAINSUM") <> "55") then throw "sum: " + env("CHAINSUM")
+if (fre(-61) - misses <> 2) then throw "array misses"
+
+' more sources than the cache holds
+for i = 1 to 40
+  chain "env \"CHAINLAST=" + i + "\""
+  chain "env \"CHAINLAST=" + i + "\""
+next
+if (env("CHAINLAST") <> "40") then throw "last"
+if (fre(-61) - misses <> 42) then throw "evicted misses: " + (fre(-61) - misses)
+
+' a source is compiled again when a file it includes was changed
+open "chaininc.bas" for output as #1: print #1, "env \"CHAININC=v1\"": close #1
+chain "include \"chaininc.bas\""
+open "chaininc.bas" for output as #1: print #1, "env \"CHAININC=v2\"": close #1
+chain "include \"chaininc.bas\""
+kill "chaininc.bas"
+if (env("CHAININC") <> "v2") then throw "include: " + env("CHAININC")
+
+' the OPTIONs of a cached source are applied again
+chain "option predef command first" + chr(10) + "env \"CHAINCMD=\" + command"
+chain "option predef command second" + chr(10) + "env \"CHAINCMD=\" + command"
+chain "option predef command first" + chr(10) + "env \"CHAINCMD=\" + command"
+if (env("CHAINCMD") <> "FIRST") then throw "option: " + env("CHAINCMD")
@@ -0,0 +1,22 @@
+'
+' compiler benchmarks
+'
+
+n=20000
+tickspersec=1000
+nl=chr(10)
+
+' 100k lines declaring n variables, labels and subs
+src=""
+for i=1 to n
+  src = src + "v" + i + "=" + i + nl
+  src = src + "label l" + i + nl
+  src = src + "sub p" + i + nl
+  src = src + "v" + i + "=v" + i + "+1" + nl
+  src = src + "end" + nl
+next
+
+st=ticks
+chain src
+et=ticks
+? "COMPILE: "; ((et-st)/tickspersec); "sec "; round(5*n/((et-st+1)/tickspersec));" lines/s"
@@ -0,0 +1,64 @@
+'
+' walk a small tree with and without stat, and with the prefetch threads
+'
+
+base = "dirwalk.tmp"
+dirs = [base, base + "/a", base + "/a/b", base + "/c"]
+names = [base + "/one.txt", base + "/a/two.txt", base + "/a/b/three.bas", base + "/c/four.txt"]
+
+for d in dirs
+  if (not isdir(d)) then mkdir d
+next
+for f in names
+  open f for output as #1
+  print #1, "hello"
+  close #1
+next
+
+func visit(x)
+  seen << x
+  visit = true
+end
+
+sub check(flags, expect_stat)
+  local e, n_dir, n_file
+  seen = []
+  dirwalk base, "", flags use visit(x)
+  if (len(seen) <> 7) then throw "count " + flags + ": " + len(seen)
+  for e in seen
+    if (e.dir) then
+      n_dir++
+    else
+      n_file++
+      if (expect_stat and e.size <> 6) then throw "size " + e.name + ": " + e.size
+    fi
+    if (isarray(e.mtime) and expect_stat) then throw "mtime " + e.name
+    if (e.name = "three.bas" and (e.depth <> 2 or right(e.path, 3) <> "a/b")) then throw "entry " + e
+  next
+  if (n_dir <> 3 or n_file <> 4) then throw "type " + flags
+end
+
+check 0, true
+check 1, false
+check 2, true
+check 3, false
+
+' the wildcards and stopping
+seen = []
+dirwalk base, "*.txt" use visit(x)
+if (len(seen) <> 3) then throw "wildcards: " + len(seen)
+
+func halt(x)
+  seen << x
+  halt = (x.depth > 0)
+end
+seen = []
+dirwalk base, "", 2 use halt(x)
+if (len(seen) < 1 or len(seen) > 7) then throw "halt: " + len(seen)
+
+for f in names
+  kill f
+next
+for i = len(dirs) - 1 to 0 step -1
+  rmdir dirs(i)
+next
@@ -0,0 +1,41 @@
+'
+' command dispatch benchmarks, loops of cheap commands
+'
+
+n=3000000
+tickspersec=1000
+
+sub report(name, cmds, st, et)
+  ? name; ": "; ((et-st)/tickspersec); "sec "; round(cmds/((et-st+1)/tickspersec)/1e6, 2); " Mcmd/s"
+end
+
+st=ticks
+for i=1 to n:next
+et=ticks
+report "FOR/NEXT", 2*n, st, et
+
+st=ticks
+i=0
+label l1
+i=i+1
+if i<n then goto l1
+et=ticks
+report "GOTO", 3*n, st, et
+
+st=ticks
+for i=1 to n
+  x=i
+  y=x
+  rem nothing
+  if x=y then z=1 else z=0
+next
+et=ticks
+report "LET/IF", 7*n, st, et
+
+st=ticks
+i=0
+while i<n
+  i++
+wend
+et=ticks
+report "WHILE", 3*n, st, et
@@ -0,0 +1,31 @@
+'
+' FOR-TO-NEXT with integer and real counters
+'
+n=5
+for i=1 to 10 step 2: ? i;: next: ?
+for j=n to -1 step -1: ? j;: next: ?
+
+' TO variable changed inside the loop
+for k=1 to n: ? k;: n=n-1: next: ?
+
+' counter becomes real inside the loop
+for k=1 to 3: ? k;: k = k + 0.5: next: ?
+
+for k=1 to 3
+  for m=k to 3 step 2
+    ? k*10+m;
+  next
+next
+?
+for k=10 to 1: ? "ERROR": next
+for k=1 to 3: if k=2 then exit for
+next
+? k
+for q = 1 to 5 step 2.5: ? q;: next: ?
+
+sub foo(x)
+  local i
+  for i = 1 to x: ? i;: next
+end
+foo(4): ?
+for i = 0 to 20 step 5: ? i;: next: ?
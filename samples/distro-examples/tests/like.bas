@@ -0,0 +1,57 @@
+'
+' wildcard patterns are compiled once and kept in a cache, repeat the
+' matches so that the cached patterns are used
+'
+
+sub expect(text, pattern, result)
+  if ((text like pattern) <> result) then
+    throw "[" + text + "] like [" + pattern + "] <> " + result
+  fi
+end
+
+for i = 1 to 3
+  expect "hello", "hello", true
+  expect "hello", "hell", false
+  expect "hello", "h?llo", true
+  expect "hello", "h*", true
+  expect "hello", "*o", true
+  expect "hello", "*x*", false
+  expect "hello", "h*l*o", true
+  expect "", "*", true
+  expect "a", "", true
+  expect "b5", "[a-c][0-9]", true
+  expect "d5", "[a-c][0-9]", false
+  expect "d5", "[!a-c]?", true
+  expect "b5", "[^a-c]?", false
+  expect "c", "[c-a]", true
+  expect "*", "\\*", true
+  expect "x", "\\*", false
+  expect "a]", "[\\]a]]", true
+  expect "x[", "*\\[", true
+  expect "ab", "[ab", false
+next
+
+' more patterns than the cache holds
+for i = 1 to 40
+  expect "item" + i, "item" + i, true
+  expect "item" + i, "item[!0-9]*", false
+next
+
+' every element of an array must match
+if (not (["a.bas", "b.bas"] like "*.bas")) then throw "array"
+if (["a.bas", "b.txt"] like "*.bas") then throw "array mismatch"
+
+' CAPTURE returns the whole text then each ?, * and [..] group
+m = capture("2020-02-13 INFO start", "*-??-* * *")
+if (len(m) <> 7) then throw "capture count: " + len(m)
+if (m(0).text <> "2020-02-13 INFO start" or m(0).pos <> 1) then throw "capture 0"
+if (m(1).text <> "2020") then throw "capture 1: " + m(1).text
+if (m(2).text <> "0" or m(2).pos <> 6) then throw "capture 2"
+if (m(3).text <> "2" or m(3).pos <> 7) then throw "capture 3"
+if (m(4).text <> "13") then throw "capture 4: " + m(4).text
+if (m(5).text <> "INFO" or m(5).pos <> 12) then throw "capture 5"
+if (m(6).text <> "start" or m(6).pos <> 17) then throw "capture 6"
+
+m = capture("key=42", "key=[0-9]*")
+if (m(1).text + m(2).text <> "42") then throw "capture set"
+if (len(capture("abc", "x*")) <> 0) then throw "capture mismatch"
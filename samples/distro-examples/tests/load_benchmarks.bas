@@ -0,0 +1,40 @@
+'
+' compiled program cache benchmarks
+'
+
+n=2000
+tickspersec=1000
+nl=chr(10)
+
+' a program with an OPTION and an INCLUDE, each load checks the
+' included file and applies the option
+open "loadinc.bas" for output as #1
+for i=1 to 500
+  print #1, "sub inc" + i
+  print #1, "  v = v + " + i
+  print #1, "end"
+next
+close #1
+
+open "loadprog.bas" for output as #1
+print #1, "option predef command load"
+print #1, "include \"loadinc.bas\""
+for i=1 to 2000
+  print #1, "v" + i + "=" + i
+next
+close #1
+
+st=ticks
+chain "loadprog.bas"
+et=ticks
+? "LOAD COLD: "; (et-st); "ms"
+
+st=ticks
+for i=1 to n
+  chain "loadprog.bas"
+next
+et=ticks
+? "LOAD WARM: "; round((et-st)/n, 3); "ms "; round(n/((et-st+1)/tickspersec)); " loads/s"
+
+kill "loadinc.bas"
+kill "loadprog.bas"
@@ -0,0 +1,44 @@
+'
+' MAP (dictionary) benchmarks
+'
+
+n=100000
+tickspersec=1000
+
+st=ticks
+m={}
+for i=1 to n
+  m["key" + i] = i
+next
+et=ticks
+? "MAP insert: "; ((et-st)/tickspersec); "sec "; round(n/((et-st+1)/tickspersec));" keys/s"
+
+st=ticks
+s=0
+for i=1 to n
+  s += m["key" + i]
+next
+et=ticks
+? "MAP lookup: "; ((et-st)/tickspersec); "sec "; round(n/((et-st+1)/tickspersec));" keys/s"
+
+st=ticks
+c=0
+for k in m
+  c++
+next
+et=ticks
+? "MAP for-in: "; ((et-st)/tickspersec); "sec "; round(c/((et-st+1)/tickspersec));" keys/s"
+
+st=ticks
+mm={}
+for i=1 to n / 10
+  r={}
+  for j=1 to 10
+    r["field" + j] = j
+  next
+  mm["row" + i] = r
+next
+et=ticks
+? "MAP of maps: "; ((et-st)/tickspersec); "sec "; round(n/((et-st+1)/tickspersec));" keys/s"
+? "Variables: "; fre(-50); " in use, "; fre(-51); " peak, "; fre(-52); " pooled, "; fre(-53); " slabs"
+
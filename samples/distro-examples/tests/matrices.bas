@@ -44,3 +44,53 @@ a1=[1,2,4]
 a2=[1,4,5]
 if (a1 * a2 != [1,8,20]) then throw "err"
 if (a1 % a2 != 29) then throw "err"
+
+rem -- the blocked kernels give the same results as the textbook loops
+sub check_product(n, m, p)
+  local a, b, c, i, j, k, s
+  dim a(n - 1, m - 1), b(m - 1, p - 1)
+  for i = 0 to n - 1
+    for j = 0 to m - 1
+      a(i, j) = ((i * 7 + j * 3) mod 11) - 5 + j / 4
+    next
+  next
+  for i = 0 to m - 1
+    for j = 0 to p - 1
+      b(i, j) = ((i * 5 + j * 2) mod 13) - 6
+    next
+  next
+  c = a * b
+  for i = 0 to n - 1
+    for j = 0 to p - 1
+      s = 0
+      for k = 0 to m - 1
+        s = s + a(i, k) * b(k, j)
+      next
+      if (c(i, j) != s) then throw "product " + n + "x" + m + "x" + p
+    next
+  next
+end
+check_product 3, 5, 2
+check_product 70, 65, 130
+
+a = [1, 2, 3; 4, 5, 6]
+if (transpose(a) != [1, 4; 2, 5; 3, 6]) then throw "transpose"
+a = [1, 2, 3]
+if (transpose(a) != [1; 2; 3]) then throw "transpose 1d"
+
+rem -- determinant and inverse above the expansion size
+a = [2, 0, 0, 0, 0, 1; 0, 3, 0, 0, 0, 0; 0, 0, 1, 0, 0, 0; 0, 0, 0, 4, 0, 0; 0, 0, 0, 0, 5, 0; 1, 0, 0, 0, 0, 1]
+if (abs(determ(a) - 60) > 1e-9) then throw "determ " + determ(a)
+b = [1, 2; 2, 4]
+if (determ(b) != 0) then throw "singular"
+dim b(199, 199)
+for i = 0 to 199
+  b(i, i) = 10
+next
+if (not (abs(determ(b) / 1e200 - 1) < 1e-9)) then throw "determ " + determ(b)
+b = a * inverse(a)
+for i = 0 to 5
+  for j = 0 to 5
+    if (abs(b(i, j) - iff(i = j, 1, 0)) > 1e-9) then throw "inverse"
+  next
+next
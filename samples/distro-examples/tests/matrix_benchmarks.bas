@@ -0,0 +1,56 @@
+'
+' MATRIX benchmarks
+'
+
+tickspersec=1000
+
+sub fill(byref m, n, seed)
+  local i, j
+  dim m(n - 1, n - 1)
+  for i = 0 to n - 1
+    for j = 0 to n - 1
+      m(i, j) = ((i * seed + j * 7) mod 17) - 8 + iff(i = j, n, 0)
+    next
+  next
+end
+
+n = 64
+while n <= 2048
+  fill a, n, 3
+  fill b, n, 5
+
+  st=ticks
+  c = a * b
+  et=ticks
+  ? "MATRIX "; n; " multiply: "; ((et-st)/tickspersec); "sec "; round(2*n*n*n/((et-st+1)/tickspersec)/1e6);" MFLOPS"
+
+  st=ticks
+  c = a + b
+  et=ticks
+  ? "MATRIX "; n; " add: "; ((et-st)/tickspersec); "sec"
+
+  st=ticks
+  c = transpose(a)
+  et=ticks
+  ? "MATRIX "; n; " transpose: "; ((et-st)/tickspersec); "sec"
+
+  if (n <= 1024) then
+    st=ticks
+    c = inverse(a)
+    et=ticks
+    ? "MATRIX "; n; " inverse: "; ((et-st)/tickspersec); "sec"
+
+    st=ticks
+    d = determ(a)
+    et=ticks
+    ? "MATRIX "; n; " determ: "; ((et-st)/tickspersec); "sec"
+  fi
+  n = n * 2
+wend
+
+a = seq(1, 1000000, 1000000)
+b = seq(1, 1000000, 1000000)
+st=ticks
+d = a % b
+et=ticks
+? "VECTOR 1000000 dot: "; ((et-st)/tickspersec); "sec"
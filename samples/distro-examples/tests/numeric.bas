@@ -0,0 +1,71 @@
+option predef optimize
+'
+' when optimizing, operations between two plain variables or constants are
+' computed directly when both sides are numbers. compare the results with the
+' generic code, the parenthesis prevent the direct path
+'
+
+sub expect(a, b, msg)
+  if (a <> b or isnumber(a) <> isnumber(b) or isstring(a) <> isstring(b)) then
+    throw msg + ": " + a + " <> " + b
+  fi
+end
+
+values = [0, 1, -1, 7, -7, 2.5, -2.5, 1e10, "3", "x", ""]
+for i = 0 to len(values) - 1
+  for j = 0 to len(values) - 1
+    a = values(i)
+    b = values(j)
+    msg = "[" + a + "] [" + b + "] "
+    expect a + b, (a) + (b), msg + "+"
+    expect a - b, (a) - (b), msg + "-"
+    expect a < b, (a) < (b), msg + "<"
+    expect a <= b, (a) <= (b), msg + "<="
+    expect a > b, (a) > (b), msg + ">"
+    expect a >= b, (a) >= (b), msg + ">="
+    expect a = b, (a) = (b), msg + "="
+    expect a <> b, (a) <> (b), msg + "<>"
+    if (isnumber(a) and isnumber(b)) then
+      expect a * b, (a) * (b), msg + "*"
+      if (b = int(b) and abs(b) < 10 and (a <> 0 or b >= 0)) then
+        expect a ^ b, (a) ^ (b), msg + "^"
+      fi
+      if (b <> 0) then
+        expect a / b, (a) / (b), msg + "/"
+      fi
+      if (int(b) <> 0) then
+        expect a \ b, (a) \ (b), msg + "\\"
+        expect a mod b, (a) mod (b), msg + "mod"
+        expect a % b, (a) % (b), msg + "%"
+      fi
+    fi
+  next
+next
+
+' constants on either side
+n = 5
+expect n + 1, (n) + (1), "n + 1"
+expect 1 - n, (1) - (n), "1 - n"
+expect n * 0.5, (n) * (0.5), "n * 0.5"
+expect n < 10, (n) < (10), "n < 10"
+expect 2 ^ n, (2) ^ (n), "2 ^ n"
+
+' the variable changes type
+x = 1
+x = x + 1
+x = "a"
+x = x + 1
+expect x, "a1", "string"
+x = [1, 2]
+x = x + [3, 4]
+if (x(0) <> 4 or x(1) <> 6) then throw "array"
+
+' errors are raised by the generic code
+caught = false
+try
+  zero = 0
+  x = n / zero
+catch
+  caught = true
+end try
+if (not caught) then throw "division by zero"
@@ -0,0 +1,53 @@
+option predef optimize
+'
+' constant expressions are folded by the compiler, compare the results with
+' the same expressions evaluated at run-time
+'
+
+sub expect(a, b, msg)
+  if (a <> b or isnumber(a) <> isnumber(b) or frac(a) <> frac(b)) then
+    throw msg + ": " + a + " <> " + b
+  fi
+end
+
+one = 1: two = 2: three = 3: seven = 7: zero = 0
+
+expect 2 * 3, two * three, "mul"
+expect 2 * PI / 360, two * pi / 360, "pi"
+expect 1 / 3, one / three, "div"
+expect 7 \ 2, seven \ two, "idiv"
+expect -7 mod 3, -seven mod three, "mod"
+expect 7 mdl -3, seven mdl -three, "mdl"
+expect 5 - 2.5, 5 - two - 0.5, "sub"
+expect -2 ^ 2, -two ^ two, "pow"
+expect 2 ^ 3 ^ 2, two ^ three ^ two, "pow"
+expect 1 + 2 * 3 - 4, one + two * three - 4, "precedence"
+expect (1 + 2) * 3, (one + two) * three, "parenthesis"
+expect 1 < 2, one < two, "lt"
+expect 2 <= 1, two <= one, "le"
+expect 1 = 1.0, one = one * 1.0, "eq"
+expect 1 <> 2, one <> two, "ne"
+expect not 0, not zero, "not"
+expect ~5, ~(two + three), "inv"
+expect 1 and 0, one and zero, "and"
+expect 3 or 0, three or zero, "or"
+expect 6 band 3, (two * three) band three, "band"
+expect 6 xor 3, (two * three) xor three, "xor"
+expect 10 + (0 and 1), 10 + (zero and one), "shortcut"
+expect sin(1), sin(one), "sin"
+expect sqr(2), sqr(two), "sqr"
+expect int(-2.5), int(-two - 0.5), "int"
+expect sgn(-3), sgn(-three), "sgn"
+expect abs(-3), abs(-three), "abs"
+expect true, one = 1, "true"
+expect false, one = 0, "false"
+expect rad(180), pi, "rad"
+
+' errors are left for run-time
+caught = false
+try
+  x = 1 / 0
+catch
+  caught = true
+end try
+if (not caught) then throw "division by zero"
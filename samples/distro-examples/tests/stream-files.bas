@@ -30,6 +30,37 @@ WHILE NOT EOF(F)
 WEND
 CLOSE #F
 
+' Buffer size, SEEK and LOF with pending output
+OPEN "test.dat" FOR OUTPUT AS #F, 4
+FOR i = 1 TO 5
+  PRINT #F, "row "; i
+NEXT
+PRINT "LOF=";LOF(F)
+CLOSE #F
+
+OPEN "test.dat" FOR INPUT AS #F, 0
+LINEINPUT #F, a$
+PRINT "NL=[";a$;"] SEEK=";SEEK(F)
+CLOSE #F
+
+OPEN "test.dat" FOR INPUT AS #F
+LINEINPUT #F, a$
+PRINT "NL=[";a$;"] SEEK=";SEEK(F)
+SEEK #F, 18
+LINEINPUT #F, a$
+PRINT "NL=[";a$;"] EOF=";EOF(F)
+WHILE NOT EOF(F)
+	LINEINPUT #F, a$
+WEND
+PRINT "NL=[";a$;"]"
+CLOSE #F
+
+' TLOAD lines and whole text
+TLOAD "test.dat", lines
+PRINT LEN(lines);" lines, last=[";lines(4);"]"
+TLOAD "test.dat", text, 1
+PRINT LEN(text);" chars"
+
 # find main.cpp in the console folder
 has_main = false
 func walker(node)
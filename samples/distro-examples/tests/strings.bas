@@ -189,3 +189,39 @@ for c in s1
 next c
 if (s1 <> s2) then throw s2
 
+
+REM string concatenation and STRING$ use the stored length
+s = "ab"
+s = s + s
+s = s + s + "x"
+if (s <> "ababababx") then throw s
+s = s + 1 + 2
+if (s <> "ababababx12") then throw s
+s = "1"
+s = s + 2
+if (s <> 3) then throw s
+func grow_s
+  s = "new"
+  s = s + "er"
+  grow_s = s
+end
+s = "old"
+s = s + grow_s() + s
+if (s <> "oldnewernewer") then throw s
+s = ""
+for i = 1 to 1000
+  s = s + chr(65 + i mod 26)
+next
+if (len(s) <> 1000 or mid(s, 999, 2) <> "LM") then throw s
+if (string$(3, "ab") <> "ababab") then throw "string$"
+s = string$(4, 0)
+if (len(s) <> 4 or asc(mid(s, 4, 1)) <> 0) then throw "string$"
+if ("a" + (0 and 1) <> "a0") then throw "shortcut"
+s = "ab"
+s = s + "c"
+s = s + "X" + s
+if (s <> "abcXabc") then throw s
+s = "ab"
+s = s + s
+s = s + mid(s, 2, 2) + s
+if (s <> "ababbaabab") then throw s
@@ -0,0 +1,34 @@
+'
+' variables are allocated from a pool which grows in slabs,
+' the allocator statistics are reported by FRE(-50) to FRE(-54)
+'
+
+in_use = fre(-50)
+allocs = fre(-54)
+if (in_use <= 0 or fre(-51) < in_use or fre(-52) < in_use) then throw "stats"
+
+' each map entry holds a key and a value variable
+m = {}
+for i = 1 to 20000
+  m[i] = {}
+  m[i].a = i
+next
+if (fre(-50) < in_use + 80000) then throw "in use: " + fre(-50)
+if (fre(-53) < 1) then throw "slabs: " + fre(-53)
+if (fre(-54) - allocs < 80000) then throw "allocs: " + fre(-54)
+if (fre(-52) < fre(-50)) then throw "capacity: " + fre(-52)
+peak = fre(-51)
+
+' the variables are returned to the pool but the slabs are kept
+m = 0
+if (fre(-50) > in_use + 10) then throw "released: " + fre(-50)
+if (fre(-51) <> peak) then throw "peak: " + fre(-51)
+if (fre(-53) < 1) then throw "kept: " + fre(-53)
+
+' the pool is reused
+m = {}
+for i = 1 to 20000
+  m[i] = {}
+  m[i].a = i
+next
+if (fre(-51) > peak + 10) then throw "reused: " + fre(-51)
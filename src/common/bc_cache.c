@@ -0,0 +1,332 @@
+// This file is part of SmallBASIC
+//
+// Compiled program cache directory
+//
+// Each entry is named after a hash of the source text and the search paths,
+// and holds a manifest of the files the compiler read and the directives
+// which change the environment of the program, followed by the bytecode.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#include "common/sys.h"
+#include "common/smbas.h"
+#include "common/bc_cache.h"
+#include "common/scan.h"
+
+#define CACHE_SIGN "SBCd"
+#define CACHE_EXT ".sbc"
+#define FNV_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define CACHE_MAX_DEPS 4096
+
+typedef struct cache_head_t {
+  char sign[4];
+  uint32_t version;
+  uint32_t dep_count;
+  uint32_t options_len;
+  uint32_t bc_size;
+} cache_head_t;
+
+typedef struct cache_dep_t {
+  uint64_t hash;
+  uint32_t size;
+  uint32_t name_len;
+} cache_dep_t;
+
+typedef struct dep_rec_t {
+  char *name;
+  uint64_t hash;
+  uint32_t size;
+} dep_rec_t;
+
+struct bc_cache_deps_t {
+  dep_rec_t *deps;
+  int count;
+  // each directive is stored as the kind followed by the text and '\n'
+  char *options;
+  uint32_t options_len;
+  // the search paths when the compiler started
+  uint64_t paths;
+};
+
+static SB_THREAD_LOCAL bc_cache_deps_t *recorded;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, uint32_t size) {
+  const byte *p = (const byte *)data;
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * hashes the file contents, returns 0 when the file cannot be read
+ */
+static int hash_file(const char *file, uint64_t hash, uint64_t *result, uint32_t *size) {
+  int h = open(file, O_BINARY | O_RDONLY);
+  if (h == -1) {
+    return 0;
+  }
+  char buf[8192];
+  int len;
+  *size = 0;
+  while ((len = read(h, buf, sizeof(buf))) > 0) {
+    hash = hash_bytes(hash, buf, len);
+    *size += len;
+  }
+  close(h);
+  *result = hash;
+  return len == 0;
+}
+
+/**
+ * hashes the paths used to find INCLUDE files, units and modules
+ */
+static uint64_t hash_paths() {
+  char cwd[OS_PATHNAME_SIZE + 1];
+  const char *sbasicpath = getenv("SBASICPATH");
+  uint64_t hash = FNV_BASIS;
+  if (sbasicpath != NULL) {
+    hash = hash_bytes(hash, sbasicpath, strlen(sbasicpath) + 1);
+  }
+  hash = hash_bytes(hash, opt_modpath, strlen(opt_modpath) + 1);
+  if (getcwd(cwd, sizeof(cwd)) != NULL) {
+    hash = hash_bytes(hash, cwd, strlen(cwd));
+  }
+  return hash;
+}
+
+/**
+ * builds the name of the entry for the given source file
+ */
+static int cache_entry_name(const char *file, uint64_t paths, char *name, int size) {
+  uint64_t hash = FNV_BASIS;
+  uint32_t ver = SB_DWORD_VER;
+  uint32_t len;
+  hash = hash_bytes(hash, &ver, sizeof(ver));
+  hash = hash_bytes(hash, &opt_optimize, sizeof(opt_optimize));
+  hash = hash_bytes(hash, gsb_bas_dir, strlen(gsb_bas_dir));
+  hash = hash_bytes(hash, &paths, sizeof(paths));
+  if (!hash_file(file, hash, &hash, &len)) {
+    return 0;
+  }
+  snprintf(name, size, "%s/%016llx%s", opt_cache_dir, (unsigned long long)hash, CACHE_EXT);
+  return 1;
+}
+
+void bc_cache_begin() {
+  bc_cache_deps_free(recorded);
+  recorded = (bc_cache_deps_t *)calloc(1, sizeof(bc_cache_deps_t));
+  recorded->paths = hash_paths();
+}
+
+void bc_cache_depend(const char *file) {
+  if (recorded != NULL) {
+    for (int i = 0; i < recorded->count; i++) {
+      if (strcmp(recorded->deps[i].name, file) == 0) {
+        return;
+      }
+    }
+    dep_rec_t dep;
+    if (strlen(file) > OS_PATHNAME_SIZE ||
+        !hash_file(file, FNV_BASIS, &dep.hash, &dep.size)) {
+      // unable to verify this program later
+      bc_cache_deps_free(recorded);
+      recorded = NULL;
+    } else {
+      int count = recorded->count;
+      dep.name = strdup(file);
+      recorded->deps = (dep_rec_t *)realloc(recorded->deps, (count + 1) * sizeof(dep_rec_t));
+      recorded->deps[count] = dep;
+      recorded->count++;
+    }
+  }
+}
+
+void bc_cache_option(char kind, const char *text) {
+  if (recorded != NULL) {
+    uint32_t len = 0;
+    while (text[len] != '\0' && text[len] != '\n') {
+      len++;
+    }
+    uint32_t size = recorded->options_len;
+    recorded->options = (char *)realloc(recorded->options, size + len + 2);
+    recorded->options[size] = kind;
+    memcpy(recorded->options + size + 1, text, len);
+    recorded->options[size + len + 1] = '\n';
+    recorded->options_len += len + 2;
+  }
+}
+
+void bc_cache_apply(const bc_cache_deps_t *deps) {
+  char line[SB_SOURCELINE_SIZE + 1];
+  const char *options = deps->options;
+  const char *end = options + deps->options_len;
+
+  // each directive is terminated by '\n'
+  while (options < end) {
+    const char *next = memchr(options, '\n', end - options);
+    if (next == NULL) {
+      break;
+    }
+    uint32_t size = next - options;
+    if (size > 0 && size < SB_SOURCELINE_SIZE) {
+      // the text without the kind, the parsers expect the '\n'
+      memcpy(line, options + 1, size);
+      line[size] = '\0';
+      switch (options[0]) {
+      case BC_CACHE_OPTION:
+        comp_preproc_options(line);
+        break;
+      case BC_CACHE_SBASICPATH:
+        comp_preproc_sbasicpath(line);
+        break;
+      case BC_CACHE_SHOWPAGE:
+        opt_show_page = 1;
+        break;
+      }
+    }
+    options = next + 1;
+  }
+}
+
+bc_cache_deps_t *bc_cache_end() {
+  bc_cache_deps_t *result = recorded;
+  recorded = NULL;
+  return result;
+}
+
+int bc_cache_deps_changed(const bc_cache_deps_t *deps) {
+  for (int i = 0; i < deps->count; i++) {
+    uint64_t hash;
+    uint32_t size;
+    if (!hash_file(deps->deps[i].name, FNV_BASIS, &hash, &size) ||
+        hash != deps->deps[i].hash || size != deps->deps[i].size) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void bc_cache_deps_free(bc_cache_deps_t *deps) {
+  if (deps != NULL) {
+    for (int i = 0; i < deps->count; i++) {
+      free(deps->deps[i].name);
+    }
+    free(deps->deps);
+    free(deps->options);
+    free(deps);
+  }
+}
+
+bc_cache_deps_t *bc_cache_dir_load(const char *file) {
+  char name[OS_PATHNAME_SIZE + 32];
+  cache_head_t head;
+  int result = 0;
+
+  if (!cache_entry_name(file, hash_paths(), name, sizeof(name))) {
+    return NULL;
+  }
+  int h = open(name, O_BINARY | O_RDONLY);
+  if (h == -1) {
+    return NULL;
+  }
+  bc_cache_deps_t *deps = (bc_cache_deps_t *)calloc(1, sizeof(bc_cache_deps_t));
+  if (read(h, &head, sizeof(head)) == sizeof(head) &&
+      memcmp(head.sign, CACHE_SIGN, 4) == 0 &&
+      head.version == SB_DWORD_VER &&
+      head.dep_count <= CACHE_MAX_DEPS) {
+    result = 1;
+    deps->deps = (dep_rec_t *)malloc(head.dep_count * sizeof(dep_rec_t) + 1);
+    for (uint32_t i = 0; i < head.dep_count && result; i++) {
+      cache_dep_t dep;
+      char dep_name[OS_PATHNAME_SIZE + 1];
+      if (read(h, &dep, sizeof(dep)) != sizeof(dep) ||
+          dep.name_len > OS_PATHNAME_SIZE ||
+          read(h, dep_name, dep.name_len) != (int)dep.name_len) {
+        result = 0;
+      } else {
+        dep_name[dep.name_len] = '\0';
+        deps->deps[i].name = strdup(dep_name);
+        deps->deps[i].hash = dep.hash;
+        deps->deps[i].size = dep.size;
+        deps->count++;
+      }
+    }
+    if (result && !bc_cache_deps_changed(deps) && head.bc_size >= sizeof(bc_head_t)) {
+      byte *bytecode = malloc(head.bc_size);
+      deps->options = malloc(head.options_len + 1);
+      deps->options_len = head.options_len;
+      if (read(h, deps->options, head.options_len) == (int)head.options_len &&
+          read(h, bytecode, head.bc_size) == (int)head.bc_size &&
+          ((bc_head_t *)bytecode)->size == head.bc_size) {
+        ctask->bytecode = bytecode;
+        ctask->bc_type = 1;
+        bc_cache_apply(deps);
+      } else {
+        free(bytecode);
+        result = 0;
+      }
+    } else {
+      result = 0;
+    }
+  }
+  close(h);
+  if (!result) {
+    bc_cache_deps_free(deps);
+    deps = NULL;
+  }
+  return deps;
+}
+
+void bc_cache_dir_store(const char *file, const bc_cache_deps_t *deps) {
+  char name[OS_PATHNAME_SIZE + 32];
+  char tmp[OS_PATHNAME_SIZE + 64];
+  cache_head_t head;
+
+  if (!cache_entry_name(file, deps->paths, name, sizeof(name))) {
+    return;
+  }
+
+  // write a private file then rename, so readers never see a partial entry
+#if (defined(_Win32) || defined(__MINGW32__)) && !defined(__CYGWIN__)
+  mkdir(opt_cache_dir);
+#else
+  mkdir(opt_cache_dir, 0755);
+#endif
+  snprintf(tmp, sizeof(tmp), "%s.%d.%lx.tmp", name, (int)getpid(), (unsigned long)&recorded);
+  int h = open(tmp, O_BINARY | O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (h == -1) {
+    return;
+  }
+
+  memcpy(head.sign, CACHE_SIGN, 4);
+  head.version = SB_DWORD_VER;
+  head.dep_count = deps->count;
+  head.options_len = deps->options_len;
+  head.bc_size = ((bc_head_t *)ctask->bytecode)->size;
+  int success = write(h, &head, sizeof(head)) == sizeof(head);
+
+  for (int i = 0; i < deps->count && success; i++) {
+    const dep_rec_t *rec = &deps->deps[i];
+    cache_dep_t dep;
+    dep.hash = rec->hash;
+    dep.size = rec->size;
+    dep.name_len = strlen(rec->name);
+    success = (write(h, &dep, sizeof(dep)) == sizeof(dep) &&
+               write(h, rec->name, dep.name_len) == (int)dep.name_len);
+  }
+  if (success && head.options_len) {
+    success = write(h, deps->options, head.options_len) == (int)head.options_len;
+  }
+  if (success) {
+    success = write(h, ctask->bytecode, head.bc_size) == (int)head.bc_size;
+  }
+  close(h);
+  if (!success || rename(tmp, name) != 0) {
+    remove(tmp);
+  }
+}
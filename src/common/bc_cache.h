@@ -0,0 +1,122 @@
+// This file is part of SmallBASIC
+//
+// Compiled program cache directory, and the dependencies of cached programs
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#if !defined(_sb_bc_cache_h)
+#define _sb_bc_cache_h
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * the INCLUDE and IMPORT files read while compiling a program, and the
+ * compiler directives which change the environment of the program
+ */
+typedef struct bc_cache_deps_t bc_cache_deps_t;
+
+/**
+ * the kinds of recorded compiler directives
+ */
+#define BC_CACHE_OPTION     'O'
+#define BC_CACHE_SBASICPATH 'P'
+#define BC_CACHE_SHOWPAGE   'S'
+
+/**
+ * @ingroup exec
+ *
+ * loads the cached bytecode for the source file into ctask. the cache
+ * entry is found by hashing the source text, then accepted only when
+ * all of the INCLUDE and IMPORT files are unchanged
+ *
+ * @param file is the source file
+ * @return the recorded files and directives of the loaded entry, or NULL
+ */
+bc_cache_deps_t *bc_cache_dir_load(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * begins recording the files read by the compiler
+ */
+void bc_cache_begin(void);
+
+/**
+ * @ingroup exec
+ *
+ * records a file the program being compiled depends on
+ *
+ * @param file is the INCLUDE source or IMPORT unit
+ */
+void bc_cache_depend(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * records a compiler directive, replayed when the program is loaded from
+ * the cache
+ *
+ * @param kind one of the BC_CACHE_ kinds
+ * @param text the directive text following the keyword, up to the end of line
+ */
+void bc_cache_option(char kind, const char *text);
+
+/**
+ * @ingroup exec
+ *
+ * applies the recorded compiler directives
+ *
+ * @param deps the recorded files and directives
+ */
+void bc_cache_apply(const bc_cache_deps_t *deps);
+
+/**
+ * @ingroup exec
+ *
+ * ends the recording
+ *
+ * @return the recorded files, or NULL when one of them could not be read
+ */
+bc_cache_deps_t *bc_cache_end(void);
+
+/**
+ * @ingroup exec
+ *
+ * whether any of the recorded files was modified or removed
+ *
+ * @param deps the recorded files
+ * @return non-zero when the program must be compiled again
+ */
+int bc_cache_deps_changed(const bc_cache_deps_t *deps);
+
+/**
+ * @ingroup exec
+ *
+ * frees the recorded files
+ *
+ * @param deps the recorded files
+ */
+void bc_cache_deps_free(bc_cache_deps_t *deps);
+
+/**
+ * @ingroup exec
+ *
+ * stores the newly compiled bytecode held in ctask along with the recorded
+ * dependencies. safe when several processes share the directory
+ *
+ * @param file is the source file
+ * @param deps the recorded files
+ */
+void bc_cache_dir_store(const char *file, const bc_cache_deps_t *deps);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -12,27 +12,52 @@
 #include "common/fmt.h"
 #include "common/keymap.h"
 #include "common/messages.h"
+#include "common/profile.h"
 
 #define STR_INIT_SIZE 256
 #define PKG_INIT_SIZE 5
 
+/**
+ * assigns a private copy of the value, for when dest is held within an array
+ * or map that could be shared with the value
+ */
+static void v_set_elem(var_t *dest, const var_t *src) {
+  var_t value;
+  v_init(&value);
+  v_set(&value, src);
+  v_unshare_all(&value);
+  v_move(dest, &value);
+}
+
 /**
  * LET v[(x)] = any
  * CONST v[(x)] = any
  */
 void cmd_let(int is_const) {
+  bcip_t var_ip = prog_ip;
   var_t *v_left = code_getvarptr();
   if (!prog_error) {
     if (v_left->const_flag) {
       err_const();
     } else {
+      // assigning to an element or field rather than the variable
+      int is_elem = (prog_ip - var_ip) > (1 + ADDRSZ);
       if (prog_source[prog_ip] == kwTYPE_CMPOPR &&
           prog_source[prog_ip + 1] == '=') {
         code_skipopr();
       }
       var_t v_right;
       v_init(&v_right);
-      eval(&v_right);
+      if (!is_elem && v_left->type == V_STR && v_left->v.p.owner &&
+          prog_source[var_ip] == kwTYPE_VAR && eval_is_append(var_ip)) {
+        // s = s + x, append to the buffer of s
+        eval_append(&v_right, v_left);
+      } else {
+        eval(&v_right);
+      }
+      if (is_elem) {
+        v_unshare_all(&v_right);
+      }
       v_move(v_left, &v_right);
       v_left->const_flag = is_const;
       // no free after v_move
@@ -41,15 +66,22 @@ void cmd_let(int is_const) {
 }
 
 void cmd_let_opt() {
+  bcip_t var_ip = prog_ip;
   var_t *v_left = code_getvarptr();
   if (!prog_error) {
+    int is_elem = (prog_ip - var_ip) > (1 + ADDRSZ);
+
     // skip kwTYPE_CMPOPR + "="
     code_skipopr();
 
     // skip kwTYPE_VAR
     code_skipnext();
 
-    v_set(v_left, tvar[code_getaddr()]);
+    if (is_elem) {
+      v_set_elem(v_left, tvar[code_getaddr()]);
+    } else {
+      v_set(v_left, tvar[code_getaddr()]);
+    }
     v_left->const_flag = 0;
   }
 }
@@ -98,10 +130,10 @@ void cmd_packed_let() {
       if (arrayCount == count) {
         if (count == 1) {
           // right can be another data type
-          v_set(vars[0], v_right);
+          v_set_elem(vars[0], v_right);
         } else {
           for (int i = 0; i < count; i++) {
-            v_set(vars[i], v_elem(v_right, i));
+            v_set_elem(vars[i], v_elem(v_right, i));
           }
         }
       } else if (arrayCount > count) {
@@ -240,10 +272,12 @@ void cmd_redim() {
  * A << x1 [, x2, ...]
  */
 void cmd_append() {
+  bcip_t var_ip = prog_ip;
   var_t *var_p = code_getvarptr();
   if (prog_error) {
     return;
   }
+  int is_elem = (prog_ip - var_ip) > (1 + ADDRSZ);
 
   if (code_peek() == kwTYPE_CMPOPR && prog_source[prog_ip + 1] == '=') {
     // compatible with LET, operator format
@@ -262,6 +296,9 @@ void cmd_append() {
     var_t arg_p;
     v_init(&arg_p);
     eval(&arg_p);
+    if (is_elem) {
+      v_unshare_all(&arg_p);
+    }
 
     // find the array element
     var_t *elem_p;
@@ -289,7 +326,9 @@ void cmd_append() {
 }
 
 void cmd_append_opt() {
+  bcip_t var_ip = prog_ip;
   var_t *v_left = code_getvarptr();
+  int is_elem = (prog_ip - var_ip) > (1 + ADDRSZ);
 
   // skip kwTYPE_SEP + ","
   code_skipsep();
@@ -297,6 +336,14 @@ void cmd_append_opt() {
   // skip kwTYPE_VAR
   code_skipnext();
 
+  // take the value before resizing, since it may be the array itself
+  var_t value;
+  v_init(&value);
+  v_set(&value, tvar[code_getaddr()]);
+  if (is_elem) {
+    v_unshare_all(&value);
+  }
+
   var_t *elem_p;
   if (v_left->type != V_ARRAY) {
     v_toarray1(v_left, 1);
@@ -305,18 +352,19 @@ void cmd_append_opt() {
     v_resize_array(v_left, v_asize(v_left) + 1);
     elem_p = v_elem(v_left, v_asize(v_left) - 1);
   }
-
-  v_set(elem_p, tvar[code_getaddr()]);
+  v_move(elem_p, &value);
 }
 
 /**
  * INSERT A, index, v1 [, vN]
  */
 void cmd_lins() {
+  bcip_t var_ip = prog_ip;
   var_t *var_p = code_getvarptr();
   if (prog_error) {
     return;
   }
+  int is_elem = (prog_ip - var_ip) > (1 + ADDRSZ);
   par_getcomma();
   if (prog_error) {
     return;
@@ -355,6 +403,9 @@ void cmd_lins() {
     // get the value to append
     v_free(arg_p);
     eval(arg_p);
+    if (is_elem) {
+      v_unshare_all(arg_p);
+    }
 
     // resize +1
     v_resize_array(var_p, v_asize(var_p) + 1);
@@ -449,6 +500,7 @@ void cmd_ldel() {
   } else if (idx == 0) {
     // pop element from a queue
     // for better performance create a queue in the language
+    v_unshare(var_p);
     for (int i = 0; i < size - count; i++) {
       v_set(v_elem(var_p, i), v_elem(var_p, i + count));
     }
@@ -1019,7 +1071,7 @@ bcip_t cmd_push_args(int cmd, bcip_t goto_addr, bcip_t rvid) {
         ofs = prog_ip;       // keep expression's IP
         if (code_isvar()) {  // this parameter is a single variable (it is not an expression)
           stknode_t *param = code_push(kwTYPE_VAR); // push parameter
-          param->x.param.res = code_getvarptr(); // var_t pointer; the variable itself
+          param->x.param.res = code_getvarptr_pinned(); // var_t pointer; the variable itself
           param->x.param.vcheck = 0x3; // parameter can be used 'by value' or 'by reference'
           pcount++;
           break;             // we finished with this parameter
@@ -1062,6 +1114,9 @@ bcip_t cmd_push_args(int cmd, bcip_t goto_addr, bcip_t rvid) {
     tvar[rvid] = v_new();    // create a temporary variable to store the function's result
                              // value will be restored on udp-return
   }
+  if (opt_profile[0]) {
+    profile_enter(goto_addr);
+  }
   return goto_addr;
 }
 
@@ -1109,7 +1164,7 @@ void cmd_call_unit_udp(int cmd, int udp_tid, bcip_t goto_addr, bcip_t rvid) {
         ofs = prog_ip;       // keep expression's IP
 
         if (code_isvar()) {  // this parameter is a single variable (not an expression)
-          var_p_t var = code_getvarptr(); // var_t pointer; the variable itself
+          var_p_t var = code_getvarptr_pinned(); // var_t pointer; the variable itself
           activate_task(udp_tid);
           stknode_t *param = code_push(kwTYPE_VAR); // push parameter, on unit's task
           param->x.param.res = var;
@@ -1169,6 +1224,9 @@ void cmd_call_unit_udp(int cmd, int udp_tid, bcip_t goto_addr, bcip_t rvid) {
   }
 
   prog_ip = goto_addr + ADDRSZ + 3; // jump to udp's code
+  if (opt_profile[0]) {
+    profile_enter(prog_ip);
+  }
 }
 
 /**
@@ -1301,6 +1359,10 @@ void cmd_udpret() {
     }
   }
 
+  if (opt_profile[0]) {
+    profile_leave();
+  }
+
   // restore return value
   if (ncall.x.vcall.rvid != (bid_t) INVALID_ADDR) {
     // it is a function store value to stack
@@ -1555,7 +1617,7 @@ void cmd_for_in(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
 
   if (code_isvar()) {
     // array variable
-    node.x.vfor.arr_ptr = array_p = code_getvarptr();
+    node.x.vfor.arr_ptr = array_p = code_getvarptr_pinned();
   } else {
     // expression
     var_t *new_var = v_new();
@@ -1622,6 +1684,69 @@ void cmd_for_in(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
   }
 }
 
+// FOR-TO flags for the integer fast path
+#define FOR_INT     0x02  // integer counter, TO and STEP cached in the node
+#define FOR_INT_VAR 0x04  // TO is read directly from the variable to_vid
+
+//
+// decodes a FOR-TO operand which is either an integer literal or a plain
+// variable, returns the IP following the operand or INVALID_ADDR
+//
+static bcip_t cmd_for_int_operand(bcip_t ip, var_int_t *value, bid_t *vid) {
+  bcip_t result = INVALID_ADDR;
+  bcip_t save_ip = prog_ip;
+  prog_ip = ip;
+  switch (code_getnext()) {
+  case kwTYPE_INT:
+    *value = code_getint();
+    *vid = INVALID_ADDR;
+    if (code_peek() == kwTYPE_UNROPR && prog_source[prog_ip + 1] == '-') {
+      *value = -*value;
+      prog_ip += 2;
+    }
+    result = prog_ip;
+    break;
+  case kwTYPE_VAR:
+    *vid = code_getaddr();
+    if (tvar[*vid]->type == V_INT) {
+      result = prog_ip;
+    }
+    break;
+  default:
+    break;
+  }
+  prog_ip = save_ip;
+  return result;
+}
+
+//
+// setup the integer fast path when the counter is an integer, TO is an
+// integer literal or variable and STEP is an integer literal
+//
+static void cmd_for_int_setup(stknode_t *node, var_p_t var_p, bcip_t true_ip) {
+  var_int_t value = 0;
+  bid_t vid = INVALID_ADDR;
+  bcip_t ip = cmd_for_int_operand(node->x.vfor.to_expr_ip, &value, &vid);
+
+  if (var_p->type == V_INT && ip != INVALID_ADDR) {
+    node->x.vfor.to_value = value;
+    node->x.vfor.to_vid = vid;
+    node->x.vfor.step_value = 1;
+    if (node->x.vfor.step_expr_ip == INVALID_ADDR && ip == true_ip) {
+      node->x.vfor.flags = FOR_INT;
+    } else if (node->x.vfor.step_expr_ip == ip + 1 && prog_source[ip] == kwSTEP) {
+      ip = cmd_for_int_operand(node->x.vfor.step_expr_ip, &value, &vid);
+      if (ip == true_ip && vid == INVALID_ADDR && value != 0) {
+        node->x.vfor.step_value = value;
+        node->x.vfor.flags = FOR_INT;
+      }
+    }
+    if (node->x.vfor.flags && node->x.vfor.to_vid != INVALID_ADDR) {
+      node->x.vfor.flags |= FOR_INT_VAR;
+    }
+  }
+}
+
 //
 // FOR v1=exp1 TO exp2 [STEP exp3]
 //
@@ -1638,6 +1763,7 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
   node.x.vfor.exit_ip = false_ip + ADDRSZ + ADDRSZ + 1;
   node.x.vfor.jump_ip = true_ip;
   node.x.vfor.var_ptr = var_p;
+  node.x.vfor.flags = 0;
 
   // get the first expression
   eval(&var);
@@ -1703,6 +1829,7 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
         code_skipnext();
         code_jump(code_getaddr());
       } else {
+        cmd_for_int_setup(&node, var_p, true_ip);
         stknode_t *stknode = code_push(kwFOR);
         stknode->x.vfor = node.x.vfor;
       }
@@ -1720,7 +1847,7 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
 void cmd_for() {
   bcip_t true_ip = code_getaddr();
   bcip_t false_ip = code_getaddr();
-  var_p_t var_for = code_getvarptr();
+  var_p_t var_for = code_getvarptr_pinned();
 
   if (!prog_error) {
     v_free(var_for);
@@ -1922,6 +2049,35 @@ void cmd_next_for_to(stknode_t *node, bcip_t next_ip) {
   v_free(&var_to);
 }
 
+//
+// FOR v=exp1 TO exp2 [STEP exp3] with an integer counter. updates the node
+// in place, returns 0 when the generic path is required
+//
+static int cmd_next_for_int(stknode_t *node, bcip_t next_ip) {
+  var_t *var_p = node->x.vfor.var_ptr;
+  var_int_t to = node->x.vfor.to_value;
+  if (var_p->type != V_INT) {
+    return 0;
+  }
+  if (node->x.vfor.flags & FOR_INT_VAR) {
+    var_t *var_to = tvar[node->x.vfor.to_vid];
+    if (var_to->type != V_INT) {
+      return 0;
+    }
+    to = var_to->v.i;
+  }
+
+  var_int_t step = node->x.vfor.step_value;
+  var_p->v.i += step;
+  if (step < 0 ? var_p->v.i >= to : var_p->v.i <= to) {
+    code_jump(node->x.vfor.jump_ip);
+  } else {
+    prog_stack_count--;
+    code_jump(next_ip);
+  }
+  return 1;
+}
+
 /**
  * NEXT
  */
@@ -1929,6 +2085,12 @@ void cmd_next() {
   bcip_t next_ip = code_getaddr();
   code_skipaddr();
 
+  stknode_t *top = code_stackpeek();
+  if (top != NULL && top->type == kwFOR && (top->x.vfor.flags & FOR_INT) &&
+      top->x.vfor.subtype == kwTO && cmd_next_for_int(top, next_ip)) {
+    return;
+  }
+
   stknode_t node;
   code_pop(&node, kwFOR);
 
@@ -2534,7 +2696,7 @@ int sb_qcmp(var_t *a, var_t *b, bcip_t use_ip) {
 }
 
 // using C's qsort()
-static bcip_t static_qsort_last_use_ip;
+static SB_THREAD_LOCAL bcip_t static_qsort_last_use_ip;
 
 int qs_cmp(const void *a, const void *b) {
   var_t *ea = (var_t *)a;
@@ -2569,6 +2731,7 @@ void cmd_sort() {
   if (!errf) {
     if (v_asize(var_p) > 1) {
       static_qsort_last_use_ip = use_ip;
+      v_unshare(var_p);
       qsort(v_data(var_p), v_asize(var_p), sizeof(var_t), qs_cmp);
     }
   }
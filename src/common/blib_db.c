@@ -17,6 +17,11 @@
 #include "common/fs_socket_client.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
 
 #define LDLN_INC    256
 #define GROW_SIZE   1024
@@ -32,7 +37,7 @@ struct file_encoded_var {
 };
 
 /*
- * OPEN "file" [FOR {INPUT|OUTPUT|APPEND}] AS #fileN
+ * OPEN "file" [FOR {INPUT|OUTPUT|APPEND}] AS #fileN [, bufsize]
  */
 void cmd_fopen() {
   var_t file_name;
@@ -74,9 +79,20 @@ void cmd_fopen() {
     par_getsharp();
     if (!prog_error) {
       int handle = par_getint();
+      int bufsize = -1;
+      if (!prog_error && code_peek() == kwTYPE_SEP) {
+        // optional stream buffer size
+        par_getcomma();
+        bufsize = par_getint();
+        if (!prog_error && bufsize < 0) {
+          err_argerr();
+        }
+      }
       if (!prog_error) {
         if (dev_fstatus(handle) == 0) {
-          dev_fopen(handle, file_name.v.p.ptr, flags);
+          if (dev_fopen(handle, file_name.v.p.ptr, flags) && bufsize != -1) {
+            dev_fbuffer(handle, bufsize);
+          }
         } else {
           rt_raise("OPEN: FILE IS ALREADY OPENED");
         }
@@ -200,6 +216,8 @@ int read_encoded_var(int handle, var_t *var) {
   case V_STR:
     var->type = V_STR;
     var->v.p.ptr = malloc(fv.size + 1);
+    var->v.p.owner = 1;
+    var->v.p.length = fv.size + 1;
     dev_fread(handle, (byte *)var->v.p.ptr, fv.size);
     var->v.p.ptr[fv.size] = '\0';
     break;
@@ -347,6 +365,7 @@ void cmd_read_variable(int handle) {
 
       var_p->type = V_STR;
       var_p->v.p.ptr = malloc(size);
+      var_p->v.p.owner = 1;
 
       // READ IT
       while (!dev_feof(handle)) {
@@ -406,6 +425,7 @@ void cmd_flineinput() {
       v_free(var_p);
       var_p->type = V_STR;
       var_p->v.p.ptr = calloc(SB_TEXTLINE_SIZE + 1, 1);
+      var_p->v.p.owner = 1;
       dev_gets(var_p->v.p.ptr, SB_TEXTLINE_SIZE);
       var_p->v.p.length = strlen(var_p->v.p.ptr);
       dev_print("\n");
@@ -522,6 +542,50 @@ void cmd_mkdir() {
  *
  * TLOAD filename, variable [, type]
  */
+/*
+ * TLOAD from the mapped file contents, the lines are counted first so
+ * the array and each of the line strings are allocated only once
+ */
+static void floadln_map(var_t *var_p, const char *data, uint32_t len) {
+  const char *end = data + len;
+  uint32_t count = 0;
+  if (len) {
+    count++;
+    for (const char *p = data; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+      count++;
+    }
+  }
+  v_toarray1(var_p, count);
+  for (uint32_t index = 0; index < count; index++) {
+    const char *eol = memchr(data, '\n', end - data);
+    if (eol == NULL) {
+      eol = end;
+    }
+    int size = eol - data;
+    while (size && data[size - 1] == '\r') {
+      size--;
+    }
+    var_t *elem_p = v_elem(var_p, index);
+    v_init_str(elem_p, size);
+    char *dst = elem_p->v.p.ptr;
+    if (memchr(data, '\r', size) == NULL) {
+      memcpy(dst, data, size);
+    } else {
+      // discard any embedded '\r'
+      int bcount = 0;
+      for (int i = 0; i < size; i++) {
+        if (data[i] != '\r') {
+          dst[bcount++] = data[i];
+        }
+      }
+      size = bcount;
+      elem_p->v.p.length = size + 1;
+    }
+    dst[size] = '\0';
+    data = eol + 1;
+  }
+}
+
 void cmd_floadln() {
   var_t file_name, *array_p = NULL, *var_p = NULL;
   int flags = DEV_FILE_INPUT;
@@ -581,7 +645,19 @@ void cmd_floadln() {
     CHK_ERR(FSERR_GENERIC);
   }
 
-  if (type == 0) {
+  // a single read() is already the fastest way to load type == 1
+  uint32_t map_size;
+  const char *map = type == 0 ? dev_fmap(handle, &map_size) : NULL;
+  if (map != NULL) {
+    uint32_t offset = dev_ftell(handle);
+    if (offset < map_size) {
+      floadln_map(array_p, map + offset, map_size - offset);
+    } else {
+      v_toarray1(array_p, 0);
+    }
+    dev_funmap(map, map_size);
+    dev_fseek(handle, map_size);
+  } else if (type == 0) {
     // build array
     int array_size = LDLN_INC;
     int index = 0;
@@ -798,101 +874,395 @@ void join_path(char *path, char *ext) {
 /*
  * walk on dirs
  */
-void dirwalk(char *dir, char *wc, bcip_t use_ip, int depth) {
-  char path[OS_PATHNAME_SIZE];
-  path[0] = '\0';
-  if (dir[0] == '.') {
-    getcwd(path, OS_PATHNAME_SIZE - 1);
-    join_path(path, ++dir);
-    dir = path;
-  } else if (dir[0] == '~') {
-    const char *home = getenv("HOME");
-    if (home != NULL) {
-      strlcpy(path, home, sizeof(path));
-      join_path(path, ++dir);
-      dir = path;
-    }
-  }
+#define DIRWALK_NO_STAT  1
+#define DIRWALK_PREFETCH 2
+#define DIRWALK_THREADS  4
+#define DIRWALK_EVENTS   64
+
+struct dirwalk_job_t;
+
+typedef struct dirwalk_entry_t {
+  char *name;
+  int is_dir;          // 1 or 0, -1 when unknown
+  int has_stat;
+  time_t mtime;
+  off_t size;
+  struct dirwalk_job_t *job;
+} dirwalk_entry_t;
+
+typedef struct dirwalk_list_t {
+  dirwalk_entry_t *entries;
+  int count;
+  int error;
+} dirwalk_list_t;
+
+typedef struct dirwalk_job_t {
+  char *dir;
+  dirwalk_list_t list;
+  int state;
+  struct dirwalk_job_t *next;
+  struct dirwalk_job_t *queue_next;
+} dirwalk_job_t;
+
+#define DIRWALK_JOB_QUEUED  0
+#define DIRWALK_JOB_RUNNING 1
+#define DIRWALK_JOB_TAKEN   2
+#define DIRWALK_JOB_DONE    3
+
+typedef struct dirwalk_t {
+  char *wc;
+  bcip_t use_ip;
+  int flags;
+  int count;
+  var_t entry;
+  int entry_fields;
+#if defined(HAVE_PTHREAD)
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t threads[DIRWALK_THREADS];
+  int thread_count;
+  int quit;
+  dirwalk_job_t *jobs;
+  dirwalk_job_t *queue_head;
+  dirwalk_job_t *queue_tail;
+#endif
+} dirwalk_t;
+
+/*
+ * reads the directory into the list. the type comes from d_type when the
+ * file system provides it, stat is used only when the caller needs the
+ * time and size or the type of a link. runs on the prefetch threads, so it
+ * must not touch the interpreter state.
+ */
+static void dirwalk_read(const char *dir, int flags, dirwalk_list_t *list) {
+  list->entries = NULL;
+  list->count = 0;
+  list->error = 0;
 
   DIR *dfd = opendir(dir);
   if (dfd == NULL) {
-    log_printf(ERR_DIRWALK_CANT_OPEN, dir);
+    list->error = 1;
     return;
   }
 
+  int size = 0;
   struct dirent *dp;
   while ((dp = readdir(dfd)) != NULL) {
-    if (dev_events(0) != 0) {
-      break;
-    }
     if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
       // skip self and parent
       continue;
     }
-    if (strlen(dir) + strlen(dp->d_name) + 2 > OS_PATHNAME_SIZE) {
-      rt_raise(ERR_DIRWALK_NAME, dir, dp->d_name);
+    if (list->count == size) {
+      size += GROW_SIZE;
+      list->entries = realloc(list->entries, size * sizeof(dirwalk_entry_t));
+    }
+    dirwalk_entry_t *entry = &list->entries[list->count++];
+    entry->name = strdup(dp->d_name);
+    entry->is_dir = -1;
+    entry->has_stat = 0;
+    entry->job = NULL;
+#if defined(DT_DIR)
+    if (dp->d_type == DT_DIR) {
+      entry->is_dir = 1;
+    } else if (dp->d_type != DT_UNKNOWN && dp->d_type != DT_LNK) {
+      entry->is_dir = 0;
+    }
+#endif
+    if (!(flags & DIRWALK_NO_STAT) || entry->is_dir == -1) {
+      struct stat st;
+      int result;
+#if defined(AT_FDCWD)
+      result = fstatat(dirfd(dfd), dp->d_name, &st, 0);
+#else
+      char name[OS_PATHNAME_SIZE];
+      strlcpy(name, dir, sizeof(name));
+      join_path(name, dp->d_name);
+      result = stat(name, &st);
+#endif
+      if (result == 0) {
+        entry->is_dir = S_ISDIR(st.st_mode) ? 1 : 0;
+        entry->has_stat = !(flags & DIRWALK_NO_STAT);
+        entry->mtime = st.st_mtime;
+        entry->size = st.st_size;
+      } else if (!(flags & DIRWALK_NO_STAT)) {
+        // without stat the entry has no type, as before
+        entry->is_dir = -1;
+      }
+    }
+  }
+  closedir(dfd);
+}
+
+static void dirwalk_list_free(dirwalk_list_t *list) {
+  for (int i = 0; i < list->count; i++) {
+    free(list->entries[i].name);
+  }
+  free(list->entries);
+  list->entries = NULL;
+  list->count = 0;
+}
+
+#if defined(HAVE_PTHREAD)
+/*
+ * prefetch thread, reads the queued directories while the main thread runs
+ * the USE expression
+ */
+static void *dirwalk_worker(void *arg) {
+  dirwalk_t *walk = (dirwalk_t *)arg;
+  pthread_mutex_lock(&walk->lock);
+  while (!walk->quit) {
+    dirwalk_job_t *job = walk->queue_head;
+    if (job == NULL) {
+      pthread_cond_wait(&walk->cond, &walk->lock);
+      continue;
+    }
+    walk->queue_head = job->queue_next;
+    if (walk->queue_head == NULL) {
+      walk->queue_tail = NULL;
+    }
+    if (job->state == DIRWALK_JOB_QUEUED) {
+      job->state = DIRWALK_JOB_RUNNING;
+      pthread_mutex_unlock(&walk->lock);
+      dirwalk_read(job->dir, walk->flags, &job->list);
+      pthread_mutex_lock(&walk->lock);
+      job->state = DIRWALK_JOB_DONE;
+      pthread_cond_broadcast(&walk->cond);
+    }
+  }
+  pthread_mutex_unlock(&walk->lock);
+  return NULL;
+}
+
+static void dirwalk_start(dirwalk_t *walk) {
+  walk->thread_count = 0;
+  walk->quit = 0;
+  walk->jobs = NULL;
+  walk->queue_head = NULL;
+  walk->queue_tail = NULL;
+  if (walk->flags & DIRWALK_PREFETCH) {
+    pthread_mutex_init(&walk->lock, NULL);
+    pthread_cond_init(&walk->cond, NULL);
+    for (int i = 0; i < DIRWALK_THREADS; i++) {
+      if (pthread_create(&walk->threads[i], NULL, dirwalk_worker, walk) != 0) {
+        break;
+      }
+      walk->thread_count++;
+    }
+    if (walk->thread_count == 0) {
+      pthread_cond_destroy(&walk->cond);
+      pthread_mutex_destroy(&walk->lock);
+    }
+  }
+}
+
+static void dirwalk_stop(dirwalk_t *walk) {
+  if (walk->thread_count) {
+    pthread_mutex_lock(&walk->lock);
+    walk->quit = 1;
+    pthread_cond_broadcast(&walk->cond);
+    pthread_mutex_unlock(&walk->lock);
+    for (int i = 0; i < walk->thread_count; i++) {
+      pthread_join(walk->threads[i], NULL);
+    }
+    pthread_cond_destroy(&walk->cond);
+    pthread_mutex_destroy(&walk->lock);
+
+    // listings which were not used after a break
+    dirwalk_job_t *job = walk->jobs;
+    while (job != NULL) {
+      dirwalk_job_t *next = job->next;
+      dirwalk_list_free(&job->list);
+      free(job->dir);
+      free(job);
+      job = next;
+    }
+  }
+}
+
+/*
+ * queues the sub-directories of the listing for the prefetch threads
+ */
+static void dirwalk_queue(dirwalk_t *walk, const char *dir, dirwalk_list_t *list) {
+  if (walk->thread_count) {
+    pthread_mutex_lock(&walk->lock);
+    for (int i = 0; i < list->count; i++) {
+      dirwalk_entry_t *entry = &list->entries[i];
+      if (entry->is_dir == 1 && strlen(dir) + strlen(entry->name) + 2 <= OS_PATHNAME_SIZE) {
+        dirwalk_job_t *job = malloc(sizeof(dirwalk_job_t));
+        job->dir = malloc(strlen(dir) + strlen(entry->name) + 2);
+        strcpy(job->dir, dir);
+        join_path(job->dir, entry->name);
+        job->list.entries = NULL;
+        job->list.count = 0;
+        job->list.error = 0;
+        job->state = DIRWALK_JOB_QUEUED;
+        job->next = walk->jobs;
+        job->queue_next = NULL;
+        walk->jobs = job;
+        if (walk->queue_tail != NULL) {
+          walk->queue_tail->queue_next = job;
+        } else {
+          walk->queue_head = job;
+        }
+        walk->queue_tail = job;
+        entry->job = job;
+      }
+    }
+    pthread_cond_broadcast(&walk->cond);
+    pthread_mutex_unlock(&walk->lock);
+  }
+}
+
+/*
+ * returns the prefetched listing, reads the directory when no thread has
+ * started on it yet
+ */
+static void dirwalk_fetch(dirwalk_t *walk, const char *dir, dirwalk_job_t *job, dirwalk_list_t *list) {
+  pthread_mutex_lock(&walk->lock);
+  if (job->state == DIRWALK_JOB_QUEUED) {
+    job->state = DIRWALK_JOB_TAKEN;
+    pthread_mutex_unlock(&walk->lock);
+    dirwalk_read(dir, walk->flags, list);
+    pthread_mutex_lock(&walk->lock);
+  } else {
+    while (job->state != DIRWALK_JOB_DONE) {
+      pthread_cond_wait(&walk->cond, &walk->lock);
+    }
+    *list = job->list;
+    job->list.entries = NULL;
+    job->list.count = 0;
+  }
+
+  // a taken job stays queued until a thread pops it, it's freed at the end
+  if (job->state == DIRWALK_JOB_DONE) {
+    dirwalk_job_t **link = &walk->jobs;
+    while (*link != job) {
+      link = &(*link)->next;
+    }
+    *link = job->next;
+    free(job->dir);
+    free(job);
+  }
+  pthread_mutex_unlock(&walk->lock);
+}
+#endif
+
+/*
+ * fills the entry map passed to the USE expression. the map is created
+ * once and updated in place, it is copied only when the expression kept
+ * a reference to it.
+ */
+static void dirwalk_set_entry(dirwalk_t *walk, const char *dir, dirwalk_entry_t *entry, int depth) {
+  var_t *var = &walk->entry;
+  int fields = entry->has_stat ? 2 : entry->is_dir != -1 && (walk->flags & DIRWALK_NO_STAT) ? 1 : 0;
+  if (fields != walk->entry_fields || var->type != V_MAP) {
+    v_free(var);
+    map_init(var);
+    map_add_var(var, "path", 0);
+    map_add_var(var, "name", 0);
+    map_add_var(var, "depth", 0);
+    if (fields == 2) {
+      map_add_var(var, "mtime", 0);
+      map_add_var(var, "size", 0);
+    }
+    if (fields) {
+      map_add_var(var, "dir", 0);
+    }
+    walk->entry_fields = fields;
+  } else {
+    v_unshare(var);
+  }
+  v_setstr(map_get(var, "path"), dir);
+  v_setstr(map_get(var, "name"), entry->name);
+  v_setint(map_get(var, "depth"), depth);
+  if (fields == 2) {
+    v_setint(map_get(var, "mtime"), entry->mtime);
+    v_setint(map_get(var, "size"), entry->size);
+  }
+  if (fields) {
+    v_setint(map_get(var, "dir"), entry->is_dir);
+  }
+}
+
+static void dirwalk(dirwalk_t *walk, char *dir, dirwalk_job_t *job, int depth) {
+  dirwalk_list_t list;
+
+#if defined(HAVE_PTHREAD)
+  if (job != NULL) {
+    dirwalk_fetch(walk, dir, job, &list);
+  } else {
+    dirwalk_read(dir, walk->flags, &list);
+  }
+#else
+  dirwalk_read(dir, walk->flags, &list);
+#endif
+  if (list.error) {
+    log_printf(ERR_DIRWALK_CANT_OPEN, dir);
+    return;
+  }
+#if defined(HAVE_PTHREAD)
+  dirwalk_queue(walk, dir, &list);
+#endif
+
+  for (int i = 0; i < list.count; i++) {
+    dirwalk_entry_t *entry = &list.entries[i];
+    if ((walk->count++ % DIRWALK_EVENTS) == 0 && dev_events(0) != 0) {
+      break;
+    }
+    if (strlen(dir) + strlen(entry->name) + 2 > OS_PATHNAME_SIZE) {
+      rt_raise(ERR_DIRWALK_NAME, dir, entry->name);
     } else {
       // check filename
       int callusr;
       int contf = 1;
-      struct stat st;
 
-      if (!wc) {
+      if (!walk->wc) {
         if (code_peek() == kwTYPE_EOC) {
           rt_raise(ERR_DIRWALK_MISSING_USE);
           break;
         }
         callusr = 1;
       } else {
-        callusr = wc_match(wc, dp->d_name);
+        callusr = wc_match(walk->wc, entry->name);
       }
 
       char name[OS_PATHNAME_SIZE];
       strcpy(name, dir);
-      join_path(name, dp->d_name);
+      join_path(name, entry->name);
 
       if (callusr) {
-        // call user's function
-        var_t *var = v_new();
-        map_init(var);
-        v_setstr(map_add_var(var, "path", 0), dir);
-        v_setstr(map_add_var(var, "name", 0), dp->d_name);
-        map_add_var(var, "depth", depth);
-        if (stat(name, &st) != -1) {
-          map_add_var(var, "mtime", st.st_mtime);
-          map_add_var(var, "size", st.st_size);
-          map_add_var(var, "dir", (st.st_mode & S_IFDIR) ? 1 : 0);
-        }
-        exec_usefunc(var, use_ip);
-        contf = v_getint(var);
-        v_free(var);
-        v_detach(var);
+        // call user's function, the result replaces the shared copy of the entry
+        var_t result;
+        dirwalk_set_entry(walk, dir, entry, depth);
+        v_init(&result);
+        v_set(&result, &walk->entry);
+        exec_usefunc(&result, walk->use_ip);
+        contf = v_getint(&result);
+        v_free(&result);
       }
       if (!contf) {
         break;
       }
 
-      // proceed to the next
-      if (access(name, R_OK) == 0) {
-        // user-func, possible it is deleted
-        if (stat(name, &st) == 0 && st.st_mode & S_IFDIR) {
-          dirwalk(name, wc, use_ip, depth + 1);
-        }
+      // proceed to the next, possible it is deleted by the user-func
+      if (entry->is_dir == 1 && access(name, R_OK) == 0) {
+        dirwalk(walk, name, entry->job, depth + 1);
       }
     }
   }
-  closedir(dfd);
+  dirwalk_list_free(&list);
 }
 
 /*
  * walking on directories
  *
- * DIRWALK "/home" [, "*"] USE MYPRN(x)
+ * DIRWALK "/home" [, "*" [, flags]] USE MYPRN(x)
  */
 void cmd_dirwalk() {
   char *dir = NULL, *wc = NULL;
+  var_int_t flags = 0;
 
-  par_massget("Ss", &dir, &wc);
+  par_massget("Ssi", &dir, &wc, &flags);
   if (!prog_error) {
     bcip_t use_ip, exit_ip;
 
@@ -904,7 +1274,37 @@ void cmd_dirwalk() {
     } else {
       use_ip = exit_ip = INVALID_ADDR;
     }
-    dirwalk(dir, wc, use_ip, 0);
+
+    char path[OS_PATHNAME_SIZE];
+    char *start = dir;
+    if (dir[0] == '.') {
+      getcwd(path, OS_PATHNAME_SIZE - 1);
+      join_path(path, dir + 1);
+      start = path;
+    } else if (dir[0] == '~') {
+      const char *home = getenv("HOME");
+      if (home != NULL) {
+        strlcpy(path, home, sizeof(path));
+        join_path(path, dir + 1);
+        start = path;
+      }
+    }
+
+    dirwalk_t walk;
+    walk.wc = wc;
+    walk.use_ip = use_ip;
+    walk.flags = flags;
+    walk.count = 0;
+    walk.entry_fields = -1;
+    v_init(&walk.entry);
+#if defined(HAVE_PTHREAD)
+    dirwalk_start(&walk);
+#endif
+    dirwalk(&walk, start, NULL, 0);
+#if defined(HAVE_PTHREAD)
+    dirwalk_stop(&walk);
+#endif
+    v_free(&walk.entry);
 
     if (exit_ip != INVALID_ADDR) {
       code_jump(exit_ip);
@@ -19,10 +19,11 @@
 #include "common/geom.h"
 #include "common/messages.h"
 #include "common/keymap.h"
+#include "lib/match.h"
 
 // relative coordinates (current x/y) from blib_graph
-extern int gra_x;
-extern int gra_y;
+extern SB_THREAD_LOCAL int gra_x;
+extern SB_THREAD_LOCAL int gra_y;
 
 // date
 static char *date_wd3_table[] = TABLE_WEEKDAYS_3C;
@@ -660,8 +661,47 @@ var_num_t cmd_math1(long funcCode, var_t *arg) {
 // int <- FRE(-42) // battery critical voltage value * 1000
 // int <- FRE(-43) // battery warning voltage value * 1000
 //
+// Optional-set #5: variable allocator info (-5x)
+// int <- FRE(-50) // variables in use
+// int <- FRE(-51) // peak variables in use
+// int <- FRE(-52) // variables held by the pool
+// int <- FRE(-53) // slabs added to the pool
+// int <- FRE(-54) // total variable allocations
+//
+// Optional-set #6: compiled program cache info (-6x)
+// int <- FRE(-60) // programs and CHAIN sources loaded from the cache
+// int <- FRE(-61) // programs and CHAIN sources compiled with the cache enabled
+//
 var_int_t cmd_fre(var_int_t arg) {
   var_int_t r = 0;
+  if (arg == -60) {
+    return gsb_bc_cache_hits;
+  }
+  if (arg == -61) {
+    return gsb_bc_cache_misses;
+  }
+  if (arg <= -50 && arg >= -54) {
+    var_pool_stats_t stats;
+    v_pool_get_stats(&stats);
+    switch (arg) {
+    case -50:
+      r = stats.in_use;
+      break;
+    case -51:
+      r = stats.peak;
+      break;
+    case -52:
+      r = stats.capacity;
+      break;
+    case -53:
+      r = stats.slabs;
+      break;
+    default:
+      r = stats.allocs;
+      break;
+    }
+    return r;
+  }
 #if defined(_Win32)
   MEMORYSTATUS ms;
   ms.dwLength = sizeof(MEMORYSTATUS);
@@ -1173,6 +1213,7 @@ void cmd_str1(long funcCode, var_t *arg, var_t *r) {
           var_t *elem_p = v_elem(r, i);
           elem_p->type = V_STR;
           elem_p->v.p.ptr = strdup(value != NULL ? value : "");
+          elem_p->v.p.owner = 1;
           elem_p->v.p.length = strlen(elem_p->v.p.ptr) + 1;
         }
       } else {
@@ -1390,11 +1431,11 @@ void cmd_strN(long funcCode, var_t *r) {
         r->type = V_INT;        // dont try to free
       } else {
         r->v.p.ptr = malloc(count * len + 1);
-        *((r->v.p.ptr)) = '\0';
         for (int i = 0; i < count; i++) {
-          strcat(r->v.p.ptr, tmp_p);
+          memcpy(r->v.p.ptr + i * len, tmp_p, len);
         }
-        r->v.p.length = strlen(r->v.p.ptr) + 1;
+        r->v.p.ptr[count * len] = '\0';
+        r->v.p.length = count * len + 1;
       }
     }
     break;
@@ -2805,6 +2846,26 @@ void cmd_genfunc(long funcCode, var_t *r) {
       r->v.n = mat_determ(m1, n, toler);
       free(m1);
     }
+  }
+    break;
+    //
+    // array <- TRANSPOSE(A)
+    //
+  case kwTRANSPOSE: {
+    int32_t rows, cols;
+
+    v_init(r);
+    var_t *a = par_getvarray();
+    IF_ERR_RETURN;
+
+    var_num_t *m1 = mat_toc(a, &rows, &cols);
+    if (m1) {
+      var_num_t *m2 = (var_num_t *)malloc(sizeof(var_num_t) * rows * cols);
+      mat_transpose(m1, m2, rows, cols);
+      mat_tov(r, m2, cols, rows, 1);
+      free(m2);
+      free(m1);
+    }
   }
     break;
 
@@ -2893,6 +2954,36 @@ void cmd_genfunc(long funcCode, var_t *r) {
     v_create_window(r);
     break;
 
+    //
+    // array <- CAPTURE(text, pattern)
+    //
+  case kwCAPTURE: {
+    char *text = NULL;
+    char *pattern = NULL;
+    par_massget("SS", &text, &pattern);
+    if (!prog_error) {
+      int count;
+      int *groups = reg_match_capture(pattern, text, &count);
+      v_toarray1(r, count);
+
+      // each group is a map with the text and the position
+      for (int i = 0; i < count; i++) {
+        var_t *elem_p = v_elem(r, i);
+        int pos = groups[i * 2];
+        map_init(elem_p);
+        if (pos == -1) {
+          v_setstr(map_add_var(elem_p, "text", 0), "");
+        } else {
+          v_setstrn(map_add_var(elem_p, "text", 0), text + pos, groups[i * 2 + 1]);
+        }
+        map_add_var(elem_p, "pos", pos + 1);
+      }
+      free(groups);
+    }
+    pfree2(text, pattern);
+  }
+    break;
+
   default:
     rt_raise("Unsupported built-in function call %ld", funcCode);
   };
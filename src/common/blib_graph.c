@@ -11,8 +11,8 @@
 #include "common/messages.h"
 
 // graphics - relative coordinates
-int gra_x;
-int gra_y;
+SB_THREAD_LOCAL int gra_x;
+SB_THREAD_LOCAL int gra_y;
 
 void graph_reset() {
   gra_x = gra_y = 0;
@@ -1301,6 +1301,7 @@ void m3combine(var_t *m, var_num_t nm[3][3]) {
   }
 
   // combine
+  v_unshare(m);
   for (i = 0; i < 3; i++) {
     for (j = 0; j < 3; j++) {
       e = v_elem(m, (i * 3 + j));
@@ -1336,6 +1337,7 @@ void cmd_m3ident() {
   if (prog_error) {
     return;
   }
+  v_unshare(m);
   for (i = 0; i < 3; i++) {
     for (j = 0; j < 3; j++) {
       e = v_elem(m, (i * 3 + j));
@@ -1497,6 +1499,7 @@ void cmd_m3apply() {
   }
 
   // apply
+  v_unshare(p);
   e = v_elem(p, 0);
   if (e->type != V_ARRAY) {
     int o;
@@ -1521,6 +1524,7 @@ void cmd_m3apply() {
       if (prog_error)
         break;
 
+      v_unshare(e);
       x = v_getreal(v_elem(e, 0));
       y = v_getreal(v_elem(e, 1));
       v_setreal(v_elem(e, 0), x * om[0][0] + y * om[1][0] + om[2][0]);
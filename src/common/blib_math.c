@@ -16,6 +16,9 @@
 #include "common/pproc.h"
 #include "common/smbas.h"
 
+// use the LU determinant above this size
+#define MAT_EXPAND_MAX 4
+
 /*
  * INT(x) round downwards to the nearest integer
  */
@@ -197,6 +200,11 @@ var_num_t mat_determ(var_num_t *a, int n, double toler) {
   int i;
   var_num_t v;
 
+  if (n > MAT_EXPAND_MAX) {
+    // the expansion has n! terms
+    return mat_determ_lu(a, n, toler);
+  }
+
   done = malloc(n * sizeof(int));
   for (i = 0; i < n; i++) {
     done[i] = 0;
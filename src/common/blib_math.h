@@ -49,6 +49,41 @@ void mat_gauss_jordan(var_num_t *a, var_num_t *b, int n, double toler);
  */
 void mat_inverse(var_num_t *a, int n);
 
+/**
+ * @ingroup math
+ *
+ * C = A * B, the large products run on several threads
+ *
+ * @param a is the matrix A with n rows and m cols
+ * @param b is the matrix B with m rows and p cols
+ * @param c is the result with n rows and p cols
+ */
+void mat_product(const var_num_t *a, const var_num_t *b, var_num_t *c, int n, int m, int p);
+
+/**
+ * @ingroup math
+ *
+ * T = transpose of A
+ *
+ * @param a is the matrix
+ * @param t is the result with cols rows and rows cols
+ * @param rows is the number of rows of A
+ * @param cols is the number of cols of A
+ */
+void mat_transpose(const var_num_t *a, var_num_t *t, int rows, int cols);
+
+/**
+ * @ingroup math
+ *
+ * determinant of A from the LU decomposition
+ *
+ * @param a is the matrix
+ * @param n is the rows/cols of A
+ * @param toler is the smallest acceptable pivot
+ * @return the determinant of A
+ */
+var_num_t mat_determ_lu(const var_num_t *a, int n, double toler);
+
 void mat_det2(var_num_t t, int m, int k, var_num_t *a, int *done, var_num_t *v, int n, double toler)
    ;
 
@@ -22,9 +22,9 @@ static int tones[] = {
   2349, 2489, 2637, 2794, 2960, 3136, 3322, 3520, 3729, 3951, 4186, 4435, 4699, 4978, 5274, 5587, 5919,
   6271, 6645, 7040, 7459, 7902, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, };
 
-static int O = 2, bg = 0, vol = 75;
-static int period, duration, pitch = 440;
-static double L = 4.0, T = 240.0, M = 1.0, TM = 1.0;
+static SB_THREAD_LOCAL int O = 2, bg = 0, vol = 75;
+static SB_THREAD_LOCAL int period, duration, pitch = 440;
+static SB_THREAD_LOCAL double L = 4.0, T = 240.0, M = 1.0, TM = 1.0;
 
 #define FILE_PREFIX_LEN 7
 
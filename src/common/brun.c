@@ -25,15 +25,38 @@
 #include "common/device.h"
 #include "common/pproc.h"
 #include "common/keymap.h"
+#include "common/bc_cache.h"
+#include "common/profile.h"
+#include "lib/match.h"
 
 int brun_create_task(const char *filename, byte *preloaded_bc, int libf);
 int exec_close_task();
 void sys_before_comp();
+static uint64_t bc_cache_hash(const char *source);
+static int bc_cache_chain_load(const char *source, uint64_t hash);
+static void bc_cache_chain_store(char *source, uint64_t hash, bc_cache_deps_t *deps);
 
-static char fileName[OS_FILENAME_SIZE + 1];
-static stknode_t err_node;
+static SB_THREAD_LOCAL char fileName[OS_FILENAME_SIZE + 1];
+static SB_THREAD_LOCAL stknode_t err_node;
 
 #define EVT_CHECK_EVERY 50
+#define EVT_CLOCK_READS 8
+#define EVT_MAX_BUDGET  256
+
+/**
+ * event check scheduler. the clock is only read after a budget of commands,
+ * the budget grows while commands run fast and shrinks when they run slow,
+ * aiming for around EVT_CLOCK_READS clock reads per EVT_CHECK_EVERY. a
+ * check is therefore late by at most the time of one budget.
+ */
+typedef struct {
+  uint32_t next_check;  // time of the next dev_events() call
+  uint32_t last_read;   // time of the last clock read
+  uint32_t budget;      // commands between clock reads
+  uint32_t count;       // commands since the last clock read
+} evt_sched_t;
+
+static SB_THREAD_LOCAL evt_sched_t evt_sched;
 #define IF_ERR_BREAK if (prog_error) { \
   if (prog_error == errThrow)       \
       prog_error = errNone; else break;}
@@ -368,22 +391,29 @@ void cmd_chain(void) {
       code = strdup(var.v.p.ptr);
     }
   } else if (var.type == V_ARRAY) {
+    // join the lines
     int len = 0;
+    int count = 0;
     uint32_t size = v_asize(&var);
     for (int el = 0; el < size; el++) {
       var_t *el_p = v_elem(&var, el);
       if (el_p->type == V_STR) {
-        int str_len = strlen(el_p->v.p.ptr) + 2;
-        if (len) {
-          code = realloc(code, len + str_len);
-          strcat(code, el_p->v.p.ptr);
-        } else {
-          code = malloc(str_len);
-          strcpy(code, el_p->v.p.ptr);
+        len += strlen(el_p->v.p.ptr) + 1;
+        count++;
+      }
+    }
+    if (count) {
+      char *p = code = malloc(len + 1);
+      for (int el = 0; el < size; el++) {
+        var_t *el_p = v_elem(&var, el);
+        if (el_p->type == V_STR) {
+          int str_len = strlen(el_p->v.p.ptr);
+          memcpy(p, el_p->v.p.ptr, str_len);
+          p += str_len;
+          *p++ = '\n';
         }
-        strcat(code, "\n");
-        len += str_len + 1;
       }
+      *p = '\0';
     }
   }
 
@@ -398,9 +428,27 @@ void cmd_chain(void) {
   int tid_base = create_task("CH_BASE");
   int tid_prev = activate_task(tid_base);
 
-  // compile the buffer
-  sys_before_comp();
-  int success = comp_compile_buffer(code);
+  // compile the buffer, or use the bytecode from a previous CHAIN
+  int success;
+  if (opt_bc_cache > 0) {
+    uint64_t hash = bc_cache_hash(code);
+    success = bc_cache_chain_load(code, hash);
+    if (!success) {
+      sys_before_comp();
+      bc_cache_begin();
+      success = comp_compile_buffer(code);
+      bc_cache_deps_t *deps = bc_cache_end();
+      if (success && deps != NULL) {
+        bc_cache_chain_store(code, hash, deps);
+        code = NULL;
+      } else {
+        bc_cache_deps_free(deps);
+      }
+    }
+  } else {
+    sys_before_comp();
+    success = comp_compile_buffer(code);
+  }
 
   free(code);
   code = NULL;
@@ -697,6 +745,54 @@ static inline void bc_loop_end() {
   prog_error = errEnd;
 }
 
+/**
+ * reads the clock once the command budget is spent, returns whether
+ * the events are due to be checked
+ */
+static inline int bc_loop_events_due() {
+  uint32_t now = dev_get_millisecond_count();
+  uint32_t elapsed = now - evt_sched.last_read;
+  uint32_t max_budget = opt_event_budget > 0 ? opt_event_budget : EVT_MAX_BUDGET;
+  uint32_t period = EVT_CHECK_EVERY / EVT_CLOCK_READS;
+
+  if (elapsed < period / 2) {
+    evt_sched.budget = evt_sched.budget ? evt_sched.budget * 2 : 1;
+  } else if (elapsed > period) {
+    // the commands ran slow, scale down to the commands run in one period
+    evt_sched.budget = (uint64_t)evt_sched.count * period / elapsed;
+  }
+  if (evt_sched.budget > max_budget) {
+    evt_sched.budget = max_budget;
+  } else if (evt_sched.budget == 0) {
+    evt_sched.budget = 1;
+  }
+  evt_sched.count = 0;
+  evt_sched.last_read = now;
+  return now >= evt_sched.next_check;
+}
+
+static inline void bc_loop_events() {
+  uint32_t now = evt_sched.last_read;
+  evt_sched.next_check = now + EVT_CHECK_EVERY;
+
+  switch (dev_events(0)) {
+  case -1:
+    // break event
+    break;
+  case -2:
+    prog_error = errBreak;
+    inf_break(prog_line);
+    break;
+  default:
+    if (prog_timer) {
+      timer_run(now);
+    }
+  };
+
+  // time spent handling the events is not counted against the budget
+  evt_sched.last_read = dev_get_millisecond_count();
+}
+
 void bc_loop_goto() {
   bcip_t next_ip = code_getaddr();
 
@@ -711,6 +807,45 @@ void bc_loop_goto() {
   prog_ip = next_ip;
 }
 
+/*
+ * Command dispatch for bc_loop(). With USE_COMPUTED_GOTO the dispatch is
+ * threaded: each handler jumps straight to the handler of the next opcode
+ * through a label table (GCC labels as values). The end-of-command marks are
+ * dispatched like commands, and a parameter left over by a command lands on
+ * bc_param_error. Otherwise the same handlers are compiled as a plain switch
+ * followed by the end-of-command check.
+ *
+ * BC_CONTINUE - the command has updated the IP, proceed with the next command
+ * BC_BREAK    - the command has finished, check for the end-of-command mark
+ */
+#if defined(USE_COMPUTED_GOTO) && defined(__GNUC__)
+#define BC_THREADED       1
+#define BC_DISPATCH(c)    goto *bc_table[c];
+#define BC_END_DISPATCH
+#define BC_OP(k)          op_##k:
+#define BC_OP_DEFAULT     op_default:
+#define BC_CONTINUE       BC_NEXT
+#define BC_BREAK          BC_NEXT
+#define BC_IF_ERR_BREAK
+
+// errors, events and the end of the program are handled by bc_next_slow
+#define BC_NEXT                                               \
+  if (prog_error || ++evt_sched.count >= evt_sched.budget ||  \
+      prog_ip >= prog_length) {                               \
+    goto bc_next_slow;                                        \
+  }                                                           \
+  code = prog_source[prog_ip++];                              \
+  goto *bc_table[code]
+#else
+#define BC_DISPATCH(c)    switch (c) {
+#define BC_END_DISPATCH   }
+#define BC_OP(k)          case k:
+#define BC_OP_DEFAULT     default:
+#define BC_CONTINUE       continue
+#define BC_BREAK          break
+#define BC_IF_ERR_BREAK   IF_ERR_BREAK
+#endif
+
 /**
  * execute commands (loop)
  *
@@ -724,17 +859,94 @@ void bc_loop(int isf) {
   int proc_level = 0;
   byte code = 0;
 
-  // setup event checker time = 50ms
-  uint32_t now = dev_get_millisecond_count();
-  uint32_t next_check = now + EVT_CHECK_EVERY;
+#if defined(BC_THREADED)
+  static void *bc_table[256] = {
+    [0 ... 255] = &&op_default,
+    [kwTYPE_INT ... kwTYPE_SEP] = &&bc_param_error,
+    [kwTYPE_LEVEL_BEGIN] = &&bc_param_error,
+    [kwTYPE_LEVEL_END] = &&bc_param_error,
+    [kwTYPE_EVPUSH ... kwTYPE_CALLF] = &&bc_param_error,
+    [kwTYPE_FASTOPR] = &&bc_param_error,
+    [kwLABEL] = &&op_kwLABEL,
+    [kwREM] = &&op_kwREM,
+    [kwTYPE_EOC] = &&op_kwTYPE_EOC,
+    [kwTYPE_LINE] = &&op_kwTYPE_LINE,
+    [kwLET] = &&op_kwLET,
+    [kwLET_OPT] = &&op_kwLET_OPT,
+    [kwCONST] = &&op_kwCONST,
+    [kwPACKED_LET] = &&op_kwPACKED_LET,
+    [kwGOTO] = &&op_kwGOTO,
+    [kwGOSUB] = &&op_kwGOSUB,
+    [kwRETURN] = &&op_kwRETURN,
+    [kwONJMP] = &&op_kwONJMP,
+    [kwPRINT] = &&op_kwPRINT,
+    [kwINPUT] = &&op_kwINPUT,
+    [kwIF] = &&op_kwIF,
+    [kwELIF] = &&op_kwELIF,
+    [kwELSE] = &&op_kwELSE,
+    [kwENDIF] = &&op_kwENDIF,
+    [kwFOR] = &&op_kwFOR,
+    [kwNEXT] = &&op_kwNEXT,
+    [kwWHILE] = &&op_kwWHILE,
+    [kwWEND] = &&op_kwWEND,
+    [kwREPEAT] = &&op_kwREPEAT,
+    [kwUNTIL] = &&op_kwUNTIL,
+    [kwSELECT] = &&op_kwSELECT,
+    [kwCASE] = &&op_kwCASE,
+    [kwCASE_ELSE] = &&op_kwCASE_ELSE,
+    [kwENDSELECT] = &&op_kwENDSELECT,
+    [kwDIM] = &&op_kwDIM,
+    [kwREDIM] = &&op_kwREDIM,
+    [kwAPPEND] = &&op_kwAPPEND,
+    [kwAPPEND_OPT] = &&op_kwAPPEND_OPT,
+    [kwINSERT] = &&op_kwINSERT,
+    [kwDELETE] = &&op_kwDELETE,
+    [kwERASE] = &&op_kwERASE,
+    [kwREAD] = &&op_kwREAD,
+    [kwDATA] = &&op_kwDATA,
+    [kwRESTORE] = &&op_kwRESTORE,
+    [kwOPTION] = &&op_kwOPTION,
+    [kwTYPE_CALLEXTP] = &&op_kwTYPE_CALLEXTP,
+    [kwTYPE_CALLP] = &&op_kwTYPE_CALLP,
+    [kwTYPE_CALL_UDP] = &&op_kwTYPE_CALL_UDP,
+    [kwTYPE_CALL_UDF] = &&op_kwTYPE_CALL_UDF,
+    [kwTYPE_RET] = &&op_kwTYPE_RET,
+    [kwTYPE_CRVAR] = &&op_kwTYPE_CRVAR,
+    [kwTYPE_PARAM] = &&op_kwTYPE_PARAM,
+    [kwEXIT] = &&op_kwEXIT,
+    [kwLINE] = &&op_kwLINE,
+    [kwCOLOR] = &&op_kwCOLOR,
+    [kwOPEN] = &&op_kwOPEN,
+    [kwCLOSE] = &&op_kwCLOSE,
+    [kwFILEWRITE] = &&op_kwFILEWRITE,
+    [kwFILEREAD] = &&op_kwFILEREAD,
+    [kwLOGPRINT] = &&op_kwLOGPRINT,
+    [kwFILEPRINT] = &&op_kwFILEPRINT,
+    [kwSPRINT] = &&op_kwSPRINT,
+    [kwLINEINPUT] = &&op_kwLINEINPUT,
+    [kwSINPUT] = &&op_kwSINPUT,
+    [kwFILEINPUT] = &&op_kwFILEINPUT,
+    [kwSEEK] = &&op_kwSEEK,
+    [kwTRON] = &&op_kwTRON,
+    [kwTROFF] = &&op_kwTROFF,
+    [kwSTOP] = &&op_kwSTOP,
+    [kwEND] = &&op_kwEND,
+    [kwCHAIN] = &&op_kwCHAIN,
+    [kwRUN] = &&op_kwRUN,
+    [kwEXEC] = &&op_kwEXEC,
+    [kwTRY] = &&op_kwTRY,
+    [kwCATCH] = &&op_kwCATCH,
+    [kwENDTRY] = &&op_kwENDTRY
+  };
+#endif
 
   /**
    * For commands that change the IP use
    *
-   * case mycommand:
+   * BC_OP(mycommand)
    *   command();
-   *   if  ( prog_error )  break;
-   *   continue;
+   *   BC_IF_ERR_BREAK;
+   *   BC_CONTINUE;
    */
   if (isf == 2) {
     proc_level++;
@@ -747,189 +959,176 @@ void bc_loop(int isf) {
     case kwTYPE_LINE:
       break;
     default:
-      now = dev_get_millisecond_count();
+      // check events every ~50ms
+      if (++evt_sched.count >= evt_sched.budget && bc_loop_events_due()) {
+        bc_loop_events();
+      }
       break;
     }
 
-    // check events every ~50ms
-    if (now >= next_check) {
-      next_check = now + EVT_CHECK_EVERY;
-
-      switch (dev_events(0)) {
-      case -1:
-        // break event
-        break;
-      case -2:
-        prog_error = errBreak;
-        inf_break(prog_line);
-        break;
-      default:
-        if (prog_timer) {
-          timer_run(now);
-        }
-      };
-    }
-
     // proceed to the next command
     if (!prog_error) {
       code = prog_source[prog_ip++];
-      switch (code) {
-      case kwLABEL:
-      case kwREM:
-      case kwTYPE_EOC:
-        continue;
-      case kwTYPE_LINE:
+      BC_DISPATCH(code)
+      BC_OP(kwLABEL)
+      BC_OP(kwREM)
+      BC_OP(kwTYPE_EOC)
+        BC_CONTINUE;
+      BC_OP(kwTYPE_LINE)
         prog_line = code_getaddr();
         if (opt_trace_on) {
           dev_trace_line(prog_line);
         }
-        continue;
-      case kwLET:
+        if (opt_profile[0]) {
+          profile_line(prog_line);
+        }
+        BC_CONTINUE;
+      BC_OP(kwLET)
         cmd_let(0);
-        break;
-      case kwLET_OPT:
+        BC_BREAK;
+      BC_OP(kwLET_OPT)
         cmd_let_opt();
-        break;
-      case kwCONST:
+        BC_BREAK;
+      BC_OP(kwCONST)
         cmd_let(1);
-        break;
-      case kwPACKED_LET:
+        BC_BREAK;
+      BC_OP(kwPACKED_LET)
         cmd_packed_let();
-        break;
-      case kwGOTO:
+        BC_BREAK;
+      BC_OP(kwGOTO)
         bc_loop_goto();
-        continue;
-      case kwGOSUB:
+        BC_CONTINUE;
+      BC_OP(kwGOSUB)
         cmd_gosub();
-        IF_ERR_BREAK;
-        continue;
-      case kwRETURN:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwRETURN)
         cmd_return();
-        IF_ERR_BREAK;
-        continue;
-      case kwONJMP:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwONJMP)
         cmd_on_go();
-        IF_ERR_BREAK;
-        continue;
-      case kwPRINT:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwPRINT)
         cmd_print(PV_CONSOLE);
-        break;
-      case kwINPUT:
+        BC_BREAK;
+      BC_OP(kwINPUT)
         cmd_input(PV_CONSOLE);
-        break;
-      case kwIF:
+        BC_BREAK;
+      BC_OP(kwIF)
         cmd_if();
-        IF_ERR_BREAK;
-        continue;
-      case kwELIF:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwELIF)
         cmd_elif();
-        IF_ERR_BREAK;
-        continue;
-      case kwELSE:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwELSE)
         cmd_else();
-        IF_ERR_BREAK;
-        continue;
-      case kwENDIF:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwENDIF)
         cmd_endif();
-        IF_ERR_BREAK;
-        continue;
-      case kwFOR:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwFOR)
         cmd_for();
-        IF_ERR_BREAK;
-        continue;
-      case kwNEXT:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwNEXT)
         cmd_next();
-        IF_ERR_BREAK;
-        continue;
-      case kwWHILE:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwWHILE)
         cmd_while();
-        IF_ERR_BREAK;
-        continue;
-      case kwWEND:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwWEND)
         cmd_wend();
-        IF_ERR_BREAK;
-        continue;
-      case kwREPEAT:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwREPEAT)
         cmd_repeat();
-        IF_ERR_BREAK;
-        continue;
-      case kwUNTIL:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwUNTIL)
         cmd_until();
-        IF_ERR_BREAK;
-        continue;
-      case kwSELECT:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwSELECT)
         cmd_select();
-        IF_ERR_BREAK;
-        continue;
-      case kwCASE:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwCASE)
         cmd_case();
-        IF_ERR_BREAK;
-        continue;
-      case kwCASE_ELSE:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwCASE_ELSE)
         cmd_case_else();
-        IF_ERR_BREAK;
-        continue;
-      case kwENDSELECT:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwENDSELECT)
         cmd_end_select();
-        IF_ERR_BREAK;
-        continue;
-      case kwDIM:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwDIM)
         cmd_dim(0);
-        break;
-      case kwREDIM:
+        BC_BREAK;
+      BC_OP(kwREDIM)
         cmd_redim();
-        break;
-      case kwAPPEND:
+        BC_BREAK;
+      BC_OP(kwAPPEND)
         cmd_append();
-        break;
-      case kwAPPEND_OPT:
+        BC_BREAK;
+      BC_OP(kwAPPEND_OPT)
         cmd_append_opt();
-        break;
-      case kwINSERT:
+        BC_BREAK;
+      BC_OP(kwINSERT)
         cmd_lins();
-        break;
-      case kwDELETE:
+        BC_BREAK;
+      BC_OP(kwDELETE)
         cmd_ldel();
-        break;
-      case kwERASE:
+        BC_BREAK;
+      BC_OP(kwERASE)
         cmd_erase();
-        break;
-      case kwREAD:
+        BC_BREAK;
+      BC_OP(kwREAD)
         cmd_read();
-        break;
-      case kwDATA:
+        BC_BREAK;
+      BC_OP(kwDATA)
         cmd_data();
-        break;
-      case kwRESTORE:
+        BC_BREAK;
+      BC_OP(kwRESTORE)
         cmd_restore();
-        break;
-      case kwOPTION:
+        BC_BREAK;
+      BC_OP(kwOPTION)
         cmd_options();
-        break;
-      case kwTYPE_CALLEXTP:
+        BC_BREAK;
+      BC_OP(kwTYPE_CALLEXTP)
         bc_loop_call_extp();
-        IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CALLP:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwTYPE_CALLP)
         bc_loop_call_proc();
-        break;
-      case kwTYPE_CALL_UDP:
+        BC_BREAK;
+      BC_OP(kwTYPE_CALL_UDP)
         cmd_udp(kwPROC);
         if (isf) {
           proc_level++;
         }
-        IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CALL_UDF:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwTYPE_CALL_UDF)
         if (isf) {
           cmd_udp(kwFUNC);
           proc_level++;
         } else {
           err_syntax(kwTYPE_CALL_UDF, "%G");
         }
-        IF_ERR_BREAK;
-        continue;
-      case kwTYPE_RET:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwTYPE_RET)
         cmd_udpret();
         if (isf) {
           proc_level--;
@@ -937,15 +1136,15 @@ void bc_loop(int isf) {
             return;
           }
         }
-        IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CRVAR:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwTYPE_CRVAR)
         cmd_crvar();
-        break;
-      case kwTYPE_PARAM:
+        BC_BREAK;
+      BC_OP(kwTYPE_PARAM)
         cmd_param();
-        break;
-      case kwEXIT:
+        BC_BREAK;
+      BC_OP(kwEXIT)
         pops = cmd_exit();
         if (isf && pops) {
           proc_level--;
@@ -953,78 +1152,78 @@ void bc_loop(int isf) {
             return;
           }
         }
-        IF_ERR_BREAK;
-        continue;
-      case kwLINE:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwLINE)
         cmd_line();
-        break;
-      case kwCOLOR:
+        BC_BREAK;
+      BC_OP(kwCOLOR)
         cmd_color();
-        break;
-      case kwOPEN:
+        BC_BREAK;
+      BC_OP(kwOPEN)
         cmd_fopen();
-        break;
-      case kwCLOSE:
+        BC_BREAK;
+      BC_OP(kwCLOSE)
         cmd_fclose();
-        break;
-      case kwFILEWRITE:
+        BC_BREAK;
+      BC_OP(kwFILEWRITE)
         cmd_fwrite();
-        break;
-      case kwFILEREAD:
+        BC_BREAK;
+      BC_OP(kwFILEREAD)
         cmd_fread();
-        break;
-      case kwLOGPRINT:
+        BC_BREAK;
+      BC_OP(kwLOGPRINT)
         cmd_print(PV_LOG);
-        break;
-      case kwFILEPRINT:
+        BC_BREAK;
+      BC_OP(kwFILEPRINT)
         cmd_print(PV_FILE);
-        break;
-      case kwSPRINT:
+        BC_BREAK;
+      BC_OP(kwSPRINT)
         cmd_print(PV_STRING);
-        break;
-      case kwLINEINPUT:
+        BC_BREAK;
+      BC_OP(kwLINEINPUT)
         cmd_flineinput();
-        break;
-      case kwSINPUT:
+        BC_BREAK;
+      BC_OP(kwSINPUT)
         cmd_input(PV_STRING);
-        break;
-      case kwFILEINPUT:
+        BC_BREAK;
+      BC_OP(kwFILEINPUT)
         cmd_input(PV_FILE);
-        break;
-      case kwSEEK:
+        BC_BREAK;
+      BC_OP(kwSEEK)
         cmd_fseek();
-        break;
-      case kwTRON:
+        BC_BREAK;
+      BC_OP(kwTRON)
         opt_trace_on = 1;
-        continue;
-      case kwTROFF:
+        BC_CONTINUE;
+      BC_OP(kwTROFF)
         opt_trace_on = 0;
-        continue;
-      case kwSTOP:
-      case kwEND:
+        BC_CONTINUE;
+      BC_OP(kwSTOP)
+      BC_OP(kwEND)
         bc_loop_end();
-        break;
-      case kwCHAIN:
+        BC_BREAK;
+      BC_OP(kwCHAIN)
         cmd_chain();
-        break;
-      case kwRUN:
+        BC_BREAK;
+      BC_OP(kwRUN)
         cmd_run(1);
-        break;
-      case kwEXEC:
+        BC_BREAK;
+      BC_OP(kwEXEC)
         cmd_run(0);
-        break;
-      case kwTRY:
+        BC_BREAK;
+      BC_OP(kwTRY)
         cmd_try();
-        IF_ERR_BREAK;
-        continue;
-      case kwCATCH:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwCATCH)
         cmd_catch();
-        IF_ERR_BREAK;
-        continue;
-      case kwENDTRY:
+        BC_IF_ERR_BREAK;
+        BC_CONTINUE;
+      BC_OP(kwENDTRY)
         cmd_end_try();
-        continue;
-      default:
+        BC_CONTINUE;
+      BC_OP_DEFAULT
         log_printf("OUT OF ADDRESS SPACE\n");
         for (i = 0; keyword_table[i].name[0] != '\0'; i++) {
           if (prog_source[prog_ip] == keyword_table[i].code) {
@@ -1036,8 +1235,12 @@ void bc_loop(int isf) {
           hex_dump(prog_source, prog_length);
         }
         rt_raise("SEG:CODE[%x]=%02x", prog_ip, prog_source[prog_ip]);
-      }
+        BC_BREAK;
+      BC_END_DISPATCH
     }
+#if defined(BC_THREADED)
+    goto bc_next_slow;
+#else
     if (prog_ip < prog_length) {
       code = prog_source[prog_ip++];
       if (code == kwTYPE_LINE) {
@@ -1045,6 +1248,9 @@ void bc_loop(int isf) {
         if (opt_trace_on) {
           dev_trace_line(prog_line);
         }
+        if (opt_profile[0]) {
+          profile_line(prog_line);
+        }
       } else if (code != kwTYPE_EOC) {
         if (!opt_quiet) {
           hex_dump(prog_source, prog_length);
@@ -1059,7 +1265,43 @@ void bc_loop(int isf) {
     }
     // quit on error
     IF_ERR_BREAK;
+#endif
   }
+
+#if defined(BC_THREADED)
+  return;
+
+  // a parameter or separator found where a command should be
+bc_param_error:
+  if (!opt_quiet) {
+    hex_dump(prog_source, prog_length);
+  }
+  prog_ip--;
+  if (code == kwTYPE_SEP) {
+    rt_raise("COMMAND SEPARATOR '%c' FOUND", prog_source[prog_ip + 1]);
+  } else {
+    rt_raise("PARAM COUNT ERROR @%d=%X %d", prog_ip, prog_source[prog_ip], code);
+  }
+
+bc_next_slow:
+  if (prog_error) {
+    if (prog_error != errThrow) {
+      return;
+    }
+    prog_error = errNone;
+  }
+  // check events every ~50ms
+  if (evt_sched.count >= evt_sched.budget && bc_loop_events_due()) {
+    bc_loop_events();
+    if (prog_error) {
+      goto bc_next_slow;
+    }
+  }
+  if (prog_ip < prog_length) {
+    code = prog_source[prog_ip++];
+    goto *bc_table[code];
+  }
+#endif
 }
 
 /**
@@ -1517,6 +1759,164 @@ int sbasic_recursive_exec(int tid) {
   return success;
 }
 
+/**
+ * a compiled program retained in memory, either a program file or
+ * the source text of a CHAIN
+ */
+typedef struct bc_cache_t {
+  char *file;
+  char *source;
+  uint64_t hash;
+  time_t mtime;
+  off_t size;
+  byte *bytecode;
+  bc_cache_deps_t *deps;
+  struct bc_cache_t *next;
+} bc_cache_t;
+
+static SB_THREAD_LOCAL bc_cache_t *bc_cache = NULL;
+
+/**
+ * returns the entry for the file or the source text, moved to the front
+ */
+static bc_cache_t *bc_cache_find(const char *file, const char *source, uint64_t hash) {
+  bc_cache_t *prev = NULL;
+  for (bc_cache_t *node = bc_cache; node != NULL; prev = node, node = node->next) {
+    if (file != NULL ? (node->file != NULL && strcmp(node->file, file) == 0) :
+        (node->source != NULL && node->hash == hash && strcmp(node->source, source) == 0)) {
+      if (prev != NULL) {
+        prev->next = node->next;
+        node->next = bc_cache;
+        bc_cache = node;
+      }
+      return node;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * returns an empty entry at the front, reusing the entry for the file or
+ * the source text, or the least recently used entry when full
+ */
+static bc_cache_t *bc_cache_add(const char *file, const char *source, uint64_t hash) {
+  bc_cache_t *node = bc_cache_find(file, source, hash);
+  if (node == NULL) {
+    int count = 0;
+    bc_cache_t *prev = NULL;
+    bc_cache_t *last = NULL;
+    for (bc_cache_t *next = bc_cache; next != NULL; next = next->next) {
+      prev = last;
+      last = next;
+      count++;
+    }
+    if (count < opt_bc_cache || last == NULL) {
+      node = (bc_cache_t *)calloc(1, sizeof(bc_cache_t));
+      node->next = bc_cache;
+      bc_cache = node;
+    } else {
+      // discard the least recently used entry
+      node = last;
+      if (prev != NULL) {
+        prev->next = NULL;
+        node->next = bc_cache;
+        bc_cache = node;
+      }
+    }
+  }
+  free(node->file);
+  free(node->source);
+  free(node->bytecode);
+  bc_cache_deps_free(node->deps);
+  node->file = NULL;
+  node->source = NULL;
+  node->bytecode = NULL;
+  node->deps = NULL;
+  return node;
+}
+
+/**
+ * returns a copy of the bytecode
+ */
+static byte *bc_cache_copy(const byte *bytecode) {
+  uint32_t size = ((bc_head_t *)bytecode)->size;
+  byte *result = malloc(size);
+  memcpy(result, bytecode, size);
+  return result;
+}
+
+/**
+ * hashes the CHAIN source text
+ */
+static uint64_t bc_cache_hash(const char *source) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const byte *p = (const byte *)source; *p; p++) {
+    hash ^= *p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * loads a copy of the cached bytecode when the source file and the files
+ * it includes or imports are unchanged, then applies its OPTIONs
+ */
+static int bc_cache_load(const char *file, struct stat *st) {
+  bc_cache_t *node = bc_cache_find(file, NULL, 0);
+  if (node == NULL || node->mtime != st->st_mtime || node->size != st->st_size ||
+      bc_cache_deps_changed(node->deps)) {
+    // not cached or the sources were modified
+    gsb_bc_cache_misses++;
+    return 0;
+  }
+  gsb_bc_cache_hits++;
+  ctask->bytecode = bc_cache_copy(node->bytecode);
+  ctask->bc_type = 1;
+  bc_cache_apply(node->deps);
+  return 1;
+}
+
+/**
+ * loads a copy of the cached bytecode of the CHAIN source text when the
+ * files it includes or imports are unchanged, then applies its OPTIONs
+ */
+static int bc_cache_chain_load(const char *source, uint64_t hash) {
+  bc_cache_t *node = bc_cache_find(NULL, source, hash);
+  if (node == NULL || bc_cache_deps_changed(node->deps)) {
+    gsb_bc_cache_misses++;
+    return 0;
+  }
+  gsb_bc_cache_hits++;
+  ctask->bytecode = bc_cache_copy(node->bytecode);
+  bc_cache_apply(node->deps);
+  return 1;
+}
+
+/**
+ * stores a copy of the compiled CHAIN source text, the entry keeps the source
+ * and the files it depends on
+ */
+static void bc_cache_chain_store(char *source, uint64_t hash, bc_cache_deps_t *deps) {
+  bc_cache_t *node = bc_cache_add(NULL, source, hash);
+  node->source = source;
+  node->hash = hash;
+  node->deps = deps;
+  node->bytecode = bc_cache_copy(ctask->bytecode);
+}
+
+/**
+ * stores a copy of the newly compiled bytecode, the entry keeps the files
+ * it depends on. discards the least recently used
+ */
+static void bc_cache_store(const char *file, struct stat *st, bc_cache_deps_t *deps) {
+  bc_cache_t *node = bc_cache_add(file, NULL, 0);
+  node->file = strdup(file);
+  node->mtime = st->st_mtime;
+  node->size = st->st_size;
+  node->deps = deps;
+  node->bytecode = bc_cache_copy(ctask->bytecode);
+}
+
 /**
  * compile the given file into bytecode
  */
@@ -1528,6 +1928,22 @@ int sbasic_compile(const char *file) {
     return success;             // file is an executable
   }
 
+  struct stat st;
+  int use_cache = opt_nosave && opt_bc_cache > 0 && stat(file, &st) == 0;
+  if (use_cache && bc_cache_load(file, &st)) {
+    return success;
+  }
+  int use_cache_dir = opt_nosave && opt_cache_dir[0];
+  bc_cache_deps_t *deps = use_cache_dir ? bc_cache_dir_load(file) : NULL;
+  if (deps != NULL) {
+    if (use_cache) {
+      bc_cache_store(file, &st, deps);
+    } else {
+      bc_cache_deps_free(deps);
+    }
+    return success;
+  }
+
   if (opt_nosave) {
     comp_rq = 1;
   } else {
@@ -1566,7 +1982,21 @@ int sbasic_compile(const char *file) {
   // compile it
   if (comp_rq) {
     sys_before_comp();  // system specific preparations for compilation
+    if (use_cache || use_cache_dir) {
+      bc_cache_begin();
+    }
     success = comp_compile(file);
+    deps = (use_cache || use_cache_dir) ? bc_cache_end() : NULL;
+    if (success && ctask->bc_type == 1 && ctask->bytecode && deps != NULL) {
+      if (use_cache_dir) {
+        bc_cache_dir_store(file, deps);
+      }
+      if (use_cache) {
+        bc_cache_store(file, &st, deps);
+        deps = NULL;
+      }
+    }
+    bc_cache_deps_free(deps);
   }
   return success;
 }
@@ -1650,6 +2080,9 @@ int sbasic_exec(const char *file) {
   strlcpy(gsb_last_file, file, sizeof(gsb_last_file));
   strcpy(gsb_last_errmsg, "");
   sbasic_set_bas_dir(file);
+  if (opt_profile[0]) {
+    profile_begin(file);
+  }
   success = sbasic_compile(file);
 
   if (ctask->bc_type == 2) {
@@ -1670,6 +2103,9 @@ int sbasic_exec(const char *file) {
 
     // run
     sbasic_recursive_exec(exec_tid);
+    if (opt_profile[0]) {
+      profile_end(opt_profile);
+    }
 
     // normal exit
     if (!opt_quiet) {
@@ -1677,7 +2113,11 @@ int sbasic_exec(const char *file) {
     }
 
     exec_close(exec_tid);       // clean up executor's garbages
+    v_pool_release();           // free the variable slabs
+    reg_match_free();           // free the compiled patterns
     dev_restore();              // restore device
+  } else if (opt_profile[0]) {
+    profile_end(NULL);
   }
 
   // return compilation errors as failure
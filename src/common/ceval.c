@@ -9,9 +9,10 @@
 
 #include "common/smbas.h"
 #include "common/bc.h"
+#include "common/blib.h"
 
-static bc_t *bc_in;
-static bc_t *bc_out;
+static SB_THREAD_LOCAL bc_t *bc_in;
+static SB_THREAD_LOCAL bc_t *bc_out;
 
 #define cev_add1(x)     bc_add_code(bc_out, (x))
 #define cev_add2(x, y)  { bc_add1(bc_out, (x)); bc_add1(bc_out, (y)); }
@@ -156,11 +157,350 @@ void cev_check_dup_prim() {
   }
 }
 
+/*
+ * constant folding (OPTION PREDEF OPTIMIZE)
+ *
+ * an operand is a constant when the code between pos and end is a single
+ * kwTYPE_INT or kwTYPE_NUM, optionally in parenthesis. the folded result
+ * replaces the code from pos, the arithmetic follows the executor's
+ * oper_xxx() functions in eval.c
+ */
+int cev_get_const(bcip_t pos, bcip_t end, var_t *v) {
+  int result = 0;
+  while (end - pos > 2 &&
+         bc_out->ptr[pos] == kwTYPE_LEVEL_BEGIN &&
+         bc_out->ptr[end - 1] == kwTYPE_LEVEL_END) {
+    pos++;
+    end--;
+  }
+  if (comp_optimize) {
+    byte code = bc_out->ptr[pos];
+    if (code == kwTYPE_INT && pos + 1 + OS_INTSZ == end) {
+      v->type = V_INT;
+      memcpy(&v->v.i, bc_out->ptr + pos + 1, OS_INTSZ);
+      result = 1;
+    } else if (code == kwTYPE_NUM && pos + 1 + OS_REALSZ == end) {
+      v->type = V_NUM;
+      memcpy(&v->v.n, bc_out->ptr + pos + 1, OS_REALSZ);
+      result = 1;
+    }
+  }
+  return result;
+}
+
+void cev_set_const(bcip_t pos, var_t *v) {
+  bc_out->count = pos;
+  if (v->type == V_INT) {
+    bc_add_cint(bc_out, v->v.i);
+  } else {
+    bc_add_creal(bc_out, v->v.n);
+  }
+}
+
+void cev_set_int(bcip_t pos, var_int_t i) {
+  var_t v;
+  v.type = V_INT;
+  v.v.i = i;
+  cev_set_const(pos, &v);
+}
+
+void cev_set_num(bcip_t pos, var_num_t n) {
+  var_t v;
+  v.type = V_NUM;
+  v.v.n = n;
+  cev_set_const(pos, &v);
+}
+
+/*
+ * folds the operand at pos with a unary operator
+ */
+int cev_fold_unary(bcip_t pos, byte op) {
+  var_t v;
+  if (!cev_get_const(pos, bc_out->count, &v)) {
+    return 0;
+  }
+  switch (op) {
+  case '-':
+    if (v.type == V_INT) {
+      v.v.i = -v.v.i;
+    } else {
+      v.v.n = -v.v.n;
+    }
+    cev_set_const(pos, &v);
+    break;
+  case '+':
+    break;
+  case OPLOG_INV:
+    cev_set_int(pos, ~v_igetval(&v));
+    break;
+  case OPLOG_NOT:
+    cev_set_int(pos, !v_igetval(&v));
+    break;
+  default:
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * folds the binary expression where the left operand starts at pos and the
+ * right operand follows the kwTYPE_EVPUSH at push (and the short-circuit
+ * jump of the logical operators). returns 0 when the expression is not
+ * constant or would raise an error at run-time
+ */
+int cev_fold_binary(bcip_t pos, bcip_t push, byte type, byte op) {
+  var_t left;
+  var_t right;
+  var_num_t lf, rf;
+  var_int_t li, ri;
+  bcip_t right_pos = push + 1;
+
+  if (type == kwTYPE_LOGOPR) {
+    // kwTYPE_EVAL_SC kwTYPE_LOGOPR op addr
+    right_pos += 3 + ADDRSZ;
+  }
+  if (!cev_get_const(pos, push, &left) ||
+      !cev_get_const(right_pos, bc_out->count, &right)) {
+    return 0;
+  }
+  switch (type) {
+  case kwTYPE_POWOPR:
+    cev_set_num(pos, pow(v_getval(&left), v_getval(&right)));
+    break;
+  case kwTYPE_ADDOPR:
+    if (left.type == V_INT && right.type == V_INT) {
+      cev_set_int(pos, op == '+' ? left.v.i + right.v.i : left.v.i - right.v.i);
+    } else {
+      lf = v_getval(&left);
+      rf = v_getval(&right);
+      cev_set_num(pos, op == '+' ? lf + rf : lf - rf);
+    }
+    break;
+  case kwTYPE_MULOPR:
+    lf = v_getval(&left);
+    rf = v_getval(&right);
+    switch (op) {
+    case '*':
+      cev_set_num(pos, lf * rf);
+      break;
+    case '/':
+      if (ABS(rf) == 0) {
+        return 0;
+      }
+      cev_set_num(pos, lf / rf);
+      break;
+    case '\\':
+      li = lf;
+      ri = rf;
+      if (ri == 0 || ri == -1) {
+        return 0;
+      }
+      cev_set_int(pos, li / ri);
+      break;
+    case '%':
+    case OPLOG_MOD:
+      ri = rf;
+      if (ri == 0 || ri == -1) {
+        return 0;
+      }
+      li = (lf < 0.0) ? -floor(-lf) : floor(lf);
+      cev_set_int(pos, li - ri * (li / ri));
+      break;
+    case OPLOG_MDL:
+      if (rf == 0) {
+        return 0;
+      }
+      cev_set_num(pos, fmod(lf, rf) + rf * (SGN(lf) != SGN(rf)));
+      break;
+    default:
+      return 0;
+    }
+    break;
+  case kwTYPE_CMPOPR:
+    switch (op) {
+    case OPLOG_EQ:
+      cev_set_int(pos, v_compare(&left, &right) == 0);
+      break;
+    case OPLOG_GT:
+      cev_set_int(pos, v_compare(&left, &right) > 0);
+      break;
+    case OPLOG_GE:
+      cev_set_int(pos, v_compare(&left, &right) >= 0);
+      break;
+    case OPLOG_LT:
+      cev_set_int(pos, v_compare(&left, &right) < 0);
+      break;
+    case OPLOG_LE:
+      cev_set_int(pos, v_compare(&left, &right) <= 0);
+      break;
+    case OPLOG_NE:
+      cev_set_int(pos, v_compare(&left, &right) != 0);
+      break;
+    default:
+      return 0;
+    }
+    break;
+  case kwTYPE_LOGOPR:
+    li = v_igetval(&left);
+    ri = v_igetval(&right);
+    switch (op) {
+    case OPLOG_AND:
+      cev_set_int(pos, (li && ri) ? 1 : 0);
+      break;
+    case OPLOG_OR:
+      cev_set_int(pos, (li || ri) ? 1 : 0);
+      break;
+    case OPLOG_NAND:
+      cev_set_int(pos, ~(li & ri));
+      break;
+    case OPLOG_NOR:
+      cev_set_int(pos, ~(li | ri));
+      break;
+    case OPLOG_XNOR:
+      cev_set_int(pos, ~(li ^ ri));
+      break;
+    case OPLOG_BOR:
+      cev_set_int(pos, li | ri);
+      break;
+    case OPLOG_BAND:
+      cev_set_int(pos, li & ri);
+      break;
+    case OPLOG_XOR:
+      cev_set_int(pos, li ^ ri);
+      break;
+    default:
+      return 0;
+    }
+    break;
+  default:
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * whether the code between pos and end is a single variable or constant
+ */
+int cev_is_plain(bcip_t pos, bcip_t end) {
+  switch (bc_out->ptr[pos]) {
+  case kwTYPE_VAR:
+    return pos + 1 + ADDRSZ == end;
+  case kwTYPE_INT:
+    return pos + 1 + OS_INTSZ == end;
+  case kwTYPE_NUM:
+    return pos + 1 + OS_REALSZ == end;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * when optimizing, marks a binary operation between two plain operands, eg
+ * i + 1 or a < b. when both sides hold numbers the executor computes the
+ * result directly from the operands, otherwise it skips the mark and runs
+ * the code below
+ *
+ * [kwTYPE_FASTOPR] left [kwTYPE_EVPUSH] right [kwTYPE_EVPOP] [opr] [op]
+ */
+void cev_fast_opr(bcip_t pos, bcip_t push) {
+  if (comp_optimize && cev_is_plain(pos, push) && cev_is_plain(push + 1, bc_out->count)) {
+    cev_add1(0);
+    memmove(bc_out->ptr + pos + 1, bc_out->ptr + pos, bc_out->count - pos - 1);
+    bc_out->ptr[pos] = kwTYPE_FASTOPR;
+  }
+}
+
+/*
+ * folds the system constants PI, TRUE and FALSE, and the math functions
+ * having a constant argument
+ */
+void cev_fold_prim(bcip_t pos) {
+  var_t arg;
+  bcip_t id;
+  bcip_t arg_pos = pos + 1 + ADDRSZ + 1;
+
+  if (!comp_optimize) {
+    return;
+  }
+  switch (bc_out->ptr[pos]) {
+  case kwTYPE_VAR:
+    if (pos + 1 + ADDRSZ == bc_out->count) {
+      memcpy(&id, bc_out->ptr + pos + 1, ADDRSZ);
+      if (id == SYSVAR_PI) {
+        cev_set_num(pos, M_PI);
+      } else if (id == SYSVAR_TRUE) {
+        cev_set_int(pos, 1);
+      } else if (id == SYSVAR_FALSE) {
+        cev_set_int(pos, 0);
+      }
+    }
+    break;
+  case kwTYPE_CALLF:
+    if (arg_pos < bc_out->count &&
+        bc_out->ptr[arg_pos - 1] == kwTYPE_LEVEL_BEGIN &&
+        bc_out->ptr[bc_out->count - 1] == kwTYPE_LEVEL_END &&
+        cev_get_const(arg_pos, bc_out->count - 1, &arg)) {
+      memcpy(&id, bc_out->ptr + pos + 1, ADDRSZ);
+      switch (id) {
+      case kwCOS:
+      case kwSIN:
+      case kwTAN:
+      case kwCOSH:
+      case kwSINH:
+      case kwTANH:
+      case kwACOS:
+      case kwASIN:
+      case kwATAN:
+      case kwACOSH:
+      case kwASINH:
+      case kwATANH:
+      case kwSEC:
+      case kwSECH:
+      case kwASEC:
+      case kwASECH:
+      case kwCSC:
+      case kwCSCH:
+      case kwACSC:
+      case kwACSCH:
+      case kwCOT:
+      case kwCOTH:
+      case kwACOT:
+      case kwACOTH:
+      case kwSQR:
+      case kwABS:
+      case kwEXP:
+      case kwLOG:
+      case kwLOG10:
+      case kwFIX:
+      case kwINT:
+      case kwCDBL:
+      case kwDEG:
+      case kwRAD:
+      case kwFLOOR:
+      case kwCEIL:
+      case kwFRAC:
+        cev_set_num(pos, cmd_math1(id, &arg));
+        break;
+      case kwSGN:
+      case kwCINT:
+        cev_set_int(pos, cmd_imath1(id, &arg));
+        break;
+      default:
+        break;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
+
 /*
  * prim
  */
 void cev_prim() {
   IF_ERR_RTN;
+  bcip_t pos = bc_out->count;
   byte code = CODE(IP);
   IP++;
   cev_add1(code);
@@ -214,6 +554,7 @@ void cev_prim() {
     }
     break;
   };
+  cev_fold_prim(pos);
 }
 
 /*
@@ -245,8 +586,9 @@ void cev_unary() {
   } else {
     op = 0;
   }
+  bcip_t pos = bc_out->count;
   cev_parenth();        // R = cev_parenth
-  if (op) {
+  if (op && !cev_fold_unary(pos, op)) {
     cev_add1(kwTYPE_UNROPR);
     cev_add1(op);       // R = op R
   }
@@ -256,17 +598,22 @@ void cev_unary() {
  * pow
  */
 void cev_pow() {
+  bcip_t pos = bc_out->count;
   cev_unary();                  // R = cev_unary
 
   IF_ERR_RTN;
   while (CODE(IP) == kwTYPE_POWOPR) {
     IP += 2;
 
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
     cev_unary();                // R = cev_unary
     IF_ERR_RTN;
-    cev_add1(kwTYPE_EVPOP);     // POP LEFT
-    cev_add2(kwTYPE_POWOPR, '^'); // R = LEFT op R
+    if (!cev_fold_binary(pos, push, kwTYPE_POWOPR, '^')) {
+      cev_fast_opr(pos, push);
+      cev_add1(kwTYPE_EVPOP);     // POP LEFT
+      cev_add2(kwTYPE_POWOPR, '^'); // R = LEFT op R
+    }
   }
 }
 
@@ -274,6 +621,7 @@ void cev_pow() {
  * mul | div | mod
  */
 void cev_mul() {
+  bcip_t pos = bc_out->count;
   cev_pow();                    // R = cev_pow()
 
   IF_ERR_RTN;
@@ -282,12 +630,16 @@ void cev_mul() {
 
     op = CODE(++IP);
     IP++;
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
 
     cev_pow();
     IF_ERR_RTN;
-    cev_add1(kwTYPE_EVPOP);      // POP LEFT
-    cev_add2(kwTYPE_MULOPR, op); // R = LEFT op R
+    if (!cev_fold_binary(pos, push, kwTYPE_MULOPR, op)) {
+      cev_fast_opr(pos, push);
+      cev_add1(kwTYPE_EVPOP);      // POP LEFT
+      cev_add2(kwTYPE_MULOPR, op); // R = LEFT op R
+    }
   }
 }
 
@@ -295,6 +647,7 @@ void cev_mul() {
  * add | sub
  */
 void cev_add() {
+  bcip_t pos = bc_out->count;
   cev_mul();                    // R = cev_mul()
 
   IF_ERR_RTN;
@@ -304,13 +657,17 @@ void cev_add() {
     IP++;
     op = CODE(IP);
     IP++;
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
 
     cev_mul();                  // R = cev_mul
     IF_ERR_RTN;
 
-    cev_add1(kwTYPE_EVPOP);    // POP LEFT
-    cev_add2(kwTYPE_ADDOPR, op); // R = LEFT op R
+    if (!cev_fold_binary(pos, push, kwTYPE_ADDOPR, op)) {
+      cev_fast_opr(pos, push);
+      cev_add1(kwTYPE_EVPOP);    // POP LEFT
+      cev_add2(kwTYPE_ADDOPR, op); // R = LEFT op R
+    }
   }
 }
 
@@ -318,6 +675,7 @@ void cev_add() {
  * compare
  */
 void cev_cmp() {
+  bcip_t pos = bc_out->count;
   cev_add();                    // R = cev_add()
 
   IF_ERR_RTN;
@@ -327,11 +685,15 @@ void cev_cmp() {
     IP++;
     op = CODE(IP);
     IP++;
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
     cev_add();                  // R = cev_add()
     IF_ERR_RTN;
-    cev_add1(kwTYPE_EVPOP);         // POP LEFT
-    cev_add2(kwTYPE_CMPOPR, op);    // R = LEFT op R
+    if (!cev_fold_binary(pos, push, kwTYPE_CMPOPR, op)) {
+      cev_fast_opr(pos, push);
+      cev_add1(kwTYPE_EVPOP);         // POP LEFT
+      cev_add2(kwTYPE_CMPOPR, op);    // R = LEFT op R
+    }
   }
 }
 
@@ -339,6 +701,7 @@ void cev_cmp() {
  * logical
  */
 void cev_log(void) {
+  bcip_t pos = bc_out->count;
   cev_cmp();                    // R = cev_cmp()
   IF_ERR_RTN;
   while (CODE(IP) == kwTYPE_LOGOPR) {
@@ -350,6 +713,7 @@ void cev_log(void) {
     op = CODE(IP);
     IP++;
 
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R (push the left side result
     cev_add1(kwTYPE_EVAL_SC);
     cev_add2(kwTYPE_LOGOPR, op);
@@ -358,11 +722,13 @@ void cev_log(void) {
 
     cev_cmp();                  // right seg // R = cev_cmp()
     IF_ERR_RTN;
-    cev_add1(kwTYPE_EVPOP);    // POP LEFT
-    cev_add2(kwTYPE_LOGOPR, op); // R = LEFT op R
+    if (!cev_fold_binary(pos, push, kwTYPE_LOGOPR, op)) {
+      cev_add1(kwTYPE_EVPOP);    // POP LEFT
+      cev_add2(kwTYPE_LOGOPR, op); // R = LEFT op R
 
-    shortcut_offs = bc_out->count - shortcut;
-    memcpy(bc_out->ptr + shortcut, &shortcut_offs, ADDRSZ);
+      shortcut_offs = bc_out->count - shortcut;
+      memcpy(bc_out->ptr + shortcut, &shortcut_offs, ADDRSZ);
+    }
   }
 }
 
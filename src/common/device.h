@@ -807,6 +807,11 @@ typedef struct {
   int handle;         /**< the file handle */
   int last_error;     /**< the last error-code */
   int open_flags;     /**< the open()'s flags */
+
+  byte *buffer;       /**< stream read or write buffer, NULL when unbuffered */
+  uint32_t buf_size;  /**< the buffer size */
+  uint32_t buf_pos;   /**< the read position within the buffer */
+  uint32_t buf_len;   /**< the number of bytes held in the buffer */
 } dev_file_t;
 
 // flags for dev_fopen()
@@ -874,6 +879,17 @@ uint32_t dev_flength(int SBHandle);
  */
 int dev_fclose(int SBHandle);
 
+/**
+ * @ingroup dev_f
+ *
+ * sets the size of the read/write buffer of a stream file, 0 disables buffering
+ *
+ * @param SBHandle is the RTL's file-handle
+ * @param size is the buffer size
+ * @returns non-zero on success
+ */
+int dev_fbuffer(int SBHandle, uint32_t size);
+
 /**
  * @ingroup dev_f
  *
@@ -895,6 +911,27 @@ uint32_t dev_fseek(int SBHandle, uint32_t offset);
  */
 uint32_t dev_ftell(int SBHandle);
 
+/**
+ * @ingroup dev_f
+ *
+ * maps the entire contents of a regular file into memory
+ *
+ * @param SBHandle is the RTL's file-handle
+ * @param size receives the file size
+ * @return the read-only file contents, or NULL when the file cannot be mapped
+ */
+const char *dev_fmap(int SBHandle, uint32_t *size);
+
+/**
+ * @ingroup dev_f
+ *
+ * releases the contents returned by dev_fmap()
+ *
+ * @param data is the mapped file contents
+ * @param size is the file size
+ */
+void dev_funmap(const char *data, uint32_t size);
+
 /**
  * @ingroup dev_f
  *
@@ -12,6 +12,7 @@
 #include "common/str.h"
 #include "common/kw.h"
 #include "common/blib.h"
+#include "common/blib_math.h"
 #include "common/device.h"
 #include "common/extlib.h"
 #include "common/var_eval.h"
@@ -32,6 +33,20 @@
     v_free((v));                 \
   }
 
+/**
+ * matrix: the value of an element, numbers are read in place
+ */
+static inline var_num_t mat_getval(var_t *e) {
+  switch (e->type) {
+  case V_NUM:
+    return e->v.n;
+  case V_INT:
+    return e->v.i;
+  default:
+    return v_getval(e);
+  }
+}
+
 /**
  * matrix: convert var_t to double[r][c]
  */
@@ -58,13 +73,10 @@ var_num_t *mat_toc(var_t *v, int32_t *rows, int32_t *cols) {
     *rows = 1;
   }
 
-  m = (var_num_t *)malloc(((*rows) * (*cols)) * sizeof(var_num_t));
-  for (int i = 0; i < *rows; i++) {
-    for (int j = 0; j < *cols; j++) {
-      int pos = i * (*cols) + j;
-      var_t *e = v_elem(v, pos);
-      m[pos] = v_getval(e);
-    }
+  int size = (*rows) * (*cols);
+  m = (var_num_t *)malloc(size * sizeof(var_num_t));
+  for (int pos = 0; pos < size; pos++) {
+    m[pos] = mat_getval(v_elem(v, pos));
   }
 
   return m;
@@ -79,13 +91,11 @@ void mat_tov(var_t *v, var_num_t *m, int rows, int cols, int protect_col1) {
   } else {
     v_toarray1(v, rows);
   }
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      int pos = i * cols + j;
-      var_t *e = v_elem(v, pos);
-      e->type = V_NUM;
-      e->v.n = m[pos];
-    }
+  int size = rows * cols;
+  for (int pos = 0; pos < size; pos++) {
+    var_t *e = v_elem(v, pos);
+    e->type = V_NUM;
+    e->v.n = m[pos];
   }
 }
 
@@ -192,10 +202,11 @@ void mat_sub(var_t *l, var_t *r) {
  */
 void mat_mul_1d(var_t *l, var_t *r) {
   uint32_t size = v_asize(l);
+  v_unshare(r);
   for (uint32_t i = 0; i < size; i++) {
     var_t *elem = v_elem(r, i);
-    var_num_t v1 = v_getval(v_elem(l, i));
-    var_num_t v2 = v_getval(elem);
+    var_num_t v1 = mat_getval(v_elem(l, i));
+    var_num_t v2 = mat_getval(elem);
     v_setreal(elem, (v1 * v2));
   }
 }
@@ -207,8 +218,8 @@ void mat_dot(var_t *l, var_t *r) {
   var_num_t result = 0;
   uint32_t size = v_asize(l);
   for (uint32_t i = 0; i < size; i++) {
-    var_num_t v1 = v_getval(v_elem(l, i));
-    var_num_t v2 = v_getval(v_elem(r, i));
+    var_num_t v1 = mat_getval(v_elem(l, i));
+    var_num_t v2 = mat_getval(v_elem(r, i));
     result += (v1 * v2);
   }
   v_setreal(r, result);
@@ -233,15 +244,7 @@ void mat_mul(var_t *l, var_t *r) {
         mr = lr;
         mc = rc;
         m = (var_num_t *)malloc(sizeof(var_num_t) * mr * mc);
-        for (int i = 0; i < mr; i++) {
-          for (int j = 0; j < mc; j++) {
-            int pos = i * mc + j;
-            m[pos] = 0.0;
-            for (int k = 0; k < lc; k++) {
-              m[pos] = m[pos] + (m1[i * lc + k] * m2[k * rc + j]);
-            }
-          }
-        }
+        mat_product(m1, m2, m, mr, lc, mc);
       }
       free(m1);
       free(m2);
@@ -323,6 +326,10 @@ static inline void oper_add(var_t *r, var_t *left) {
     } else {
       r->v.n = left->v.i - r->v.n;
     }
+  } else if (op == '+' && left->type == V_STR && left->v.p.owner && v_add_inplace(left, r)) {
+    // extended the left side temporary rather than copying both sides
+    v_move(r, left);
+    v_init(left);
   } else {
     if (r->type == V_ARRAY || v_is_type(left, V_ARRAY)) {
       // arrays
@@ -675,6 +682,179 @@ static inline void oper_powr(var_t *r, var_t *left) {
   V_FREE(left);
 }
 
+/**
+ * returns the number held by the plain variable or constant at ip, see
+ * cev_fast_opr() in ceval.c. returns NULL when the variable is not a number
+ */
+static inline var_t *eval_fast_operand(bcip_t *ip, var_t *value) {
+  var_t *result;
+  bcip_t addr;
+
+  switch (prog_source[*ip]) {
+  case kwTYPE_VAR:
+    memcpy(&addr, prog_source + *ip + 1, ADDRSZ);
+    *ip += 1 + ADDRSZ;
+    result = tvar[addr];
+    if (result->type != V_INT && result->type != V_NUM) {
+      result = NULL;
+    }
+    break;
+  case kwTYPE_INT:
+    value->type = V_INT;
+    memcpy(&value->v.i, prog_source + *ip + 1, OS_INTSZ);
+    *ip += 1 + OS_INTSZ;
+    result = value;
+    break;
+  case kwTYPE_NUM:
+    value->type = V_NUM;
+    memcpy(&value->v.n, prog_source + *ip + 1, OS_REALSZ);
+    *ip += 1 + OS_REALSZ;
+    result = value;
+    break;
+  default:
+    result = NULL;
+    break;
+  }
+  return result;
+}
+
+/**
+ * computes the operation between two numbers with the same result as the
+ * oper_xxx() functions. returns 0 for the cases left to the generic code,
+ * including those raising an error
+ */
+static inline int eval_fast_calc(var_t *r, var_t *left, var_t *right, byte type, byte op) {
+  var_num_t lf = (left->type == V_INT) ? left->v.i : left->v.n;
+  var_num_t rf = (right->type == V_INT) ? right->v.i : right->v.n;
+  var_int_t li, ri;
+  int both_int = (left->type == V_INT && right->type == V_INT);
+
+  switch (type) {
+  case kwTYPE_ADDOPR:
+    if (both_int) {
+      r->type = V_INT;
+      r->v.i = (op == '+') ? left->v.i + right->v.i : left->v.i - right->v.i;
+    } else {
+      r->type = V_NUM;
+      r->v.n = (op == '+') ? lf + rf : lf - rf;
+    }
+    return 1;
+
+  case kwTYPE_MULOPR:
+    switch (op) {
+    case '*':
+      r->type = V_NUM;
+      r->v.n = lf * rf;
+      return 1;
+    case '/':
+      if (ABS(rf) == 0) {
+        return 0;
+      }
+      r->type = V_NUM;
+      r->v.n = lf / rf;
+      return 1;
+    case '\\':
+      li = lf;
+      ri = rf;
+      if (ri == 0) {
+        return 0;
+      }
+      r->type = V_INT;
+      r->v.i = li / ri;
+      return 1;
+    case '%':
+    case OPLOG_MOD:
+      ri = rf;
+      if (ri == 0) {
+        return 0;
+      }
+      li = (lf < 0.0) ? -floor(-lf) : floor(lf);
+      r->type = V_INT;
+      r->v.i = li - ri * (li / ri);
+      return 1;
+    default:
+      return 0;
+    }
+
+  case kwTYPE_POWOPR:
+    r->type = V_NUM;
+    r->v.n = pow(lf, rf);
+    return 1;
+
+  case kwTYPE_CMPOPR:
+    // as v_compare()
+    if (both_int) {
+      li = left->v.i - right->v.i;
+      ri = (li < 0 ? -1 : li > 0 ? 1 : 0);
+    } else if (fabs(lf - rf) < EPSILON) {
+      ri = 0;
+    } else {
+      ri = (lf - rf) < 0.0 ? -1 : 1;
+    }
+    switch (op) {
+    case OPLOG_EQ:
+      ri = (ri == 0);
+      break;
+    case OPLOG_GT:
+      ri = (ri > 0);
+      break;
+    case OPLOG_GE:
+      ri = (ri >= 0);
+      break;
+    case OPLOG_LT:
+      ri = (ri < 0);
+      break;
+    case OPLOG_LE:
+      ri = (ri <= 0);
+      break;
+    case OPLOG_NE:
+      ri = (ri != 0);
+      break;
+    default:
+      return 0;
+    }
+    r->type = V_INT;
+    r->v.i = ri;
+    return 1;
+
+  default:
+    return 0;
+  }
+}
+
+/**
+ * [kwTYPE_FASTOPR] left [kwTYPE_EVPUSH] right [kwTYPE_EVPOP] [opr] [op]
+ *
+ * returns 0 when the generic code following the mark is required
+ */
+static inline int eval_fast_opr(var_t *r) {
+  var_t left_value;
+  var_t right_value;
+  var_t result;
+  bcip_t ip = IP + 1;
+
+  var_t *left = eval_fast_operand(&ip, &left_value);
+  if (left == NULL) {
+    return 0;
+  }
+  // skip kwTYPE_EVPUSH
+  ip++;
+  var_t *right = eval_fast_operand(&ip, &right_value);
+  if (right == NULL) {
+    return 0;
+  }
+  // skip kwTYPE_EVPOP
+  ip++;
+  if (!eval_fast_calc(&result, left, right, prog_source[ip], prog_source[ip + 1])) {
+    return 0;
+  }
+  V_FREE(r);
+  r->type = result.type;
+  r->v = result.v;
+  IP = ip + 2;
+  return 1;
+}
+
 static inline void eval_shortc(var_t *r) {
   // short-circuit evaluation
   // see cev_log() in ceval.c for layout details
@@ -718,6 +898,9 @@ static inline void eval_shortc(var_t *r) {
     V_FREE(r);
     r->type = V_INT;
     r->v.i = ri;
+    // the skipped kwTYPE_EVPOP would have consumed the left side
+    eval_sp--;
+    V_FREE2(&eval_stk[eval_sp]);
     // jump to the shortcut offset
     IP += (addr - ADDRSZ);
   }
@@ -792,12 +975,21 @@ static inline void eval_push(var_t *r) {
     eval_stk[eval_sp].v.n = r->v.n;
     break;
   case V_STR:
-    len = r->v.p.length;
     eval_stk[eval_sp].type = V_STR;
-    eval_stk[eval_sp].v.p.ptr = malloc(len + 1);
-    eval_stk[eval_sp].v.p.owner = 1;
-    strcpy(eval_stk[eval_sp].v.p.ptr, r->v.p.ptr);
-    eval_stk[eval_sp].v.p.length = len;
+    if (r->v.p.owner) {
+      // take the buffer, r remains readable until the next operand replaces it
+      eval_stk[eval_sp].v.p.ptr = r->v.p.ptr;
+      eval_stk[eval_sp].v.p.length = r->v.p.length;
+      eval_stk[eval_sp].v.p.owner = r->v.p.owner;
+      r->v.p.owner = 0;
+    } else {
+      len = v_strlen(r);
+      eval_stk[eval_sp].v.p.owner = 1;
+      eval_stk[eval_sp].v.p.ptr = malloc(len + 1);
+      eval_stk[eval_sp].v.p.length = len + 1;
+      memcpy(eval_stk[eval_sp].v.p.ptr, r->v.p.ptr, len);
+      eval_stk[eval_sp].v.p.ptr[len] = '\0';
+    }
     break;
   default:
     v_set(&eval_stk[eval_sp], r);
@@ -1190,6 +1382,7 @@ static inline void eval_callf(var_t *r) {
   case kwFILES:
   case kwINVERSE:
   case kwDETERM:
+  case kwTRANSPOSE:
   case kwJULIAN:
   case kwDATEFMT:
   case kwWDAY:
@@ -1200,6 +1393,7 @@ static inline void eval_callf(var_t *r) {
   case kwIMAGE:
   case kwFORM:
   case kwWINDOW:
+  case kwCAPTURE:
     eval_callf_genfunc(fcode, r);
     break;
   case kwTICKS:
@@ -1219,8 +1413,109 @@ static inline void eval_callf(var_t *r) {
 }
 
 /**
- * executes the expression (Code[IP]) and returns the result (r)
+ * whether the expression at ip is free of reads of the variable at var_ip.
+ * only constants, operators, built-in functions and variables which can not
+ * lead back to the variable are accepted
+ */
+static int eval_is_private(bcip_t ip, bcip_t var_ip) {
+  int level = 0;
+  while (1) {
+    switch (prog_source[ip]) {
+    case kwTYPE_VAR:
+      if (memcmp(prog_source + ip + 1, prog_source + var_ip + 1, ADDRSZ) == 0) {
+        return 0;
+      }
+      switch (tvar[code_peekaddr(ip + 1)]->type) {
+      case V_MAP:
+      case V_REF:
+        // may call a method or refer to another variable
+        return 0;
+      }
+      ip += ADDRSZ + 1;
+      break;
+    case kwTYPE_INT:
+      ip += OS_INTSZ + 1;
+      break;
+    case kwTYPE_NUM:
+      ip += OS_REALSZ + 1;
+      break;
+    case kwTYPE_STR:
+      ip += code_peek32(ip + 1) + OS_STRLEN + 1;
+      break;
+    case kwTYPE_CALLF:
+      ip += CODESZ + 1;
+      break;
+    case kwTYPE_LOGOPR:
+    case kwTYPE_CMPOPR:
+    case kwTYPE_ADDOPR:
+    case kwTYPE_MULOPR:
+    case kwTYPE_POWOPR:
+    case kwTYPE_UNROPR:
+    case kwTYPE_SEP:
+      ip += 2;
+      break;
+    case kwTYPE_EVAL_SC:
+      ip += ADDRSZ + 3;
+      break;
+    case kwTYPE_LEVEL_BEGIN:
+      level++;
+      ip++;
+      break;
+    case kwTYPE_LEVEL_END:
+      level--;
+      ip++;
+      break;
+    case kwTYPE_EVPUSH:
+    case kwTYPE_EVPOP:
+    case kwTYPE_FASTOPR:
+      ip++;
+      break;
+    case kwTYPE_EOC:
+      if (level == 0) {
+        return 1;
+      }
+      ip++;
+      break;
+    case kwTYPE_LINE:
+      return level == 0;
+    default:
+      return 0;
+    }
+  }
+}
+
+/**
+ * whether the expression at IP can be evaluated with eval_append(), being
+ * the variable at var_ip followed by an operator and code not reading it
  */
+int eval_is_append(bcip_t var_ip) {
+  bcip_t ip = IP;
+  if (prog_source[ip] == kwTYPE_FASTOPR) {
+    // the operands are not numbers
+    ip++;
+  }
+  return (prog_source[ip] == kwTYPE_VAR &&
+          prog_source[ip + ADDRSZ + 1] == kwTYPE_EVPUSH &&
+          prog_source[ip + ADDRSZ + 2] != kwTYPE_EVAL_SC &&
+          memcmp(prog_source + var_ip + 1, prog_source + ip + 1, ADDRSZ) == 0 &&
+          eval_is_private(ip + ADDRSZ + 2, var_ip));
+}
+
+/**
+ * evaluates an expression starting with the string variable var. var keeps
+ * a view of its buffer until the caller assigns the result
+ */
+void eval_append(var_t *r, var_t *var) {
+  if (CODE(IP) == kwTYPE_FASTOPR) {
+    IP++;
+  }
+  // skip kwTYPE_VAR, address and kwTYPE_EVPUSH
+  IP += ADDRSZ + 2;
+  eval_push(var);
+  eval(r);
+  eval_sp--;
+}
+
 void eval(var_t *r) {
   var_t *left = NULL;
   bcip_t eval_pos = eval_sp;
@@ -1283,11 +1578,16 @@ void eval(var_t *r) {
       oper_unary(r);
       break;
 
-    case kwTYPE_VAR:
-      // variable
+    case kwTYPE_VAR: {
+      // variable, the shared containers are not copied for reading
       V_FREE(r);
-      eval_var(r, code_getvarptr());
+      int readonly = v_readonly;
+      v_readonly = 1;
+      var_t *var_p = code_getvarptr();
+      v_readonly = readonly;
+      eval_var(r, var_p);
       break;
+    }
 
     case kwTYPE_LEVEL_BEGIN:
       // left parenthesis
@@ -1334,6 +1634,19 @@ void eval(var_t *r) {
       eval_callf(r);
       break;
 
+    case kwTYPE_FASTOPR:
+      // numeric operation, or continue with the generic code
+      if (!eval_fast_opr(r)) {
+        IP++;
+      }
+      break;
+
+    case kwTYPE_EOC:
+    case kwTYPE_LINE:
+      // end of the command
+      eval_sp = eval_pos;
+      return;
+
     case kwTYPE_CALL_UDF:
       eval_call_udf(r);
       break;
@@ -42,6 +42,7 @@
 #define PATH_SIZE 1024
 
 typedef int (*sblib_exec_fn)(int, int, slib_par_t *, var_t *);
+typedef const slib_fast_t *(*sblib_fast_fn)(int);
 
 typedef struct {
   char name[NAME_SIZE];
@@ -49,6 +50,7 @@ typedef struct {
   void *handle;
   sblib_exec_fn sblib_proc_exec;
   sblib_exec_fn sblib_func_exec;
+  const slib_fast_t **fast_funcs;
   uint32_t id;
   uint32_t flags;
   uint32_t first_proc;
@@ -56,14 +58,14 @@ typedef struct {
   uint8_t  imported;
 } slib_t;
 
-static slib_t slib_table[MAX_SLIBS];
-static uint32_t slib_count;
-static uint32_t extprocsize;
-static uint32_t extproccount;
-static uint32_t extfuncsize;
-static uint32_t extfunccount;
-static ext_func_node_t *extfunctable;
-static ext_proc_node_t *extproctable;
+static SB_THREAD_LOCAL slib_t slib_table[MAX_SLIBS];
+static SB_THREAD_LOCAL uint32_t slib_count;
+static SB_THREAD_LOCAL uint32_t extprocsize;
+static SB_THREAD_LOCAL uint32_t extproccount;
+static SB_THREAD_LOCAL uint32_t extfuncsize;
+static SB_THREAD_LOCAL uint32_t extfunccount;
+static SB_THREAD_LOCAL ext_func_node_t *extfunctable;
+static SB_THREAD_LOCAL ext_proc_node_t *extproctable;
 
 #if defined(LNX_EXTLIB)
 int slib_llopen(slib_t *lib) {
@@ -259,10 +261,21 @@ void slib_import_routines(slib_t *lib, int comp) {
 
   fcount = slib_getoptptr(lib, "sblib_func_count");
   fgetname = slib_getoptptr(lib, "sblib_func_getname");
+  sblib_fast_fn ffast = slib_getoptptr(lib, "sblib_func_fast");
 
   if (fcount && fgetname) {
     int count = fcount();
+    if (ffast && count > 0) {
+      lib->fast_funcs = calloc(count, sizeof(slib_fast_t *));
+    }
     for (int i = 0; i < count; i++) {
+      const slib_fast_t *fast = lib->fast_funcs ? ffast(i) : NULL;
+      if (fast && fast->version == SBLIB_FAST_VERSION && fast->fn &&
+          strlen(fast->args) <= MAX_PARAM &&
+          strspn(fast->args, "in") == strlen(fast->args) &&
+          (fast->retval == 'i' || fast->retval == 'n')) {
+        lib->fast_funcs[i] = fast;
+      }
       if (fgetname(i, buf)) {
         strupper(buf);
         if (slib_add_external_func(buf, lib->id) == -1) {
@@ -456,6 +469,8 @@ void slib_close() {
       }
       slib_llclose(lib);
     }
+    free(lib->fast_funcs);
+    lib->fast_funcs = NULL;
   }
   if (slib_count) {
     free(extproctable);
@@ -471,11 +486,11 @@ void slib_close() {
 }
 
 /**
- * build parameter table
+ * build parameter table. the values of expressions are held in the
+ * caller's args, variables are passed by reference
  */
-int slib_build_ptable(slib_par_t *ptable) {
+int slib_build_ptable(slib_par_t *ptable, var_t *args) {
   int pcount = 0;
-  var_t *arg;
   bcip_t ofs;
 
   if (code_peek() == kwTYPE_LEVEL_BEGIN) {
@@ -498,8 +513,10 @@ int slib_build_ptable(slib_par_t *ptable) {
         ofs = prog_ip;
         if (code_isvar()) {
           // push parameter
-          ptable[pcount].var_p = code_getvarptr();
+          ptable[pcount].var_p = code_getvarptr_pinned();
           ptable[pcount].byref = 1;
+          // the library may write into the array or map
+          v_unshare(ptable[pcount].var_p);
           pcount++;
           break;
         }
@@ -509,16 +526,15 @@ int slib_build_ptable(slib_par_t *ptable) {
         // no 'break' here
       default:
         // default --- expression (BYVAL ONLY)
-        arg = v_new();
-        eval(arg);
+        v_init(&args[pcount]);
+        eval(&args[pcount]);
         if (!prog_error) {
           // push parameter
-          ptable[pcount].var_p = arg;
+          ptable[pcount].var_p = &args[pcount];
           ptable[pcount].byref = 0;
           pcount++;
         } else {
-          v_free(arg);
-          v_detach(arg);
+          v_free(&args[pcount]);
           return pcount;
         }
       }
@@ -539,7 +555,6 @@ void slib_free_ptable(slib_par_t *ptable, int pcount) {
   for (int i = 0; i < pcount; i++) {
     if (ptable[i].byref == 0) {
       v_free(ptable[i].var_p);
-      v_detach(ptable[i].var_p);
     }
   }
 }
@@ -548,18 +563,11 @@ void slib_free_ptable(slib_par_t *ptable, int pcount) {
  * execute a function or procedure
  */
 int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
-  slib_par_t *ptable;
-  int pcount;
-  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
-    ptable = (slib_par_t *)malloc(sizeof(slib_par_t) * MAX_PARAM);
-    pcount = slib_build_ptable(ptable);
-  } else {
-    ptable = NULL;
-    pcount = 0;
-  }
+  slib_par_t ptable[MAX_PARAM];
+  var_t args[MAX_PARAM];
+  int pcount = slib_build_ptable(ptable, args);
   if (prog_error) {
     slib_free_ptable(ptable, pcount);
-    free(ptable);
     return 0;
   }
 
@@ -581,11 +589,86 @@ int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
   }
 
   // clean-up
-  if (ptable) {
-    slib_free_ptable(ptable, pcount);
-    free(ptable);
+  slib_free_ptable(ptable, pcount);
+  return success;
+}
+
+/**
+ * execute a fast-call function, the arguments are converted to the
+ * declared types without creating variables
+ */
+int slib_fast_exec(slib_t *lib, const slib_fast_t *fast, var_t *ret) {
+  slib_value_t args[MAX_PARAM];
+  int argc = strlen(fast->args);
+  int pcount = 0;
+
+  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
+    code_skipnext();
+    byte ready = 0;
+    do {
+      byte code = code_peek();
+      switch (code) {
+      case kwTYPE_EOC:
+        code_skipnext();
+        break;
+      case kwTYPE_SEP:
+        code_skipsep();
+        break;
+      case kwTYPE_LEVEL_END:
+        ready = 1;
+        break;
+      default:
+        if (pcount == argc) {
+          err_parm_num(pcount + 1, argc);
+          break;
+        }
+        var_t arg;
+        var_t *var_p = NULL;
+        bcip_t ofs = prog_ip;
+        if (code == kwTYPE_VAR && code_isvar()) {
+          // read in place
+          var_p = code_getvarptr();
+        } else {
+          prog_ip = ofs;
+          v_init(&arg);
+          eval(&arg);
+        }
+        if (!prog_error) {
+          var_t *value = var_p != NULL ? var_p : &arg;
+          if (fast->args[pcount] == 'i') {
+            args[pcount].i = v_igetval(value);
+          } else {
+            args[pcount].n = v_getval(value);
+          }
+          pcount++;
+        }
+        if (var_p == NULL) {
+          v_free(&arg);
+        }
+      }
+    } while (!ready && !prog_error);
+    if (!prog_error) {
+      // kwTYPE_LEVEL_END
+      code_skipnext();
+    }
+  }
+  if (!prog_error && pcount != argc) {
+    err_parm_num(pcount, argc);
+  }
+  if (prog_error) {
+    return 0;
   }
 
+  slib_value_t retval;
+  int success = fast->fn(args, &retval);
+  v_init(ret);
+  if (!success) {
+    err_throw("LIB:%s: Unspecified error calling FUNC\n", lib->name);
+  } else if (fast->retval == 'i') {
+    v_setint(ret, retval.i);
+  } else {
+    v_setreal(ret, retval.n);
+  }
   return success;
 }
 
@@ -611,7 +694,9 @@ int slib_procexec(int lib_id, int index) {
 int slib_funcexec(int lib_id, int index, var_t *ret) {
   int result;
   slib_t *lib = get_lib(lib_id);
-  if (lib && lib->sblib_func_exec) {
+  if (lib && lib->fast_funcs && lib->fast_funcs[index - lib->first_func]) {
+    result = slib_fast_exec(lib, lib->fast_funcs[index - lib->first_func], ret);
+  } else if (lib && lib->sblib_func_exec) {
     result = slib_exec(lib, ret, index, 0);
   } else {
     result = 0;
@@ -40,6 +40,10 @@
  * procedure or function, the module-manager builds the parameter table
  * and calls the sblib_proc_exec or the sblib_func_exec.
  *
+ * A function declared by sblib_func_fast has a fixed number of integer
+ * or number arguments. It is called directly with the converted values,
+ * without the parameter table.
+ *
  * See modules/example1.c
  * <b>Notes:</b>
  *
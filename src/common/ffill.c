@@ -37,12 +37,12 @@ struct tagQUEUE {
 typedef struct tagQUEUE QUEUE;
 
 // Global variables of the module.
-static struct tagParams ff_buf1[QUEUESIZE];
-static struct tagParams ff_buf2[QUEUESIZE];
-static long ucBorder;
-static QUEUE Qup;
-static QUEUE Qdn;
-static int scan_type;
+static SB_THREAD_LOCAL struct tagParams ff_buf1[QUEUESIZE];
+static SB_THREAD_LOCAL struct tagParams ff_buf2[QUEUESIZE];
+static SB_THREAD_LOCAL long ucBorder;
+static SB_THREAD_LOCAL QUEUE Qup;
+static SB_THREAD_LOCAL QUEUE Qdn;
+static SB_THREAD_LOCAL int scan_type;
 
 uint16_t ff_scan_left(uint16_t, uint16_t, long, int);
 uint16_t ff_scan_right(uint16_t, uint16_t, long, int);
@@ -29,7 +29,7 @@
 #include "lib/match.h"
 
 // FILE TABLE
-static dev_file_t file_table[OS_FILEHANDLES];
+static SB_THREAD_LOCAL dev_file_t file_table[OS_FILEHANDLES];
 
 /**
  * Basic wild-cards
@@ -257,6 +257,28 @@ int dev_fclose(int sb_handle) {
   return 0;
 }
 
+/**
+ * sets the stream buffer size, returns true on success
+ */
+int dev_fbuffer(int sb_handle, uint32_t size) {
+  dev_file_t *f;
+
+  if ((f = dev_getfileptr(sb_handle)) == NULL) {
+    return 0;
+  }
+
+  switch (f->type) {
+  case ft_stream:
+    if (f->handle > 2) {
+      return stream_buffer(f, size);
+    }
+    return 1;
+  default:
+    err_unsup();
+  }
+  return 0;
+}
+
 /**
  * returns true on success
  */
@@ -324,6 +346,32 @@ uint32_t dev_ftell(int sb_handle) {
   return 0;
 }
 
+/**
+ * returns the mapped file contents or NULL
+ */
+const char *dev_fmap(int sb_handle, uint32_t *size) {
+  dev_file_t *f;
+
+  if ((f = dev_getfileptr(sb_handle)) == NULL) {
+    return NULL;
+  }
+
+  switch (f->type) {
+  case ft_stream:
+    return stream_map(f, size);
+  default:
+    break;
+  };
+  return NULL;
+}
+
+/**
+ *
+ */
+void dev_funmap(const char *data, uint32_t size) {
+  stream_unmap(data, size);
+}
+
 /**
  *
  */
@@ -656,7 +704,7 @@ void dev_destroy_file_list(char_p_t *list, int count) {
  * BUG: no drivers supported
  */
 char *dev_getcwd() {
-  static char retbuf[OS_PATHNAME_SIZE + 1];
+  static SB_THREAD_LOCAL char retbuf[OS_PATHNAME_SIZE + 1];
   getcwd(retbuf, OS_PATHNAME_SIZE);
   int l = strlen(retbuf);
   if (retbuf[l - 1] != OS_DIRSEP) {
@@ -126,6 +126,7 @@ int http_read(dev_file_t *f, var_t *var_p) {
   var_p->type = V_STR;
   var_p->v.p.ptr = 0;
   var_p->v.p.length = 0;
+  var_p->v.p.owner = 1;
 
   while (1) {
     int bytes = net_read(f->handle, (char *) rxbuff, sizeof(rxbuff));
@@ -174,6 +175,7 @@ int http_read(dev_file_t *f, var_t *var_p) {
       }
     } else {
       var_p->v.p.ptr = realloc(var_p->v.p.ptr, var_p->v.p.length + bytes + 1);
+      var_p->v.p.owner = 1;
       memcpy(var_p->v.p.ptr + var_p->v.p.length, rxbuff, bytes);
       var_p->v.p.length += bytes;
       var_p->v.p.ptr[var_p->v.p.length] = 0;
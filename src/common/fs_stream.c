@@ -18,6 +18,9 @@
 #include <unistd.h>
 #endif
 #include <dirent.h>
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 
 #if !defined(O_BINARY)
 #define O_BINARY 0
@@ -25,6 +28,8 @@
 
 #include "common/fs_stream.h"
 
+#define STREAM_BUFSIZE 8192
+
 /*
  * open a file
  */
@@ -80,16 +85,57 @@ int stream_open(dev_file_t *f) {
 
   if (f->handle < 0) {
     err_file((f->last_error = errno));
+  } else if (f->handle > 2) {
+    // console devices stay unbuffered
+    stream_buffer(f, STREAM_BUFSIZE);
   }
   return (f->handle >= 0);
 }
 
+/*
+ * writes any pending output and discards any read-ahead data
+ */
+int stream_flush(dev_file_t *f) {
+  int result = 1;
+  if (f->buffer != NULL && f->buf_len) {
+    if (f->open_flags & (DEV_FILE_OUTPUT | DEV_FILE_APPEND)) {
+      int r = write(f->handle, f->buffer, f->buf_len);
+      if (r != (int) f->buf_len) {
+        err_file((f->last_error = errno));
+        result = 0;
+      }
+    } else {
+      // step back over the unread data
+      lseek(f->handle, (long)f->buf_pos - (long)f->buf_len, SEEK_CUR);
+    }
+  }
+  f->buf_pos = 0;
+  f->buf_len = 0;
+  return result;
+}
+
+/*
+ * sets the buffer size, 0 to disable buffering
+ */
+int stream_buffer(dev_file_t *f, uint32_t size) {
+  int result = stream_flush(f);
+  free(f->buffer);
+  f->buffer = size ? malloc(size) : NULL;
+  f->buf_size = size;
+  return result;
+}
+
 /*
  *   close the stream
  */
 int stream_close(dev_file_t *f) {
   int r;
 
+  stream_flush(f);
+  free(f->buffer);
+  f->buffer = NULL;
+  f->buf_size = 0;
+
   r = close(f->handle);
   f->handle = -1;
   if (r) {
@@ -103,6 +149,22 @@ int stream_close(dev_file_t *f) {
 int stream_write(dev_file_t *f, byte *data, uint32_t size) {
   int r;
 
+  if (f->buffer != NULL) {
+    if (f->buf_len + size <= f->buf_size) {
+      memcpy(f->buffer + f->buf_len, data, size);
+      f->buf_len += size;
+      return 1;
+    }
+    if (!stream_flush(f)) {
+      return 0;
+    }
+    if (size < f->buf_size) {
+      memcpy(f->buffer, data, size);
+      f->buf_len = size;
+      return 1;
+    }
+  }
+
   r = write(f->handle, data, size);
   if (r != (int) size) {
     err_file((f->last_error = errno));
@@ -115,6 +177,38 @@ int stream_write(dev_file_t *f, byte *data, uint32_t size) {
 int stream_read(dev_file_t *f, byte *data, uint32_t size) {
   int r;
 
+  if (f->buffer != NULL) {
+    uint32_t avail = f->buf_len - f->buf_pos;
+    if (size <= avail) {
+      memcpy(data, f->buffer + f->buf_pos, size);
+      f->buf_pos += size;
+      return 1;
+    }
+
+    // consume the remaining buffer
+    memcpy(data, f->buffer + f->buf_pos, avail);
+    data += avail;
+    size -= avail;
+    f->buf_pos = f->buf_len = 0;
+
+    if (size < f->buf_size) {
+      r = read(f->handle, f->buffer, f->buf_size);
+      if (r > 0) {
+        f->buf_len = r;
+      }
+      if (r < (int) size) {
+        if (r > 0) {
+          f->buf_pos = r;
+        }
+        err_file((f->last_error = errno));
+        return 0;
+      }
+      memcpy(data, f->buffer, size);
+      f->buf_pos = size;
+      return 1;
+    }
+  }
+
   r = read(f->handle, data, size);
   if (r != (int) size) {
     err_file((f->last_error = errno));
@@ -126,7 +220,15 @@ int stream_read(dev_file_t *f, byte *data, uint32_t size) {
  * returns the current position
  */
 uint32_t stream_tell(dev_file_t *f) {
-  return lseek(f->handle, 0, SEEK_CUR);
+  uint32_t pos = lseek(f->handle, 0, SEEK_CUR);
+  if (f->buffer != NULL) {
+    if (f->open_flags & (DEV_FILE_OUTPUT | DEV_FILE_APPEND)) {
+      pos += f->buf_len;
+    } else {
+      pos -= (f->buf_len - f->buf_pos);
+    }
+  }
+  return pos;
 }
 
 /*
@@ -135,6 +237,7 @@ uint32_t stream_tell(dev_file_t *f) {
 uint32_t stream_length(dev_file_t *f) {
   long pos, endpos;
 
+  stream_flush(f);
   pos = lseek(f->handle, 0, SEEK_CUR);
   if (pos != -1) {
     endpos = lseek(f->handle, 0, SEEK_END);
@@ -149,6 +252,7 @@ uint32_t stream_length(dev_file_t *f) {
 /*
  */
 uint32_t stream_seek(dev_file_t *f, uint32_t offset) {
+  stream_flush(f);
   return lseek(f->handle, offset, SEEK_SET);
 }
 
@@ -157,6 +261,11 @@ uint32_t stream_seek(dev_file_t *f, uint32_t offset) {
 int stream_eof(dev_file_t *f) {
   long pos, endpos;
 
+  if (f->buffer != NULL && f->buf_pos < f->buf_len) {
+    return 0;
+  }
+
+  stream_flush(f);
   pos = lseek(f->handle, 0, SEEK_CUR);
   if (pos != -1) {
     endpos = lseek(f->handle, 0, SEEK_END);
@@ -167,3 +276,38 @@ int stream_eof(dev_file_t *f) {
   }
   return 1;
 }
+
+/*
+ * maps the whole of a regular file, returns NULL when not supported
+ */
+const char *stream_map(dev_file_t *f, uint32_t *size) {
+  const char *result = NULL;
+#if defined(HAVE_MMAP)
+  struct stat st;
+  if (f->handle > 2 && fstat(f->handle, &st) == 0 &&
+      S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < INT32_MAX) {
+    stream_flush(f);
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    // prefault the pages, the caller reads the entire file
+    flags |= MAP_POPULATE;
+#endif
+    void *data = mmap(NULL, st.st_size, PROT_READ, flags, f->handle, 0);
+    if (data != MAP_FAILED) {
+      *size = st.st_size;
+      result = (const char *)data;
+    }
+  }
+#endif
+  return result;
+}
+
+/*
+ */
+void stream_unmap(const char *data, uint32_t size) {
+#if defined(HAVE_MMAP)
+  if (data != NULL) {
+    munmap((void *)data, size);
+  }
+#endif
+}
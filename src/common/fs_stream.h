@@ -21,5 +21,9 @@ uint32_t stream_tell(dev_file_t *f);
 uint32_t stream_length(dev_file_t *f);
 uint32_t stream_seek(dev_file_t *f, uint32_t offset);
 int stream_eof(dev_file_t *f);
+int stream_flush(dev_file_t *f);
+int stream_buffer(dev_file_t *f, uint32_t size);
+const char *stream_map(dev_file_t *f, uint32_t *size);
+void stream_unmap(const char *data, uint32_t size);
 
 #endif
@@ -15,47 +15,44 @@
 #include "common/hashmap.h"
 
 #define MAP_SIZE 32
+#define MAP_EMPTY 0
 
 /**
- * Our internal tree element node
+ * An element stored in insertion order
  */
-typedef struct Node {
+typedef struct Entry {
   var_p_t key;
   var_p_t value;
-  struct Node *left, *right;
-} Node;
+  uint32_t hash;
+} Entry;
 
 /**
- * Returns a new tree node
+ * The map structure. the slots are an open addressing (linear probing) index
+ * into the contiguous entries, each slot holds the entry position + 1. the
+ * structure is shared between variables until one of them is written
  */
-Node *tree_create_node(var_p_t key) {
-  Node *node = (Node *)malloc(sizeof(Node));
-  node->key = key;
-  node->value = NULL;
-  node->left = NULL;
-  node->right = NULL;
-  return node;
-}
+typedef struct Map {
+  uint32_t *slots;
+  Entry *entries;
+  uint32_t capacity;
+  uint32_t refs;
+  uint32_t pinned;
+} Map;
 
 /**
  * cleanup the given element
  */
-void tree_delete_node(Node *node) {
+static void hashmap_delete_entry(Entry *entry) {
   // cleanup v_new
-  v_free(node->key);
-  v_detach(node->key);
+  v_free(entry->key);
+  v_detach(entry->key);
 
   // cleanup v_new
-  if (node->value) {
-    v_free(node->value);
-    v_detach(node->value);
-  }
-
-  // cleanup the node
-  free(node);
+  v_free(entry->value);
+  v_detach(entry->value);
 }
 
-static inline int tree_compare(const char *key, int length, var_p_t vkey) {
+static inline int hashmap_compare(const char *key, int length, var_p_t vkey) {
   int len1 = length;
   if (len1 && key[len1 - 1] == '\0') {
     len1--;
@@ -67,55 +64,109 @@ static inline int tree_compare(const char *key, int length, var_p_t vkey) {
   return strcaselessn(key, len1, vkey->v.p.ptr, len2);
 }
 
-void tree_destroy(Node *node) {
-  if (node->left != NULL) {
-    tree_destroy(node->left);
-  }
-  if (node->right != NULL) {
-    tree_destroy(node->right);
+/**
+ * FNV-1a over the case-folded key
+ */
+static inline uint32_t hashmap_get_hash(const char *key, int length) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < length && key[i] != '\0'; i++) {
+    hash ^= (uint8_t)to_lower(key[i]);
+    hash *= 16777619u;
   }
-  tree_delete_node(node);
+  return hash;
 }
 
-Node *tree_search(Node **rootp, const char *key, int length) {
-  while (*rootp != NULL) {
-    int r = tree_compare(key, length, (*rootp)->key);
-    if (r == 0) {
-      return *rootp;
-    }
-    rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
+/**
+ * returns the number of slots required to hold size elements below
+ * the maximum load factor of 75%
+ */
+static uint32_t hashmap_slot_count(int size) {
+  uint32_t result = MAP_SIZE;
+  while (result * 3 < (uint32_t)size * 4) {
+    result <<= 1;
   }
-  Node *result = tree_create_node(NULL);
-  *rootp = result;
   return result;
 }
 
-Node *tree_find(Node **rootp, const char *key, int length) {
-  while (*rootp != NULL) {
-    int r = tree_compare(key, length, (*rootp)->key);
-    if (r == 0) {
-      return *rootp;
+/**
+ * returns the slot holding the key, or the empty slot where it belongs
+ */
+static inline uint32_t hashmap_probe(var_p_t map, const char *key, int length, uint32_t hash) {
+  Map *data = (Map *)map->v.m.map;
+  uint32_t mask = map->v.m.size - 1;
+  uint32_t index = hash & mask;
+  while (data->slots[index] != MAP_EMPTY) {
+    Entry *entry = &data->entries[data->slots[index] - 1];
+    if (entry->hash == hash && hashmap_compare(key, length, entry->key) == 0) {
+      break;
     }
-    rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
+    index = (index + 1) & mask;
   }
-  return NULL;
+  return index;
 }
 
-int tree_foreach(const Node *nodep, hashmap_foreach_func func, hashmap_cb *data) {
-  if (nodep != NULL) {
-    if (nodep->left != NULL && !tree_foreach(nodep->left, func, data)) {
-      return 0;
+/**
+ * doubles the slot table, the cached hashes avoid rehashing the keys
+ */
+static void hashmap_grow(var_p_t map) {
+  Map *data = (Map *)map->v.m.map;
+  uint32_t size = map->v.m.size << 1;
+  uint32_t mask = size - 1;
+  free(data->slots);
+  data->slots = calloc(size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < map->v.m.count; i++) {
+    uint32_t index = data->entries[i].hash & mask;
+    while (data->slots[index] != MAP_EMPTY) {
+      index = (index + 1) & mask;
     }
+    data->slots[index] = i + 1;
+  }
+  map->v.m.size = size;
+}
 
-    if (func(data, nodep->key, nodep->value)) {
-      return 0;
+/**
+ * returns the entry for the given key, creating an empty entry when not found.
+ * a shared map is first detached, unless only reading an existing entry
+ */
+static Entry *hashmap_search(var_p_t map, const char *key, int length) {
+  uint32_t hash = hashmap_get_hash(key, length);
+  uint32_t index = hashmap_probe(map, key, length, hash);
+  Map *data = (Map *)map->v.m.map;
+  Entry *result;
+  if (data->refs > 1 && (!v_readonly || data->slots[index] == MAP_EMPTY)) {
+    hashmap_unshare(map);
+    data = (Map *)map->v.m.map;
+  }
+  if (data->slots[index] != MAP_EMPTY) {
+    result = &data->entries[data->slots[index] - 1];
+  } else {
+    if (map->v.m.count == data->capacity) {
+      data->capacity <<= 1;
+      data->entries = realloc(data->entries, data->capacity * sizeof(Entry));
     }
-
-    if (nodep->right != NULL && !tree_foreach(nodep->right, func, data)) {
-      return 0;
+    result = &data->entries[map->v.m.count];
+    result->key = NULL;
+    result->value = NULL;
+    result->hash = hash;
+    data->slots[index] = ++map->v.m.count;
+    if (map->v.m.count * 4 > map->v.m.size * 3) {
+      hashmap_grow(map);
     }
   }
-  return 1;
+  return result;
+}
+
+static inline Entry *hashmap_find(var_p_t map, const char *key) {
+  int length = strlen(key);
+  uint32_t index = hashmap_probe(map, key, length, hashmap_get_hash(key, length));
+  Map *data = (Map *)map->v.m.map;
+  Entry *result;
+  if (data->slots[index] != MAP_EMPTY) {
+    result = &data->entries[data->slots[index] - 1];
+  } else {
+    result = NULL;
+  }
+  return result;
 }
 
 /**
@@ -125,97 +176,95 @@ void hashmap_create(var_p_t map, int size) {
   v_free(map);
   map->type = V_MAP;
   map->v.m.count = 0;
-  if (size == 0) {
-    map->v.m.size = MAP_SIZE;
-  } else {
-    map->v.m.size = (size * 100) / 75;
+  map->v.m.size = hashmap_slot_count(size);
+  Map *data = (Map *)malloc(sizeof(Map));
+  data->slots = calloc(map->v.m.size, sizeof(uint32_t));
+  data->capacity = size > 0 ? size : MAP_SIZE;
+  data->entries = malloc(data->capacity * sizeof(Entry));
+  data->refs = 1;
+  data->pinned = 0;
+  map->v.m.map = data;
+}
+
+void hashmap_share(var_p_t map) {
+  if (map->type == V_MAP && map->v.m.map != NULL) {
+    ((Map *)map->v.m.map)->refs++;
   }
-  map->v.m.map = calloc(map->v.m.size, sizeof(Node *));
 }
 
-int hashmap_destroy(var_p_t var_p) {
-  if (var_p->type == V_MAP && var_p->v.m.map != NULL) {
-    Node **table = (Node **)var_p->v.m.map;
-    for (int i = 0; i < var_p->v.m.size; i++) {
-      if (table[i] != NULL) {
-        tree_destroy(table[i]);
-      }
+void hashmap_unshare(var_p_t map) {
+  Map *src = map->type == V_MAP ? (Map *)map->v.m.map : NULL;
+  if (src != NULL && src->refs > 1) {
+    // same layout, the slots index the copied entries unchanged
+    Map *data = (Map *)malloc(sizeof(Map));
+    data->capacity = src->capacity;
+    data->refs = 1;
+    data->pinned = 0;
+    data->slots = malloc(map->v.m.size * sizeof(uint32_t));
+    data->entries = malloc(data->capacity * sizeof(Entry));
+    memcpy(data->slots, src->slots, map->v.m.size * sizeof(uint32_t));
+    for (uint32_t i = 0; i < map->v.m.count; i++) {
+      Entry *entry = &data->entries[i];
+      entry->key = v_clone(src->entries[i].key);
+      entry->value = v_clone(src->entries[i].value);
+      entry->hash = src->entries[i].hash;
     }
-    free(var_p->v.m.map);
+    src->refs--;
+    map->v.m.map = data;
   }
-  return 0;
 }
 
-int hashmap_get_hash(const char *key, int length) {
-  int hash = 1, i;
-  for (i = 0; i < length && key[i] != '\0'; i++) {
-    hash += to_lower(key[i]);
-    hash <<= 3;
-    hash ^= (hash >> 3);
+/**
+ * detaches the map and keeps it from being shared again, a reference to one
+ * of its values is held
+ */
+void hashmap_pin(var_p_t map) {
+  hashmap_unshare(map);
+  if (map->type == V_MAP && map->v.m.map != NULL) {
+    ((Map *)map->v.m.map)->pinned = 1;
   }
-  return hash;
 }
 
-static inline Node *hashmap_search(var_p_t map, const char *key, int length) {
-  int index = hashmap_get_hash(key, length) % map->v.m.size;
-  Node **table = (Node **)map->v.m.map;
-  Node *result = table[index];
-  if (result == NULL) {
-    // new entry
-    result = table[index] = tree_create_node(NULL);
-  } else {
-    int r = tree_compare(key, length, result->key);
-    if (r < 0) {
-      result = tree_search(&result->left, key, length);
-    } else if (r > 0) {
-      result = tree_search(&result->right, key, length);
-    }
-  }
-  return result;
+int hashmap_is_pinned(const var_p_t map) {
+  return map->type == V_MAP && map->v.m.map != NULL && ((Map *)map->v.m.map)->pinned;
 }
 
-static inline Node *hashmap_find(var_p_t map, const char *key) {
-  int length = strlen(key);
-  int index = hashmap_get_hash(key, length) % map->v.m.size;
-  Node **table = (Node **)map->v.m.map;
-  Node *result = table[index];
-  if (result != NULL) {
-    int r = tree_compare(key, length, result->key);
-    if (r < 0 && result->left != NULL) {
-      result = tree_find(&result->left, key, length);
-    } else if (r > 0 && result->right != NULL) {
-      result = tree_find(&result->right, key, length);
-    } else if (r != 0) {
-      result = NULL;
+int hashmap_destroy(var_p_t var_p) {
+  if (var_p->type == V_MAP && var_p->v.m.map != NULL &&
+      --((Map *)var_p->v.m.map)->refs == 0) {
+    Map *data = (Map *)var_p->v.m.map;
+    for (uint32_t i = 0; i < var_p->v.m.count; i++) {
+      hashmap_delete_entry(&data->entries[i]);
     }
+    free(data->slots);
+    free(data->entries);
+    free(data);
   }
-  return result;
+  return 0;
 }
 
 var_p_t hashmap_put(var_p_t map, const char *key, int length) {
-  Node *node = hashmap_search(map, key, length);
-  if (node->key == NULL) {
-    node->key = v_new();
-    node->value = v_new();
-    v_setstrn(node->key, key, length);
-    map->v.m.count++;
+  Entry *entry = hashmap_search(map, key, length);
+  if (entry->key == NULL) {
+    entry->key = v_new();
+    entry->value = v_new();
+    v_setstrn(entry->key, key, length);
   }
-  return node->value;
+  return entry->value;
 }
 
 var_p_t hashmap_putc(var_p_t map, const char *key, int length) {
-  Node *node = hashmap_search(map, key, length);
-  if (node->key == NULL) {
+  Entry *entry = hashmap_search(map, key, length);
+  if (entry->key == NULL) {
     var_t *var_key = v_new();
     var_key->type = V_STR;
     var_key->v.p.length = length;
     var_key->v.p.ptr = (char *)key;
     var_key->v.p.owner = 0;
-    node->key = var_key;
-    node->value = v_new();
-    map->v.m.count++;
+    entry->key = var_key;
+    entry->value = v_new();
   }
-  return node->value;
+  return entry->value;
 }
 
 var_p_t hashmap_putv(var_p_t map, const var_p_t key) {
@@ -225,24 +274,23 @@ var_p_t hashmap_putv(var_p_t map, const var_p_t key) {
     v_tostr(key);
   }
 
-  Node *node = hashmap_search(map, key->v.p.ptr, key->v.p.length);
-  if (node->key == NULL) {
-    node->key = key;
-    node->value = v_new();
-    map->v.m.count++;
+  Entry *entry = hashmap_search(map, key->v.p.ptr, key->v.p.length);
+  if (entry->key == NULL) {
+    entry->key = key;
+    entry->value = v_new();
   } else {
     // discard unused key
     v_free(key);
     v_detach(key);
   }
-  return node->value;
+  return entry->value;
 }
 
 var_p_t hashmap_get(var_p_t map, const char *key) {
   var_p_t result;
-  Node *node = hashmap_find(map, key);
-  if (node != NULL) {
-    result = node->value;
+  Entry *entry = hashmap_find(map, key);
+  if (entry != NULL) {
+    result = entry->value;
   } else {
     result = NULL;
   }
@@ -251,13 +299,22 @@ var_p_t hashmap_get(var_p_t map, const char *key) {
 
 void hashmap_foreach(var_p_t map, hashmap_foreach_func func, hashmap_cb *data) {
   if (map && map->type == V_MAP) {
-    Node **table = (Node **)map->v.m.map;
-    for (int i = 0; i < map->v.m.size; i++) {
-      if (table[i] != NULL) {
-        if (!tree_foreach(table[i], func, data)) {
-          break;
-        }
+    for (uint32_t i = 0; i < map->v.m.count; i++) {
+      // reload since the callback may add entries
+      Entry *entry = &((Map *)map->v.m.map)->entries[i];
+      if (func(data, entry->key, entry->value)) {
+        break;
       }
     }
   }
 }
+
+var_p_t hashmap_key_at(var_p_t map, int index) {
+  var_p_t result;
+  if (map && map->type == V_MAP && index >= 0 && index < map->v.m.count) {
+    result = ((Map *)map->v.m.map)->entries[index].key;
+  } else {
+    result = NULL;
+  }
+  return result;
+}
@@ -169,6 +169,8 @@ static inline void v_init(var_t *v) {
   v->type = V_INT;
   v->const_flag = 0;
   v->v.i = 0;
+  // a stale STR_GROWABLE would claim a buffer larger than the next one
+  v->v.p.owner = 0;
 }
 
 /**
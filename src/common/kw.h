@@ -177,6 +177,7 @@ enum keyword {                // line 50
   kwCATCH,
   kwENDTRY,
   kwFUNC_RETURN,
+  kwTYPE_FASTOPR, /* Numeric operation between two plain operands */
   kwNULL
 };
 
@@ -403,6 +404,8 @@ enum func_keywords {
   kwIMAGE,
   kwFORM,
   kwTIMESTAMP,
+  kwCAPTURE,
+  kwTRANSPOSE,
   kwNULLFUNC
 };
 
@@ -62,6 +62,29 @@ void bc_loop(int isf);
  */
 void eval(var_t *result);
 
+/**
+ * @ingroup exec
+ *
+ * evaluate the next expression, which begins with the string variable 'var'
+ * followed by an operator. the variable's buffer is moved rather than copied
+ * so that concatenation can grow it in place.
+ *
+ * @param result the variable to store the result.
+ * @param var the owned string variable.
+ */
+void eval_append(var_t *result, var_t *var);
+
+/**
+ * @ingroup exec
+ *
+ * whether the next expression can be evaluated with eval_append, the rest
+ * of the expression must not read the variable since its buffer is moved
+ *
+ * @param var_ip the IP of the variable being assigned
+ * @return non-zero when eval_append can be used
+ */
+int eval_is_append(bcip_t var_ip);
+
 /**
  * @ingroup exec
  *
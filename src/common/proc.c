@@ -159,6 +159,7 @@ void pv_write_str(char *str, var_t *vp) {
     strcpy(vp->v.p.ptr, str);
   } else {
     vp->v.p.ptr = realloc(vp->v.p.ptr, vp->v.p.length + 1);
+    vp->v.p.owner = 1;
     strcat(vp->v.p.ptr, str);
   }
 }
@@ -0,0 +1,455 @@
+// This file is part of SmallBASIC
+//
+// Execution profiler
+//
+// The time between two line marks is charged to the first line and to
+// the node of the call tree for the running SUB/FUNC. The call tree
+// follows the program stack, so calls left by EXIT, THROW or an error
+// are closed once their call node has gone.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#include "common/sys.h"
+#include "common/kw.h"
+#include "common/smbas.h"
+#include "common/units.h"
+#include "common/profile.h"
+
+#define PROFILE_NONE 0xFFFFFFFF
+#define PROFILE_SIZE 256
+#define PROFILE_FOLDED ".folded"
+
+/**
+ * An open addressing index of 64 bit keys, the position of a key
+ * is the position of its record in the table using the index
+ */
+typedef struct profile_index_t {
+  uint64_t *keys;
+  uint32_t *slots;
+  uint32_t size;
+  uint32_t count;
+} profile_index_t;
+
+typedef struct profile_file_t {
+  char *path;
+} profile_file_t;
+
+typedef struct profile_line_t {
+  uint32_t file;
+  uint32_t line;
+  uint64_t count;
+  uint64_t ns;
+} profile_line_t;
+
+typedef struct profile_func_t {
+  uint32_t file;
+  uint32_t line;
+  char *name;
+  uint64_t calls;
+} profile_func_t;
+
+typedef struct profile_node_t {
+  uint32_t parent;
+  uint32_t func;
+  uint64_t ns;
+} profile_node_t;
+
+typedef struct profile_frame_t {
+  uint32_t node;
+  uint32_t line;
+  uint32_t sp;
+  int tid;
+} profile_frame_t;
+
+static SB_THREAD_LOCAL profile_file_t *files;
+static SB_THREAD_LOCAL uint32_t file_count;
+static SB_THREAD_LOCAL profile_index_t line_index;
+static SB_THREAD_LOCAL profile_line_t *lines;
+static SB_THREAD_LOCAL profile_index_t func_index;
+static SB_THREAD_LOCAL profile_func_t *funcs;
+static SB_THREAD_LOCAL profile_index_t node_index;
+static SB_THREAD_LOCAL profile_node_t *nodes;
+static SB_THREAD_LOCAL profile_frame_t *frames;
+static SB_THREAD_LOCAL uint32_t frame_count;
+static SB_THREAD_LOCAL uint32_t frame_size;
+static SB_THREAD_LOCAL uint32_t cur_node;
+static SB_THREAD_LOCAL uint32_t cur_line;
+static SB_THREAD_LOCAL uint32_t cur_file;
+static SB_THREAD_LOCAL int cur_tid;
+static SB_THREAD_LOCAL uint64_t last_ns;
+static SB_THREAD_LOCAL uint64_t start_ns;
+
+static uint64_t profile_clock() {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+  return (uint64_t)dev_get_millisecond_count() * 1000000ULL;
+#endif
+}
+
+static inline uint64_t profile_key(uint32_t hi, uint32_t lo) {
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static void profile_index_free(profile_index_t *index) {
+  free(index->keys);
+  free(index->slots);
+  memset(index, 0, sizeof(profile_index_t));
+}
+
+static void profile_index_grow(profile_index_t *index) {
+  uint32_t size = index->size ? index->size << 1 : PROFILE_SIZE;
+  uint32_t mask = size - 1;
+  free(index->slots);
+  index->slots = malloc(size * sizeof(uint32_t));
+  memset(index->slots, 0xFF, size * sizeof(uint32_t));
+  index->keys = realloc(index->keys, size * sizeof(uint64_t));
+  for (uint32_t i = 0; i < index->count; i++) {
+    uint32_t slot = (uint32_t)(index->keys[i] * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+    while (index->slots[slot] != PROFILE_NONE) {
+      slot = (slot + 1) & mask;
+    }
+    index->slots[slot] = i;
+  }
+  index->size = size;
+}
+
+/**
+ * returns the position of the key, a new key is added at the end. the
+ * table for the index is resized along with the index
+ */
+static uint32_t profile_lookup(profile_index_t *index, uint64_t key, void **table, size_t rec_size) {
+  if (index->count * 2 >= index->size) {
+    profile_index_grow(index);
+    *table = realloc(*table, index->size * rec_size);
+  }
+  uint32_t mask = index->size - 1;
+  uint32_t slot = (uint32_t)(key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+  while (index->slots[slot] != PROFILE_NONE) {
+    if (index->keys[index->slots[slot]] == key) {
+      return index->slots[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  uint32_t result = index->count++;
+  index->slots[slot] = result;
+  index->keys[result] = key;
+  memset((char *)*table + result * rec_size, 0, rec_size);
+  return result;
+}
+
+/**
+ * returns the length of the path without the extension, so that
+ * units match whether compiled or loaded
+ */
+static int profile_stem_len(const char *path) {
+  const char *dot = strrchr(path, '.');
+  const char *dir = strrchr(path, OS_DIRSEP);
+  return (dot != NULL && (dir == NULL || dot > dir)) ? dot - path : strlen(path);
+}
+
+static uint32_t profile_file(const char *path) {
+  int len = profile_stem_len(path);
+  for (uint32_t i = 0; i < file_count; i++) {
+    if (profile_stem_len(files[i].path) == len && strncmp(files[i].path, path, len) == 0) {
+      return i;
+    }
+  }
+  files = realloc(files, (file_count + 1) * sizeof(profile_file_t));
+  files[file_count].path = strdup(path);
+  return file_count++;
+}
+
+static inline uint32_t profile_child(uint32_t parent, uint32_t func) {
+  uint32_t result = profile_lookup(&node_index, profile_key(parent, func),
+                                   (void **)&nodes, sizeof(profile_node_t));
+  nodes[result].parent = parent;
+  nodes[result].func = func;
+  return result;
+}
+
+/**
+ * charges the elapsed time to the current line and call
+ */
+static inline void profile_tick() {
+  uint64_t now = profile_clock();
+  uint64_t elapsed = now - last_ns;
+  last_ns = now;
+  if (cur_line != PROFILE_NONE) {
+    lines[cur_line].ns += elapsed;
+  }
+  nodes[cur_node].ns += elapsed;
+}
+
+/**
+ * closes the calls whose call node is no longer on the stack
+ */
+static void profile_sync() {
+  while (frame_count > 0) {
+    profile_frame_t *frame = &frames[frame_count - 1];
+    if (taskinfo(frame->tid)->sbe.exec.sp >= frame->sp) {
+      break;
+    }
+    cur_node = frame->node;
+    cur_line = frame->line;
+    frame_count--;
+  }
+}
+
+/**
+ * returns the line of the SUB/FUNC statement, which precedes the
+ * GOTO over the body
+ */
+static uint32_t profile_def_line(bcip_t ip) {
+  uint32_t result = 0;
+  bcip_t jump = ip - 1 - (ADDRSZ + 2);
+  bcip_t mark = jump - (ADDRSZ + 1);
+  if (ip > 2 * ADDRSZ + 4 && ip <= prog_length &&
+      prog_source[jump] == kwGOTO && prog_source[mark] == kwTYPE_LINE) {
+    memcpy(&result, prog_source + mark + 1, sizeof(result));
+  }
+  return result;
+}
+
+void profile_begin(const char *file) {
+  profile_end(NULL);
+  profile_file(file);
+  cur_node = profile_child(PROFILE_NONE, PROFILE_NONE);
+  cur_line = PROFILE_NONE;
+  cur_tid = -1;
+  start_ns = last_ns = profile_clock();
+}
+
+void profile_name(const char *file, bcip_t ip, const char *name) {
+  uint32_t func = profile_lookup(&func_index, profile_key(profile_file(file), ip),
+                                 (void **)&funcs, sizeof(profile_func_t));
+  if (funcs[func].name == NULL) {
+    funcs[func].file = profile_file(file);
+    funcs[func].name = strdup(name);
+  }
+}
+
+void profile_line(int line) {
+  if (ctask->tid != cur_tid) {
+    if (cur_tid == -1) {
+      // the clock starts with the program
+      start_ns = last_ns = profile_clock();
+    }
+    cur_tid = ctask->tid;
+    cur_file = profile_file(prog_file);
+  }
+  profile_tick();
+  profile_sync();
+  cur_line = profile_lookup(&line_index, profile_key(cur_file, line),
+                            (void **)&lines, sizeof(profile_line_t));
+  lines[cur_line].file = cur_file;
+  lines[cur_line].line = line;
+  lines[cur_line].count++;
+}
+
+void profile_enter(bcip_t ip) {
+  profile_tick();
+  profile_sync();
+  uint32_t file = profile_file(prog_file);
+  uint32_t func = profile_lookup(&func_index, profile_key(file, ip),
+                                 (void **)&funcs, sizeof(profile_func_t));
+  if (funcs[func].calls++ == 0) {
+    funcs[func].file = file;
+    funcs[func].line = profile_def_line(ip);
+    for (int i = 0; i < prog_expcount && funcs[func].name == NULL; i++) {
+      // a unit loaded without compiling still names its exports
+      if (prog_exptable[i].type != stt_variable && prog_exptable[i].address + ADDRSZ + 3 == ip) {
+        funcs[func].name = strdup(prog_exptable[i].symbol);
+      }
+    }
+  }
+  if (frame_count == frame_size) {
+    frame_size = frame_size ? frame_size << 1 : PROFILE_SIZE;
+    frames = realloc(frames, frame_size * sizeof(profile_frame_t));
+  }
+  profile_frame_t *frame = &frames[frame_count++];
+  frame->node = cur_node;
+  frame->line = cur_line;
+  frame->sp = prog_sp;
+  frame->tid = ctask->tid;
+  cur_node = profile_child(cur_node, func);
+}
+
+void profile_leave() {
+  profile_tick();
+  profile_sync();
+}
+
+/**
+ * names the SUB/FUNC, those from units are prefixed with the unit name
+ */
+static void profile_func_name(char *buffer, int size, uint32_t func) {
+  if (func == PROFILE_NONE) {
+    strlcpy(buffer, files[0].path, size);
+  } else if (funcs[func].name != NULL && funcs[func].file != 0) {
+    const char *path = files[funcs[func].file].path;
+    const char *base = strrchr(path, OS_DIRSEP);
+    base = base != NULL ? base + 1 : path;
+    snprintf(buffer, size, "%.*s.%s", profile_stem_len(base), base, funcs[func].name);
+  } else if (funcs[func].name != NULL) {
+    strlcpy(buffer, funcs[func].name, size);
+  } else {
+    snprintf(buffer, size, "sub@%s:%d", files[funcs[func].file].path, funcs[func].line);
+  }
+}
+
+static int profile_cmp_ns(const void *a, const void *b) {
+  uint64_t ns_a = **(const uint64_t **)a;
+  uint64_t ns_b = **(const uint64_t **)b;
+  return ns_a < ns_b ? 1 : ns_a > ns_b ? -1 : 0;
+}
+
+static int profile_cmp_line(const void *a, const void *b) {
+  uint64_t ns_a = (*(const profile_line_t **)a)->ns;
+  uint64_t ns_b = (*(const profile_line_t **)b)->ns;
+  return ns_a < ns_b ? 1 : ns_a > ns_b ? -1 : 0;
+}
+
+/**
+ * writes the time spent in each SUB/FUNC and on each line, slowest first
+ */
+static void profile_write_flat(FILE *fp, uint64_t total_ns) {
+  uint32_t count = func_index.count + 1;
+  uint64_t *self = calloc(count, sizeof(uint64_t) * 2);
+  uint64_t *total = self + count;
+  uint64_t *inclusive = calloc(node_index.count, sizeof(uint64_t));
+
+  // children always follow their parent
+  for (uint32_t i = node_index.count; i-- > 0;) {
+    inclusive[i] += nodes[i].ns;
+    if (nodes[i].parent != PROFILE_NONE) {
+      inclusive[nodes[i].parent] += inclusive[i];
+    }
+  }
+  for (uint32_t i = 0; i < node_index.count; i++) {
+    uint32_t func = nodes[i].func == PROFILE_NONE ? func_index.count : nodes[i].func;
+    self[func] += nodes[i].ns;
+    // recursive calls are counted once
+    uint32_t parent = nodes[i].parent;
+    while (parent != PROFILE_NONE && nodes[parent].func != nodes[i].func) {
+      parent = nodes[parent].parent;
+    }
+    if (parent == PROFILE_NONE) {
+      total[func] += inclusive[i];
+    }
+  }
+
+  double scale = total_ns ? 100.0 / total_ns : 0;
+  uint64_t **order = malloc(count * sizeof(uint64_t *));
+  for (uint32_t i = 0; i < count; i++) {
+    order[i] = &self[i];
+  }
+  qsort(order, count, sizeof(uint64_t *), profile_cmp_ns);
+
+  fprintf(fp, "%-32s %10s %12s %12s %7s\n", "SUB/FUNC", "calls", "self ms", "total ms", "self %");
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t func = order[i] - self;
+    if (func == func_index.count) {
+      fprintf(fp, "%-32s %10d", files[0].path, 1);
+    } else if (funcs[func].calls) {
+      char name[OS_PATHNAME_SIZE + 16];
+      profile_func_name(name, sizeof(name), func);
+      fprintf(fp, "%-32s %10llu", name, (unsigned long long)funcs[func].calls);
+    } else {
+      continue;
+    }
+    fprintf(fp, " %12.3f %12.3f %7.2f\n", self[func] / 1e6, total[func] / 1e6, self[func] * scale);
+  }
+  free(order);
+  free(inclusive);
+  free(self);
+
+  profile_line_t **line_order = malloc(line_index.count * sizeof(profile_line_t *));
+  for (uint32_t i = 0; i < line_index.count; i++) {
+    line_order[i] = &lines[i];
+  }
+  qsort(line_order, line_index.count, sizeof(profile_line_t *), profile_cmp_line);
+
+  fprintf(fp, "\n%-32s %10s %12s %7s\n", "line", "count", "time ms", "%");
+  for (uint32_t i = 0; i < line_index.count; i++) {
+    profile_line_t *line = line_order[i];
+    char name[OS_PATHNAME_SIZE + 16];
+    snprintf(name, sizeof(name), "%s:%d", files[line->file].path, line->line);
+    fprintf(fp, "%-32s %10llu %12.3f %7.2f\n", name, (unsigned long long)line->count,
+            line->ns / 1e6, line->ns * scale);
+  }
+  free(line_order);
+}
+
+/**
+ * writes each call stack with its self time in microseconds, the
+ * collapsed format read by flamegraph tools
+ */
+static void profile_write_folded(FILE *fp) {
+  uint32_t *path = NULL;
+  uint32_t path_size = 0;
+  for (uint32_t i = 0; i < node_index.count; i++) {
+    uint64_t us = nodes[i].ns / 1000;
+    if (us) {
+      uint32_t depth = 0;
+      for (uint32_t node = i; node != PROFILE_NONE; node = nodes[node].parent) {
+        if (depth == path_size) {
+          path_size = path_size ? path_size << 1 : PROFILE_SIZE;
+          path = realloc(path, path_size * sizeof(uint32_t));
+        }
+        path[depth++] = nodes[node].func;
+      }
+      while (depth-- > 0) {
+        char name[OS_PATHNAME_SIZE + 16];
+        profile_func_name(name, sizeof(name), path[depth]);
+        fprintf(fp, "%s%c", name, depth ? ';' : ' ');
+      }
+      fprintf(fp, "%llu\n", (unsigned long long)us);
+    }
+  }
+  free(path);
+}
+
+void profile_end(const char *file) {
+  if (file != NULL && node_index.count) {
+    profile_tick();
+    FILE *fp = fopen(file, "w");
+    if (fp != NULL) {
+      uint64_t total_ns = last_ns - start_ns;
+      fprintf(fp, "SmallBASIC profile: %s, %.3f sec\n\n", files[0].path, total_ns / 1e9);
+      profile_write_flat(fp, total_ns);
+      fclose(fp);
+    }
+    char folded[OS_PATHNAME_SIZE + sizeof(PROFILE_FOLDED)];
+    snprintf(folded, sizeof(folded), "%s%s", file, PROFILE_FOLDED);
+    fp = fopen(folded, "w");
+    if (fp != NULL) {
+      profile_write_folded(fp);
+      fclose(fp);
+    }
+  }
+  for (uint32_t i = 0; i < file_count; i++) {
+    free(files[i].path);
+  }
+  for (uint32_t i = 0; i < func_index.count; i++) {
+    free(funcs[i].name);
+  }
+  free(files);
+  free(lines);
+  free(funcs);
+  free(nodes);
+  free(frames);
+  files = NULL;
+  lines = NULL;
+  funcs = NULL;
+  nodes = NULL;
+  frames = NULL;
+  file_count = frame_count = frame_size = 0;
+  profile_index_free(&line_index);
+  profile_index_free(&func_index);
+  profile_index_free(&node_index);
+}
@@ -0,0 +1,77 @@
+// This file is part of SmallBASIC
+//
+// Execution profiler
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#if !defined(_sb_profile_h)
+#define _sb_profile_h
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup exec
+ *
+ * resets the profiler before the program is compiled
+ *
+ * @param file is the program file
+ */
+void profile_begin(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * records the name of a SUB or FUNC while the bytecode is created
+ *
+ * @param file is the source file
+ * @param ip is the address of the first command of the body
+ * @param name is the SUB/FUNC name
+ */
+void profile_name(const char *file, bcip_t ip, const char *name);
+
+/**
+ * @ingroup exec
+ *
+ * charges the time since the previous line then starts timing the line
+ *
+ * @param line is the line about to run
+ */
+void profile_line(int line);
+
+/**
+ * @ingroup exec
+ *
+ * starts timing a SUB/FUNC call, the call node is already on the stack
+ *
+ * @param ip is the address of the first command of the body
+ */
+void profile_enter(bcip_t ip);
+
+/**
+ * @ingroup exec
+ *
+ * ends timing the SUB/FUNC calls whose call node was removed from the stack
+ */
+void profile_leave(void);
+
+/**
+ * @ingroup exec
+ *
+ * writes the flat profile to the given file and the collapsed stacks
+ * to the same name with a ".folded" suffix, then frees the profile
+ *
+ * @param file is the output file
+ */
+void profile_end(const char *file);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -17,6 +17,8 @@
 #include "common/units.h"
 #include "common/extlib.h"
 #include "common/messages.h"
+#include "common/bc_cache.h"
+#include "common/profile.h"
 #include "languages/keywords.en.c"
 
 char *comp_array_uds_field(char *p, bc_t *bc);
@@ -46,6 +48,7 @@ const int LEN_SHOWPAGE   = STRLEN(LCN_SHOWPAGE);
 const int LEN_ANTIALIAS  = STRLEN(LCN_ANTIALIAS);
 const int LEN_LDMODULES  = STRLEN(LCN_LOAD_MODULES);
 const int LEN_AUTOLOCAL  = STRLEN(LCN_AUTOLOCAL);
+const int LEN_OPTIMIZE   = STRLEN(LCN_OPTIMIZE);
 const int LEN_AS_WRS     = STRLEN(LCN_AS_WRS);
 
 #define KW_TYPE_LINE_BYTES 5
@@ -59,6 +62,7 @@ const int LEN_AS_WRS     = STRLEN(LCN_AS_WRS);
   (strncmp(p, (x), strlen((x))) == 0)
 
 #define GROWSIZE 128
+#define INDEX_SIZE 256
 #define MAX_PARAMS 256
 
 // the offset to a single byte stored in an 32 bit field
@@ -101,6 +105,147 @@ void memcat(char *dest, char *p) {
   dest[lenb + lenp] = '\0';
 }
 
+typedef const char *(*comp_index_name_t)(int idx);
+
+static SB_THREAD_LOCAL comp_index_t keyword_index;
+static SB_THREAD_LOCAL comp_index_t func_index;
+static SB_THREAD_LOCAL comp_index_t proc_index;
+static SB_THREAD_LOCAL comp_index_t spopr_index;
+static SB_THREAD_LOCAL comp_index_t opr_index;
+
+/*
+ * FNV-1a over the case-folded name
+ */
+static uint32_t comp_index_hash(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *p = name; *p; p++) {
+    hash ^= (byte)to_lower(*p);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void comp_index_init(comp_index_t *index, uint32_t size) {
+  index->slots = (comp_index_slot_t *)malloc(size * sizeof(comp_index_slot_t));
+  index->size = size;
+  index->count = 0;
+  for (uint32_t i = 0; i < size; i++) {
+    index->slots[i].idx = -1;
+  }
+}
+
+static void comp_index_free(comp_index_t *index) {
+  free(index->slots);
+  index->slots = NULL;
+  index->size = index->count = 0;
+}
+
+static void comp_index_insert(comp_index_t *index, uint32_t hash, int idx) {
+  uint32_t mask = index->size - 1;
+  uint32_t i = hash & mask;
+  while (index->slots[i].idx != -1) {
+    i = (i + 1) & mask;
+  }
+  index->slots[i].hash = hash;
+  index->slots[i].idx = idx;
+  index->count++;
+}
+
+/*
+ * records that the table holds name at position idx
+ */
+static void comp_index_add(comp_index_t *index, const char *name, int idx) {
+  if ((index->count + 1) * 2 > index->size) {
+    // keep the load factor below 50%
+    comp_index_t old = *index;
+    comp_index_init(index, old.size ? old.size * 2 : INDEX_SIZE);
+    for (uint32_t i = 0; i < old.size; i++) {
+      if (old.slots[i].idx != -1) {
+        comp_index_insert(index, old.slots[i].hash, old.slots[i].idx);
+      }
+    }
+    free(old.slots);
+  }
+  comp_index_insert(index, comp_index_hash(name), idx);
+}
+
+/*
+ * returns the lowest table position holding name, matching the former
+ * linear scans when a name was added more than once, or -1
+ */
+static int comp_index_find(comp_index_t *index, const char *name,
+                           comp_index_name_t name_at, int nocase) {
+  int result = -1;
+  if (index->size) {
+    uint32_t hash = comp_index_hash(name);
+    uint32_t mask = index->size - 1;
+    for (uint32_t i = hash & mask; index->slots[i].idx != -1; i = (i + 1) & mask) {
+      int idx = index->slots[i].idx;
+      if (index->slots[i].hash == hash && (result == -1 || idx < result) &&
+          (nocase ? strcasecmp(name_at(idx), name) : strcmp(name_at(idx), name)) == 0) {
+        result = idx;
+      }
+    }
+  }
+  return result;
+}
+
+static const char *comp_var_name(int idx) {
+  return comp_vartable[idx].name;
+}
+
+static const char *comp_label_name(int idx) {
+  return comp_labtable.elem[idx]->name;
+}
+
+static const char *comp_udp_name(int idx) {
+  return comp_udptable[idx].name;
+}
+
+static const char *keyword_name(int idx) {
+  return keyword_table[idx].name;
+}
+
+static const char *func_keyword_name(int idx) {
+  return func_table[idx].name;
+}
+
+static const char *proc_keyword_name(int idx) {
+  return proc_table[idx].name;
+}
+
+static const char *spopr_keyword_name(int idx) {
+  return spopr_table[idx].name;
+}
+
+static const char *opr_keyword_name(int idx) {
+  return opr_table[idx].name;
+}
+
+/*
+ * builds the indexes of the static keyword tables, once per thread
+ */
+static void comp_index_keywords() {
+  if (!keyword_index.size) {
+    int i;
+    for (i = 0; keyword_table[i].name[0] != '\0'; i++) {
+      comp_index_add(&keyword_index, keyword_table[i].name, i);
+    }
+    for (i = 0; func_table[i].name[0] != '\0'; i++) {
+      comp_index_add(&func_index, func_table[i].name, i);
+    }
+    for (i = 0; proc_table[i].name[0] != '\0'; i++) {
+      comp_index_add(&proc_index, proc_table[i].name, i);
+    }
+    for (i = 0; spopr_table[i].name[0] != '\0'; i++) {
+      comp_index_add(&spopr_index, spopr_table[i].name, i);
+    }
+    for (i = 0; opr_table[i].name[0] != '\0'; i++) {
+      comp_index_add(&opr_index, opr_table[i].name, i);
+    }
+  }
+}
+
 /*
  * reset the external proc/func lists
  */
@@ -279,17 +424,11 @@ char *comp_prepare_name(char *dest, const char *source, int size) {
  * returns the ID of the label. If there is no one, then it creates one
  */
 bid_t comp_label_getID(const char *label_name) {
-  bid_t idx = -1, i;
+  bid_t idx;
   char name[SB_KEYWORD_SIZE + 1];
 
   comp_prepare_name(name, label_name, SB_KEYWORD_SIZE);
-
-  for (i = 0; i < comp_labtable.count; i++) {
-    if (strcmp(comp_labtable.elem[i]->name, name) == 0) {
-      idx = i;
-      break;
-    }
-  }
+  idx = comp_index_find(&comp_labindex, name, comp_label_name, 0);
 
   if (idx == -1) {
     if (opt_verbose) {
@@ -312,6 +451,7 @@ bid_t comp_label_getID(const char *label_name) {
     comp_labtable.elem[comp_labtable.count] = label;
     idx = comp_labtable.count;
     comp_labtable.count++;
+    comp_index_add(&comp_labindex, label->name, idx);
   }
 
   return idx;
@@ -370,11 +510,10 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
         strcpy(name, base);
       }
       // search on local
-      for (i = 0; i < comp_udpcount; i++) {
-        if (strcmp(comp_udptable[i].name, name) == 0) {
-          free(root);
-          return i;
-        }
+      i = comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
+      if (i != -1) {
+        free(root);
+        return i;
       }
     } while (len);
 
@@ -384,11 +523,7 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
     comp_prepare_udp_name(name, proc_name);
 
     // search on local
-    for (i = 0; i < comp_udpcount; i++) {
-      if (strcmp(comp_udptable[i].name, name) == 0) {
-        return i;
-      }
-    }
+    return comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
   }
 
   return -1;
@@ -400,7 +535,7 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
  */
 bid_t comp_add_udp(const char *proc_name) {
   char *name = comp_bc_temp;
-  bid_t idx = -1, i;
+  bid_t idx;
   comp_prepare_udp_name(name, proc_name);
 
   /*
@@ -411,12 +546,7 @@ bid_t comp_add_udp(const char *proc_name) {
    */
 
   // search
-  for (i = 0; i < comp_udpcount; i++) {
-    if (strcmp(comp_udptable[i].name, name) == 0) {
-      idx = i;
-      break;
-    }
-  }
+  idx = comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
 
   if (idx == -1) {
     if (comp_udpcount >= comp_udpsize) {
@@ -438,6 +568,7 @@ bid_t comp_add_udp(const char *proc_name) {
       strcpy(comp_udptable[comp_udpcount].name, name);
       idx = comp_udpcount;
       comp_udpcount++;
+      comp_index_add(&comp_udpindex, name, idx);
     }
   }
 
@@ -628,6 +759,7 @@ int comp_create_var(const char *name) {
     comp_vartable[comp_varcount].local_proc_level = 0;
     idx = comp_varcount;
     comp_varcount++;
+    comp_index_add(&comp_varindex, name, idx);
   }
   return idx;
 }
@@ -679,10 +811,9 @@ bid_t comp_var_getID(const char *var_name) {
   // If the name is not found in comp_libtable then it
   // is treated as a structure reference
   if (dot != NULL && comp_check_lib(tmp)) {
-    for (i = 0; i < comp_varcount; i++) {
-      if (strcasecmp(comp_vartable[i].name, tmp) == 0) {
-        return i;
-      }
+    idx = comp_index_find(&comp_varindex, tmp, comp_var_name, 1);
+    if (idx != -1) {
+      return idx;
     }
 
     sc_raise(MSG_MEMBER_DOES_NOT_EXIST, tmp);
@@ -695,25 +826,17 @@ bid_t comp_var_getID(const char *var_name) {
   // however a global var-ID per var-name is required
   //
   strcpy(name, tmp);
-
-  for (i = 0; i < comp_varcount; i++) {
-    if (strcmp(comp_vartable[i].name, name) == 0) {
+  idx = comp_index_find(&comp_varindex, name, comp_var_name, 0);
+
+  int len = strlen(name);
+  if (idx == -1 && len > 1 && name[len - 1] == '$') {
+    // system variables must be visible with or without '$' suffix
+    name[len - 1] = '\0';
+    i = comp_index_find(&comp_varindex, name, comp_var_name, 0);
+    if (i != -1 && comp_vartable[i].dolar_sup) {
       idx = i;
-      break;
-    }
-
-    if (comp_vartable[i].dolar_sup) {
-      // system variables must be visible with or without '$' suffix
-      char *dollar_name = malloc(strlen(comp_vartable[i].name) + 2);
-      strcpy(dollar_name, comp_vartable[i].name);
-      strcat(dollar_name, "$");
-      if (strcmp(dollar_name, name) == 0) {
-        idx = i;
-        free(dollar_name);
-        break;
-      }
-      free(dollar_name);
     }
+    name[len - 1] = '$';
   }
 
   if (opt_autolocal) {
@@ -847,10 +970,10 @@ int comp_is_keyword(const char *name) {
     dolar_sup++;
   }
 
-  for (i = 0; keyword_table[i].name[0] != '\0'; i++) {
-    if (strcmp(keyword_table[i].name, name) == 0) {
-      return keyword_table[i].code;
-    }
+  comp_index_keywords();
+  i = comp_index_find(&keyword_index, name, keyword_name, 0);
+  if (i != -1) {
+    return keyword_table[i].code;
   }
 
   if (dolar_sup) {
@@ -879,10 +1002,10 @@ bid_t comp_is_func(const char *name) {
     dolar_sup++;
   }
 
-  for (i = 0; func_table[i].name[0] != '\0'; i++) {
-    if (strcmp(func_table[i].name, name) == 0) {
-      return func_table[i].fcode;
-    }
+  comp_index_keywords();
+  i = comp_index_find(&func_index, name, func_keyword_name, 0);
+  if (i != -1) {
+    return func_table[i].fcode;
   }
 
   if (dolar_sup) {
@@ -898,10 +1021,10 @@ bid_t comp_is_func(const char *name) {
 bid_t comp_is_proc(const char *name) {
   bid_t i;
 
-  for (i = 0; proc_table[i].name[0] != '\0'; i++) {
-    if (strcmp(proc_table[i].name, name) == 0) {
-      return proc_table[i].pcode;
-    }
+  comp_index_keywords();
+  i = comp_index_find(&proc_index, name, proc_keyword_name, 0);
+  if (i != -1) {
+    return proc_table[i].pcode;
   }
 
   return -1;
@@ -913,10 +1036,10 @@ bid_t comp_is_proc(const char *name) {
 int comp_is_special_operator(const char *name) {
   int i;
 
-  for (i = 0; spopr_table[i].name[0] != '\0'; i++) {
-    if (strcmp(spopr_table[i].name, name) == 0) {
-      return spopr_table[i].code;
-    }
+  comp_index_keywords();
+  i = comp_index_find(&spopr_index, name, spopr_keyword_name, 0);
+  if (i != -1) {
+    return spopr_table[i].code;
   }
 
   return -1;
@@ -928,10 +1051,10 @@ int comp_is_special_operator(const char *name) {
 int comp_is_operator(const char *name) {
   int i;
 
-  for (i = 0; opr_table[i].name[0] != '\0'; i++) {
-    if (strcmp(opr_table[i].name, name) == 0) {
-      return ((opr_table[i].code << 8) | opr_table[i].opr);
-    }
+  comp_index_keywords();
+  i = comp_index_find(&opr_index, name, opr_keyword_name, 0);
+  if (i != -1) {
+    return ((opr_table[i].code << 8) | opr_table[i].opr);
   }
 
   return -1;
@@ -3751,6 +3874,11 @@ bcip_t comp_optimise_let(bcip_t ip, byte kw_opr, char sep, byte opt_kw) {
   return ip;
 }
 
+/*
+ * rewrites commands into their faster forms. the kwTYPE_LINE markers are
+ * kept, even when optimizing: each one sets the line reported by errors,
+ * TRON and the profiler, and also ends the command before it
+ */
 void comp_optimise() {
   for (bcip_t ip = 0; !comp_error && ip < comp_prog.count;
        ip = comp_next_bc_cmd(&comp_prog, ip)) {
@@ -3792,6 +3920,7 @@ void comp_init() {
 
   comp_line = 0;
   comp_error = 0;
+  comp_optimize = opt_optimize;
   comp_labcount = 0;
   comp_expcount = 0;
   comp_impcount = 0;
@@ -3829,6 +3958,10 @@ void comp_init() {
   comp_varsize = comp_udpsize = GROWSIZE;
   comp_varcount = comp_labcount = comp_sp = comp_udpcount = 0;
 
+  comp_index_init(&comp_varindex, INDEX_SIZE);
+  comp_index_init(&comp_labindex, INDEX_SIZE);
+  comp_index_init(&comp_udpindex, INDEX_SIZE);
+
   bc_create(&comp_prog);
   bc_create(&comp_data);
 
@@ -3873,6 +4006,10 @@ void comp_close() {
   }
   free(comp_labtable.elem);
 
+  comp_index_free(&comp_varindex);
+  comp_index_free(&comp_labindex);
+  comp_index_free(&comp_udpindex);
+
   for (i = 0; i < comp_exptable.count; i++) {
     free(comp_exptable.elem[i]);
   }
@@ -3930,6 +4067,9 @@ char *comp_load(const char *file_name) {
     close(h);
   }
 #endif
+  if (buf) {
+    bc_cache_depend(file_name);
+  }
   return buf;
 }
 
@@ -4438,6 +4578,9 @@ char *comp_preproc_options(char *p) {
     } else if (strncmp(LCN_AUTOLOCAL, p, LEN_AUTOLOCAL) == 0) {
       p += LEN_AUTOLOCAL;
       opt_autolocal = 1;
+    } else if (strncmp(LCN_OPTIMIZE, p, LEN_OPTIMIZE) == 0) {
+      p += LEN_OPTIMIZE;
+      comp_optimize = 1;
     } else if (strncmp(LCN_COMMAND, p, LEN_COMMAND) == 0) {
       p += LEN_COMMAND;
       SKIP_SPACES(p);
@@ -4585,6 +4728,7 @@ void comp_preproc_pass1(char *p) {
   while (*p) {
     if (strncmp(LCN_OPTION, p, LEN_OPTION) == 0) {
       // options
+      bc_cache_option(BC_CACHE_OPTION, p + LEN_OPTION);
       p = comp_preproc_options(p + LEN_OPTION);
     } else if (strncmp(LCN_IMPORT_WRS, p, LEN_IMPORT) == 0) {
       // import
@@ -4600,6 +4744,7 @@ void comp_preproc_pass1(char *p) {
       comp_preproc_remove_line(p, 1);
     } else if (strncmp(LCN_SBASICPATH, p, LEN_SBASICPATH) == 0) {
       // sbasicpath
+      bc_cache_option(BC_CACHE_SBASICPATH, p + LEN_SBASICPATH);
       comp_preproc_sbasicpath(p + LEN_SBASICPATH);
       comp_preproc_remove_line(p, 0);
     } else if (strncmp(LCN_INC, p, LEN_INC) == 0) {
@@ -4617,6 +4762,7 @@ void comp_preproc_pass1(char *p) {
       // end sub/func
       comp_preproc_func_end(p);
     } else if (strncasecmp(LCN_SHOWPAGE, p, LEN_SHOWPAGE) == 0) {
+      bc_cache_option(BC_CACHE_SHOWPAGE, p + LEN_SHOWPAGE);
       opt_show_page = 1;
     }
 
@@ -4734,7 +4880,7 @@ int comp_pass1(const char *section, const char *text) {
  * setup export table
  */
 int comp_pass2_exports() {
-  int i, j;
+  int i;
 
   for (i = 0; i < comp_expcount; i++) {
     bid_t pid;
@@ -4751,18 +4897,12 @@ int comp_pass2_exports() {
       sym->vid = comp_udptable[pid].vid;
     } else {
       // look on variables
-      pid = -1;
-      for (j = 0; j < comp_varcount; j++) {
-        if (strcmp(comp_vartable[j].name, sym->symbol) == 0) {
-          pid = j;
-          break;
-        }
-      }
+      pid = comp_index_find(&comp_varindex, sym->symbol, comp_var_name, 0);
 
       if (pid != -1) {
         sym->type = stt_variable;
         sym->address = 0;
-        sym->vid = j;
+        sym->vid = pid;
       } else {
         sc_raise(MSG_EXP_SYM_NOT_FOUND, sym->symbol);
         return 0;
@@ -5000,6 +5140,12 @@ int comp_compile(const char *sb_file_name) {
       bc = comp_create_bin();
       success = comp_save_bin(bc);
     }
+    if (success && opt_profile[0]) {
+      // the bytecode holds no names
+      for (int i = 0; i < comp_udpcount; i++) {
+        profile_name(sb_file_name, comp_udptable[i].ip + ADDRSZ + 3, comp_udptable[i].name);
+      }
+    }
   }
 
   int is_unit = comp_unit_flag;
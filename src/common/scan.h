@@ -182,6 +182,23 @@ typedef struct {
   comp_pass_node_t **elem;
 } comp_pass_node_table_t;
 
+/**
+ * @ingroup scan
+ * @typedef comp_index_t
+ *
+ * hashed index of the names held in one of the compiler's tables
+ */
+typedef struct {
+  uint32_t hash; /**< hash of the case-folded name */
+  int idx; /**< table position, -1 when the slot is empty */
+} comp_index_slot_t;
+
+typedef struct {
+  comp_index_slot_t *slots;
+  uint32_t size;
+  uint32_t count;
+} comp_index_t;
+
 #if !defined(SCAN_MODULE)       // actually static data
 extern struct keyword_s keyword_table[]; /**< basic keywords             @ingroup scan */
 extern struct opr_keyword_s opr_table[]; /**< operators table            @ingroup scan */
@@ -370,6 +387,25 @@ int comp_pass2(void);
  */
 void comp_preproc_grmode(const char *source);
 
+/**
+ * @ingroup scan
+ *
+ * handle OPTION PREDEF parameters
+ *
+ * @param p the text following OPTION
+ * @return the position following the parsed text
+ */
+char *comp_preproc_options(char *p);
+
+/**
+ * @ingroup scan
+ *
+ * setup the SBASICPATH environment variable
+ *
+ * @param p the text following SBASICPATH
+ */
+void comp_preproc_sbasicpath(char *p);
+
 #if defined(__cplusplus)
 }
 #endif
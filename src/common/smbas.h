@@ -101,34 +101,41 @@ typedef struct {
 
 EXTERN byte opt_graphics; /**< command-line option: start in graphics mode   */
 EXTERN byte opt_quiet; /**< command-line option: quiet                       */
-EXTERN char opt_command[OPT_CMD_SZ]; /**< command-line parameters (COMMAND$) */
-EXTERN int opt_base; /**< OPTION BASE x                                      */
+EXTERN SB_THREAD_LOCAL char opt_command[OPT_CMD_SZ]; /**< command-line parameters (COMMAND$) */
+EXTERN SB_THREAD_LOCAL int opt_base; /**< OPTION BASE x                                      */
 EXTERN byte opt_loadmod; /**< load all modules                               */
 EXTERN char opt_modpath[OPT_MOD_SZ]; /**< Modules path                       */
 EXTERN int opt_verbose; /**< print some additional infos                     */
 EXTERN int opt_ide; /**< 0=no IDE, 1=IDE is linked, 2=IDE is external exe)   */
 EXTERN byte os_charset; /**< use charset encoding                            */
-EXTERN int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
-EXTERN int opt_pref_height; /**< prefered graphics mode height               */
+EXTERN SB_THREAD_LOCAL int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
+EXTERN SB_THREAD_LOCAL int opt_pref_height; /**< prefered graphics mode height               */
 EXTERN byte opt_nosave; /**< do not create .sbx files                        */
-EXTERN byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
+EXTERN SB_THREAD_LOCAL byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
 EXTERN byte opt_file_permitted; /**< file system permission                  */
-EXTERN byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
+EXTERN SB_THREAD_LOCAL byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
 EXTERN byte opt_mute_audio; /**< whether to mute sounds                      */
 EXTERN byte opt_antialias; /**< OPTION ANTIALIAS OFF                         */
-EXTERN byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
+EXTERN SB_THREAD_LOCAL byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
+EXTERN byte opt_optimize; /**< command-line option: fold constant expressions  */
 EXTERN byte opt_trace_on; /**< initial value for the TRON command            */
+EXTERN int opt_event_budget; /**< max commands per clock read (0=default)    */
+EXTERN SB_THREAD_LOCAL int opt_bc_cache; /**< compiled programs and CHAIN sources kept in memory (0=disabled) */
+EXTERN char opt_cache_dir[OS_PATHNAME_SIZE]; /**< compiled program cache directory (empty=disabled) */
+EXTERN char opt_profile[OS_PATHNAME_SIZE]; /**< profile output file (empty=disabled)           */
 
 #define IDE_NONE        0
 #define IDE_INTERNAL    1
 #define IDE_EXTERNAL    2
 
 // globals
-EXTERN int gsb_last_line; /**< source code line of the last error            */
-EXTERN int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
-EXTERN char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
-EXTERN char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
-EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
+EXTERN SB_THREAD_LOCAL int gsb_last_line; /**< source code line of the last error            */
+EXTERN SB_THREAD_LOCAL int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
+EXTERN SB_THREAD_LOCAL char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
+EXTERN SB_THREAD_LOCAL char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
+EXTERN SB_THREAD_LOCAL char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
+EXTERN SB_THREAD_LOCAL uint32_t gsb_bc_cache_hits; /**< programs loaded from the memory cache   */
+EXTERN SB_THREAD_LOCAL uint32_t gsb_bc_cache_misses; /**< programs compiled with the memory cache  */
 
 #include "common/units.h"
 #include "common/tasks.h"
@@ -171,6 +178,7 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_vartable       ctask->sbe.comp.vartable
 #define comp_varcount       ctask->sbe.comp.varcount
 #define comp_varsize        ctask->sbe.comp.varsize
+#define comp_varindex       ctask->sbe.comp.varindex
 #define comp_imptable       ctask->sbe.comp.imptable
 #define comp_impcount       ctask->sbe.comp.imptable.count
 #define comp_exptable       ctask->sbe.comp.exptable
@@ -179,6 +187,7 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_libcount       ctask->sbe.comp.libtable.count
 #define comp_labtable       ctask->sbe.comp.labtable
 #define comp_labcount       ctask->sbe.comp.labtable.count
+#define comp_labindex       ctask->sbe.comp.labindex
 #define comp_bc_sec         ctask->sbe.comp.bc_sec
 #define comp_block_level    ctask->sbe.comp.block_level
 #define comp_block_id       ctask->sbe.comp.block_id
@@ -193,7 +202,9 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_udptable       ctask->sbe.comp.udptable
 #define comp_udpcount       ctask->sbe.comp.udpcount
 #define comp_udpsize        ctask->sbe.comp.udpsize
+#define comp_udpindex       ctask->sbe.comp.udpindex
 #define comp_use_global_vartable    ctask->sbe.comp.use_global_vartable
+#define comp_optimize       ctask->sbe.comp.optimize
 #define comp_stack          ctask->sbe.comp.stack
 #define comp_sp             ctask->sbe.comp.stack.count
 #define comp_do_close_cmd   ctask->sbe.comp.do_close_cmd
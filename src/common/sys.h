@@ -40,6 +40,11 @@ extern "C" {
 #define DBL_EPSILON 0.00000000000001
 #endif
 #define EPSILON DBL_EPSILON
+
+// the interpreter state, one per thread with --enable-reentrant
+#if !defined(SB_THREAD_LOCAL)
+#define SB_THREAD_LOCAL
+#endif
 #define OS_PREC64
 
 #define VAR_MAX_INT     LONG_MAX
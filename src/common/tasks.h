@@ -95,6 +95,8 @@ typedef struct {
   int proc_level;
   // flag - uses global variable-table for the next commands
   byte use_global_vartable;
+  // flag - fold constant expressions (OPTION PREDEF OPTIMIZE)
+  byte optimize;
 
   bc_t bc_prog;
   bc_t bc_data;
@@ -105,14 +107,17 @@ typedef struct {
   comp_var_t *vartable;
   bid_t varcount;
   bid_t varsize;
+  comp_index_t varindex;
 
   // label table
   comp_label_table_t labtable;
+  comp_index_t labindex;
 
   // user defined proc/func table
   comp_udp_t *udptable;
   bid_t udpcount;
   bid_t udpsize;
+  comp_index_t udpindex;
 
   // pass2 stack
   comp_pass_node_table_t stack;
@@ -145,7 +150,7 @@ typedef struct {
   } sbe;
 } task_t;
 
-EXTERN task_t *ctask; /**< current task pointer  */
+EXTERN SB_THREAD_LOCAL task_t *ctask; /**< current task pointer  */
 
 /**
  *   @ingroup sys
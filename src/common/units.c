@@ -14,10 +14,11 @@
 #include "common/pproc.h"
 #include "common/scan.h"
 #include "common/units.h"
+#include "common/bc_cache.h"
 
 // units table
-static unit_t *units;
-static int unit_count = 0;
+static SB_THREAD_LOCAL unit_t *units;
+static SB_THREAD_LOCAL int unit_count = 0;
 
 /**
  *   initialization
@@ -141,6 +142,11 @@ int open_unit(const char *file) {
     }
   }
 
+  if (sys_filetime(bas_file)) {
+    // a program using the unit is compiled again when the source changes
+    bc_cache_depend(bas_file);
+  }
+
   // compilation required
   if (comp_rq && !comp_compile(bas_file)) {
     return -1;
@@ -151,6 +157,7 @@ int open_unit(const char *file) {
   if (h == -1) {
     return -1;
   }
+  bc_cache_depend(unitname);
 
   // read file header
   int nread = read(h, &u.hdr, sizeof(unit_file_t));
@@ -12,33 +12,106 @@
 
 #define INT_STR_LEN 64
 #define VAR_POOL_SIZE 8192
+#define VAR_SLAB_SIZE 8192
 
-var_t var_pool[VAR_POOL_SIZE];
-var_t *var_pool_head;
+/**
+ * Additional pool memory, allocated once the static pool is exhausted
+ */
+typedef struct var_slab_t {
+  struct var_slab_t *next;
+  var_t vars[VAR_SLAB_SIZE];
+} var_slab_t;
+
+SB_THREAD_LOCAL var_t var_pool[VAR_POOL_SIZE];
+SB_THREAD_LOCAL var_t *var_pool_head;
+SB_THREAD_LOCAL var_slab_t *var_slabs;
+SB_THREAD_LOCAL var_pool_stats_t var_pool_stats;
+SB_THREAD_LOCAL int v_readonly;
+SB_THREAD_LOCAL int v_pinning;
+
+/**
+ * The array elements are preceded by a reference count, arrays are
+ * shared between variables until one of them is written. a pinned
+ * array has an element referenced elsewhere and is no longer shared
+ */
+typedef union array_head_t {
+  struct {
+    uint32_t refs;
+    uint32_t pinned;
+  } h;
+  var_num_t align;
+} array_head_t;
+
+#define v_array_head(var) (((array_head_t *)v_data(var)) - 1)
+
+/**
+ * links the vars into the free list
+ */
+static void v_pool_link(var_t *vars, uint32_t size) {
+  for (uint32_t i = 0; i < size; i++) {
+    v_init(&vars[i]);
+    vars[i].pooled = 1;
+    vars[i].v.pool_next = &vars[i + 1];
+  }
+  vars[size - 1].v.pool_next = var_pool_head;
+  var_pool_head = &vars[0];
+}
 
-void v_init_pool() {
-  for (uint32_t i = 0; i < VAR_POOL_SIZE; i++) {
-    v_init(&var_pool[i]);
-    var_pool[i].pooled = 1;
-    if (i + 1 < VAR_POOL_SIZE) {
-      var_pool[i].v.pool_next = &var_pool[i + 1];
-    } else {
-      var_pool[i].v.pool_next = NULL;
+/**
+ * refills the empty free list, first from the static pool then from
+ * additional slabs
+ */
+static void v_pool_grow() {
+  if (var_pool_stats.capacity == 0) {
+    v_pool_link(var_pool, VAR_POOL_SIZE);
+    var_pool_stats.capacity = VAR_POOL_SIZE;
+  } else {
+    var_slab_t *slab = (var_slab_t *)malloc(sizeof(var_slab_t));
+    if (slab != NULL) {
+      slab->next = var_slabs;
+      var_slabs = slab;
+      var_pool_stats.slabs++;
+      var_pool_stats.capacity += VAR_SLAB_SIZE;
+      v_pool_link(slab->vars, VAR_SLAB_SIZE);
+    }
+  }
+}
+
+void v_pool_release() {
+  if (var_pool_stats.in_use == 0) {
+    // no variables remain, the slabs are released in one go
+    while (var_slabs != NULL) {
+      var_slab_t *next = var_slabs->next;
+      free(var_slabs);
+      var_slabs = next;
     }
+    var_pool_head = NULL;
+    memset(&var_pool_stats, 0, sizeof(var_pool_stats));
   }
-  var_pool_head = &var_pool[0];
+}
+
+void v_init_pool() {
+  // variables created outside of the executor may still be live
+  v_pool_release();
 }
 
 /*
  * creates and returns a new variable
  */
 var_t *v_new() {
+  if (var_pool_head == NULL) {
+    v_pool_grow();
+  }
   var_t *result = var_pool_head;
   if (result != NULL) {
     // remove an item from the free-list
     var_pool_head = result->v.pool_next;
+    if (++var_pool_stats.in_use > var_pool_stats.peak) {
+      var_pool_stats.peak = var_pool_stats.in_use;
+    }
+    var_pool_stats.allocs++;
   } else {
-    // pool exhausted
+    // out of memory for another slab
     result = (var_t *)malloc(sizeof(var_t));
     result->pooled = 0;
   }
@@ -50,6 +123,11 @@ void v_pool_free(var_t *var) {
   // insert back into the free list
   var->v.pool_next = var_pool_head;
   var_pool_head = var;
+  var_pool_stats.in_use--;
+}
+
+void v_pool_get_stats(var_pool_stats_t *stats) {
+  *stats = var_pool_stats;
 }
 
 uint32_t v_get_capacity(uint32_t size) {
@@ -61,10 +139,15 @@ void v_alloc_capacity(var_t *var, uint32_t size) {
   uint32_t capacity = v_get_capacity(size);
   v_capacity(var) = capacity;
   v_asize(var) = size;
-  v_data(var) = (var_t *)malloc(sizeof(var_t) * capacity);
-  if (!v_data(var)) {
+  uint32_t bytes = sizeof(array_head_t) + sizeof(var_t) * capacity;
+  array_head_t *head = (array_head_t *)malloc(bytes);
+  if (!head) {
+    v_data(var) = NULL;
     err_memory();
   } else {
+    head->h.refs = 1;
+    head->h.pinned = 0;
+    v_data(var) = (var_t *)(head + 1);
     for (uint32_t i = 0; i < capacity; i++) {
       var_t *e = v_elem(var, i);
       e->pooled = 0;
@@ -118,10 +201,57 @@ void v_copy_array(var_t *dest, const var_t *src) {
 void v_array_free(var_t *var) {
   uint32_t v_size = v_capacity(var);
   if (v_size && v_data(var)) {
-    for (uint32_t i = 0; i < v_size; i++) {
-      v_free(v_elem(var, i));
+    array_head_t *head = v_array_head(var);
+    if (--head->h.refs == 0) {
+      for (uint32_t i = 0; i < v_size; i++) {
+        v_free(v_elem(var, i));
+      }
+      free(head);
+    }
+  }
+}
+
+void v_unshare(var_t *var) {
+  switch (var->type) {
+  case V_ARRAY:
+    if (v_data(var) && v_array_head(var)->h.refs > 1) {
+      // take a private copy, the elements remain shared
+      var_t src = *var;
+      v_array_head(var)->h.refs--;
+      v_copy_array(var, &src);
+    }
+    break;
+  case V_MAP:
+    map_unshare(var);
+    break;
+  }
+}
+
+void v_pin(var_t *var) {
+  switch (var->type) {
+  case V_ARRAY:
+    v_unshare(var);
+    if (v_data(var)) {
+      v_array_head(var)->h.pinned = 1;
+    }
+    break;
+  case V_MAP:
+    map_pin(var);
+    break;
+  }
+}
+
+void v_unshare_all(var_t *var) {
+  switch (var->type) {
+  case V_ARRAY:
+    v_unshare(var);
+    for (uint32_t i = 0; i < v_asize(var); i++) {
+      v_unshare_all(v_elem(var, i));
     }
-    free(var->v.a.data);
+    break;
+  case V_MAP:
+    map_unshare_all(var);
+    break;
   }
 }
 
@@ -220,39 +350,45 @@ void v_resize_array(var_t *v, uint32_t size) {
     v_free(v);
     v_init_array(v);
     v->type = V_ARRAY;
-  } else if (size < v_asize(v)) {
-    // resize down. free discarded elements
-    uint32_t v_size = v_asize(v);
-    for (uint32_t i = size; i < v_size; i++) {
-      v_free(v_elem(v, i));
-    }
-    v_set_array1_size(v, size);
-  } else if (size <= v_capacity(v)) {
-    // use existing capacity
-    v_set_array1_size(v, size);
   } else {
-    // insufficient capacity
-    uint32_t prev_size = v_asize(v);
-    if (prev_size == 0) {
-      v_alloc_capacity(v, size);
-    } else if (prev_size < size) {
-      // resize & copy
-      uint32_t capacity = v_get_capacity(size);
-      v_capacity(v) = capacity;
-      v_data(v) = (var_t *)realloc(v_data(v), sizeof(var_t) * capacity);
-      for (uint32_t i = prev_size; i < capacity; i++) {
-        var_t *e = v_elem(v, i);
-        e->pooled = 0;
-        v_init(e);
+    // detach from any other variables before the elements change
+    v_unshare(v);
+    if (size < v_asize(v)) {
+      // resize down. free discarded elements
+      uint32_t v_size = v_asize(v);
+      for (uint32_t i = size; i < v_size; i++) {
+        v_free(v_elem(v, i));
+      }
+      v_set_array1_size(v, size);
+    } else if (size <= v_capacity(v)) {
+      // use existing capacity
+      v_set_array1_size(v, size);
+    } else {
+      // insufficient capacity
+      uint32_t prev_size = v_asize(v);
+      if (prev_size == 0) {
+        v_alloc_capacity(v, size);
+      } else if (prev_size < size) {
+        // resize & copy
+        uint32_t capacity = v_get_capacity(size);
+        uint32_t bytes = sizeof(array_head_t) + sizeof(var_t) * capacity;
+        array_head_t *head = (array_head_t *)realloc(v_array_head(v), bytes);
+        v_capacity(v) = capacity;
+        v_data(v) = (var_t *)(head + 1);
+        for (uint32_t i = prev_size; i < capacity; i++) {
+          var_t *e = v_elem(v, i);
+          e->pooled = 0;
+          v_init(e);
+        }
       }
-    }
 
-    // init vars
-    for (uint32_t i = prev_size; i < size; i++) {
-      v_init(v_elem(v, i));
-    }
+      // init vars
+      for (uint32_t i = prev_size; i < size; i++) {
+        v_init(v_elem(v, i));
+      }
 
-    v_set_array1_size(v, size);
+      v_set_array1_size(v, size);
+    }
   }
 }
 
@@ -409,10 +545,12 @@ void v_add(var_t *result, var_t *a, var_t *b) {
   char tmpsb[INT_STR_LEN];
 
   if (a->type == V_STR && b->type == V_STR) {
-    int length = strlen(a->v.p.ptr) + strlen(b->v.p.ptr);
-    v_init_str(result, length);
-    strcpy(result->v.p.ptr, a->v.p.ptr);
-    strcat(result->v.p.ptr, b->v.p.ptr);
+    int len_a = v_strlen(a);
+    int len_b = v_strlen(b);
+    v_init_str(result, len_a + len_b);
+    memcpy(result->v.p.ptr, a->v.p.ptr, len_a);
+    memcpy(result->v.p.ptr + len_a, b->v.p.ptr, len_b);
+    result->v.p.ptr[len_a + len_b] = '\0';
     return;
   } else if (a->type == V_INT && b->type == V_INT) {
     result->type = V_INT;
@@ -439,15 +577,16 @@ void v_add(var_t *result, var_t *a, var_t *b) {
         result->v.n = b->v.n + v_getval(a);
       }
     } else {
-      v_init_str(result, strlen(a->v.p.ptr) + INT_STR_LEN);
-      strcpy(result->v.p.ptr, a->v.p.ptr);
       if (b->type == V_INT) {
         ltostr(b->v.i, tmpsb);
       } else {
         ftostr(b->v.n, tmpsb);
       }
-      strcat(result->v.p.ptr, tmpsb);
-      result->v.p.length = strlen(result->v.p.ptr) + 1;
+      int len_a = v_strlen(a);
+      int len_b = strlen(tmpsb);
+      v_init_str(result, len_a + len_b);
+      memcpy(result->v.p.ptr, a->v.p.ptr, len_a);
+      memcpy(result->v.p.ptr + len_a, tmpsb, len_b + 1);
     }
   } else if ((a->type == V_INT || a->type == V_NUM) && b->type == V_STR) {
     if (is_number(b->v.p.ptr)) {
@@ -458,15 +597,17 @@ void v_add(var_t *result, var_t *a, var_t *b) {
         result->v.n = a->v.n + v_getval(b);
       }
     } else {
-      v_init_str(result, strlen(b->v.p.ptr) + INT_STR_LEN);
       if (a->type == V_INT) {
         ltostr(a->v.i, tmpsb);
       } else {
         ftostr(a->v.n, tmpsb);
       }
-      strcpy(result->v.p.ptr, tmpsb);
-      strcat(result->v.p.ptr, b->v.p.ptr);
-      result->v.p.length = strlen(result->v.p.ptr) + 1;
+      int len_a = strlen(tmpsb);
+      int len_b = v_strlen(b);
+      v_init_str(result, len_a + len_b);
+      memcpy(result->v.p.ptr, tmpsb, len_a);
+      memcpy(result->v.p.ptr + len_a, b->v.p.ptr, len_b);
+      result->v.p.ptr[len_a + len_b] = '\0';
     }
   } else if (b->type == V_MAP) {
     char *map = map_to_str(b);
@@ -480,6 +621,29 @@ void v_add(var_t *result, var_t *a, var_t *b) {
  * assign (dest = src)
  */
 void v_set(var_t *dest, const var_t *src) {
+  if (src->type == V_ARRAY || src->type == V_MAP) {
+    // share the payload, taking the reference before releasing dest since
+    // src may be one of its elements. a pinned payload is copied instead
+    var_t shared = *src;
+    if (shared.type == V_MAP) {
+      if (map_is_pinned(&shared)) {
+        shared.type = 0;
+        map_set(&shared, (const var_p_t)src);
+      } else {
+        map_share(&shared);
+      }
+    } else if (v_data(&shared) && v_array_head(&shared)->h.pinned) {
+      v_copy_array(&shared, src);
+    } else if (v_data(&shared)) {
+      v_array_head(&shared)->h.refs++;
+    }
+    v_free(dest);
+    dest->const_flag = 0;
+    dest->type = shared.type;
+    dest->v = shared.v;
+    return;
+  }
+
   v_free(dest);
   dest->const_flag = 0;
   dest->type = src->type;
@@ -492,33 +656,23 @@ void v_set(var_t *dest, const var_t *src) {
     dest->v.n = src->v.n;
     break;
   case V_STR:
+    // strings are not shared, many routines write into v.p.ptr in place
     if (src->v.p.owner) {
       dest->v.p.length = v_strlen(src) + 1;
       dest->v.p.ptr = (char *)malloc(dest->v.p.length);
       dest->v.p.owner = 1;
-      strcpy(dest->v.p.ptr, src->v.p.ptr);
+      memcpy(dest->v.p.ptr, src->v.p.ptr, dest->v.p.length - 1);
+      dest->v.p.ptr[dest->v.p.length - 1] = '\0';
     } else {
       dest->v.p.length = src->v.p.length;
       dest->v.p.ptr = src->v.p.ptr;
       dest->v.p.owner = 0;
     }
     break;
-  case V_ARRAY:
-    if (v_asize(src)) {
-      v_copy_array(dest, src);
-    } else {
-      v_init_array(dest);
-    }
-    break;
   case V_PTR:
     dest->v.ap.p = src->v.ap.p;
     dest->v.ap.v = src->v.ap.v;
     break;
-  case V_MAP:
-    // reset type since not yet a map
-    dest->type = 0;
-    map_set(dest, (const var_p_t)src);
-    break;
   case V_REF:
     dest->v.ref = src->v.ref;
     break;
@@ -688,10 +842,11 @@ void v_setstr(var_t *var, const char *str) {
 }
 
 void v_setstrn(var_t *var, const char *str, int len) {
-  if (var->type != V_STR || strncmp(str, var->v.p.ptr, len) != 0) {
+  if (var->type != V_STR || v_strlen(var) != len || memcmp(str, var->v.p.ptr, len) != 0) {
     v_free(var);
     v_init_str(var, len);
-    strlcpy(var->v.p.ptr, str, len + 1);
+    memcpy(var->v.p.ptr, str, len);
+    var->v.p.ptr[len] = '\0';
   }
 }
 
@@ -703,22 +858,63 @@ void v_strcat(var_t *var, const char *str) {
     v_tostr(var);
   }
   if (var->type == V_STR) {
-    if (var->v.p.owner) {
-      var->v.p.length = strlen(var->v.p.ptr) + strlen(str) + 1;
-      var->v.p.ptr = realloc(var->v.p.ptr, var->v.p.length);
-      strcat(var->v.p.ptr, str);
-    } else {
-      // mutate into owner string
-      char *p = var->v.p.ptr;
-      int len = var->v.p.length + strlen(str);
-      v_init_str(var, len);
-      strcpy(var->v.p.ptr, p);
-      strcat(var->v.p.ptr, str);
+    v_strappend(var, str, strlen(str));
+  } else {
+    err_typemismatch();
+  }
+}
+
+/*
+ * returns the buffer size for a string grown to the given size
+ */
+static inline uint32_t v_str_capacity(uint32_t size) {
+  uint32_t result = 16;
+  while (result < size) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void v_strappend(var_t *var, const char *str, int len) {
+  int size = v_strlen(var);
+  uint32_t capacity = v_str_capacity(size + len + 1);
+  char *ptr = var->v.p.ptr;
+  if (var->v.p.owner == STR_GROWABLE && v_str_capacity(var->v.p.length) >= capacity) {
+    // room remains in the buffer
+  } else if (var->v.p.owner) {
+    uintptr_t offs = (uintptr_t)str - (uintptr_t)ptr;
+    var->v.p.ptr = realloc(ptr, capacity);
+    if (offs < var->v.p.length) {
+      // appending part of itself
+      str = var->v.p.ptr + offs;
     }
+  } else {
+    // mutate into owner string
+    var->v.p.ptr = malloc(capacity);
+    memcpy(var->v.p.ptr, ptr, size);
+  }
+  memmove(var->v.p.ptr + size, str, len);
+  var->v.p.ptr[size + len] = '\0';
+  var->v.p.length = size + len + 1;
+  var->v.p.owner = STR_GROWABLE;
+}
 
+int v_add_inplace(var_t *a, const var_t *b) {
+  char tmpsb[INT_STR_LEN];
+  int result = 1;
+  if (b->type == V_STR) {
+    v_strappend(a, b->v.p.ptr, v_strlen(b));
+  } else if ((b->type == V_INT || b->type == V_NUM) && !is_number(a->v.p.ptr)) {
+    if (b->type == V_INT) {
+      ltostr(b->v.i, tmpsb);
+    } else {
+      ftostr(b->v.n, tmpsb);
+    }
+    v_strappend(a, tmpsb, strlen(tmpsb));
   } else {
-    err_typemismatch();
+    result = 0;
   }
+  return result;
 }
 
 /*
@@ -112,6 +112,9 @@ typedef struct stknode_s {
       bcip_t step_expr_ip; /**< IP of 'STEP' expression (FOR-IN = current element) */
       bcip_t jump_ip; /**< code block IP */
       bcip_t exit_ip; /**< EXIT command IP to go */
+      var_int_t to_value; /**< integer FOR-TO: constant TO value */
+      var_int_t step_value; /**< integer FOR-TO: constant STEP value */
+      bid_t to_vid; /**< integer FOR-TO: TO variable index */
       code_t subtype; /**< kwTO | kwIN */
       byte flags; /**< ... */
     } vfor;
@@ -188,6 +191,19 @@ typedef struct stknode_s {
   code_t type; /**< type of node (keyword id, i.e. kwGOSUB, kwFOR, etc) */
 } stknode_t;
 
+/**
+ * @ingroup var
+ *
+ * variable allocator statistics
+ */
+typedef struct var_pool_stats_t {
+  uint32_t in_use;   /**< variables currently allocated */
+  uint32_t peak;     /**< highest number of variables allocated */
+  uint32_t capacity; /**< variables held by the pool */
+  uint32_t slabs;    /**< slabs added to the static pool */
+  uint64_t allocs;   /**< total number of allocations */
+} var_pool_stats_t;
+
 /**
  * @ingroup var
  *
@@ -195,6 +211,13 @@ typedef struct stknode_s {
  */
 void v_init_pool(void);
 
+/**
+ * @ingroup var
+ *
+ * frees the pool slabs in one go once no variables remain allocated
+ */
+void v_pool_release(void);
+
 /**
  * @ingroup var
  *
@@ -202,6 +225,15 @@ void v_init_pool(void);
  */
 void v_pool_free(var_t *var);
 
+/**
+ * @ingroup var
+ *
+ * returns the allocator statistics
+ *
+ * @param stats receives the statistics
+ */
+void v_pool_get_stats(var_pool_stats_t *stats);
+
 /**
  * @ingroup var
  *
@@ -310,6 +342,30 @@ stknode_t *code_stackpeek();
  */
 #define code_getvarptr() code_getvarptr_parens(0)
 
+/**
+ * @ingroup var
+ *
+ * set while resolving a variable for reading, the shared arrays and maps
+ * holding the element are then not copied
+ */
+extern SB_THREAD_LOCAL int v_readonly;
+
+/**
+ * @ingroup var
+ *
+ * set while resolving a BYREF argument or a FOR variable, the arrays and
+ * maps holding the element are then pinned
+ */
+extern SB_THREAD_LOCAL int v_pinning;
+
+/**
+ * @ingroup var
+ *
+ * Returns the varptr of the next variable, pinning the arrays and maps
+ * which hold the element
+ */
+var_t *code_getvarptr_pinned();
+
 #define code_peek()         prog_source[prog_ip]    /**< R(byte) <- Code[IP]          @ingroup exec */
 #define code_getnext()      prog_source[prog_ip++]  /**< R(byte) <- Code[IP]; IP ++;  @ingroup exec */
 
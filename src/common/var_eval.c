@@ -21,11 +21,17 @@
 bcip_t get_array_idx(var_t *array) {
   bcip_t idx = 0;
   bcip_t lev = 0;
+  int readonly = v_readonly;
+  int pinning = v_pinning;
 
   do {
     var_t var;
     v_init(&var);
+    v_readonly = 0;
+    v_pinning = 0;
     eval(&var);
+    v_readonly = readonly;
+    v_pinning = pinning;
 
     if (prog_error) {
       break;
@@ -108,6 +114,11 @@ var_t *code_getvarptr_arridx(var_t *basevar_p) {
     bcip_t array_index = get_array_idx(basevar_p);
     if (!prog_error) {
       if ((int) array_index < v_asize(basevar_p) && (int) array_index >= 0) {
+        if (v_pinning) {
+          v_pin(basevar_p);
+        } else if (!v_readonly) {
+          v_unshare(basevar_p);
+        }
         var_p = v_elem(basevar_p, array_index);
         if (code_peek() == kwTYPE_LEVEL_END) {
           code_skipnext();
@@ -136,10 +147,17 @@ var_t *code_get_map_element(var_t *map, var_t *field) {
   if (code_peek() != kwTYPE_LEVEL_BEGIN) {
     err_arrmis_lp();
   } else if (field->type == V_PTR) {
+    int readonly = v_readonly;
+    int pinning = v_pinning;
+    v_readonly = 0;
+    v_pinning = 0;
+    v_unshare(map);
     prog_ip = cmd_push_args(kwFUNC, field->v.ap.p, field->v.ap.v);
     var_t *self = v_set_self(map);
     bc_loop(2);
     v_set_self(self);
+    v_readonly = readonly;
+    v_pinning = pinning;
 
     if (!prog_error) {
       stknode_t udf_rv;
@@ -163,9 +181,22 @@ var_t *code_get_map_element(var_t *map, var_t *field) {
     code_skipnext();
     var_t var;
     v_init(&var);
+    int readonly = v_readonly;
+    int pinning = v_pinning;
+    v_readonly = 0;
+    v_pinning = 0;
     eval(&var);
+    v_readonly = readonly;
+    v_pinning = pinning;
     if (!prog_error) {
+      if (v_pinning) {
+        v_pin(field);
+      }
       map_get_value(field, &var, &result);
+      if (v_pinning) {
+        // an array may have been converted to a new map
+        v_pin(field);
+      }
       if (code_peek() == kwTYPE_LEVEL_END) {
         code_skipnext();
       } else {
@@ -270,11 +301,7 @@ var_t *code_isvar_resolve_map(var_t *var_p, int *is_ptr) {
   return var_p;
 }
 
-/**
- * returns true if the next code is a variable. if the following code is an
- * expression (no matter if the first item is a variable), returns false
- */
-int code_isvar() {
+static int code_isvar_resolve() {
   if (code_peek() == kwTYPE_VAR) {
     int is_ptr;
     var_t *basevar_p;
@@ -326,6 +353,26 @@ int code_isvar() {
   return 0;
 }
 
+var_t *code_getvarptr_pinned() {
+  int pinning = v_pinning;
+  v_pinning = 1;
+  var_t *result = code_getvarptr();
+  v_pinning = pinning;
+  return result;
+}
+
+/**
+ * returns true if the next code is a variable. if the following code is an
+ * expression (no matter if the first item is a variable), returns false
+ */
+int code_isvar() {
+  int readonly = v_readonly;
+  v_readonly = 1;
+  int result = code_isvar_resolve();
+  v_readonly = readonly;
+  return result;
+}
+
 var_t *eval_ref_var(var_t *var_p) {
   var_t *result = var_p;
   while (result != NULL && result->type == V_REF) {
@@ -133,36 +133,11 @@ const char *map_get_str(var_p_t base, const char *name) {
   return result;
 }
 
-/**
- * return the element at the nth position
- */
-int map_elem_cb(hashmap_cb *cb, var_p_t key, var_p_t value) {
-  int result;
-  if (cb->count++ == cb->index) {
-    cb->var = key;
-    result = 1;
-  } else {
-    result = 0;
-  }
-  return result;
-}
-
 /**
  * return the element key at the nth position
  */
 var_p_t map_elem_key(const var_p_t var_p, int index) {
-  var_p_t result;
-  if (var_p->type == V_MAP) {
-    hashmap_cb cb;
-    cb.count = 0;
-    cb.index = index;
-    cb.var = NULL;
-    hashmap_foreach(var_p, map_elem_cb, &cb);
-    result = cb.var;
-  } else {
-    result = NULL;
-  }
-  return result;
+  return hashmap_key_at(var_p, index);
 }
 
 /**
@@ -204,6 +179,10 @@ var_p_t map_resolve_fields(var_p_t base, var_p_t *parent) {
       }
     }
 
+    if (v_pinning) {
+      map_pin(base);
+    }
+
     // evaluate the variable 'key' name
     int len = code_getstrlen();
     const char *key = (const char *)&prog_source[prog_ip];
@@ -289,11 +268,40 @@ void map_set(var_p_t dest, const var_p_t src) {
     cb.var = dest;
     hashmap_create(dest, src->v.m.count);
     hashmap_foreach(src, map_set_cb, &cb);
-    dest->v.m.count = src->v.m.count;
   }
 }
 
+void map_share(var_p_t var_p) {
+  hashmap_share(var_p);
+}
+
+void map_unshare(var_p_t var_p) {
+  hashmap_unshare(var_p);
+}
+
+void map_pin(var_p_t var_p) {
+  hashmap_pin(var_p);
+}
+
+int map_is_pinned(const var_p_t var_p) {
+  return hashmap_is_pinned(var_p);
+}
+
+/**
+ * Helper for map_unshare_all
+ */
+int map_unshare_cb(hashmap_cb *cb, var_p_t v_key, var_p_t v_var) {
+  v_unshare_all(v_var);
+  return 0;
+}
+
+void map_unshare_all(var_p_t var_p) {
+  hashmap_unshare(var_p);
+  hashmap_foreach(var_p, map_unshare_cb, NULL);
+}
+
 void map_set_int(var_p_t base, const char *name, var_int_t n) {
+  map_unshare(base);
   var_p_t var = map_get(base, name);
   if (var != NULL) {
     v_setint(var, n);
@@ -24,6 +24,47 @@ typedef struct {
   uint8_t byref;
 } slib_par_t;
 
+/**
+ * the version of the fast-call interface, see sblib_func_fast()
+ */
+#define SBLIB_FAST_VERSION 1
+
+/**
+ * a fast-call argument or return value
+ */
+typedef union {
+  var_int_t i;
+  var_num_t n;
+} slib_value_t;
+
+/**
+ * a fast-call function. the arguments are already converted to the
+ * declared types.
+ *
+ * @param args the arguments
+ * @param retval the return value
+ * @return non-zero on success
+ */
+typedef int (*slib_fast_fn)(const slib_value_t *args, slib_value_t *retval);
+
+/**
+ * declares a fast-call function. the types are 'i' for an integer
+ * (var_int_t) and 'n' for a number (var_num_t)
+ */
+typedef struct {
+  // SBLIB_FAST_VERSION
+  uint32_t version;
+
+  // the argument types, for example "nn" for two numbers
+  const char *args;
+
+  // the return type
+  char retval;
+
+  // the function
+  slib_fast_fn fn;
+} slib_fast_t;
+
 /**
  * @ingroup modstd
  *
@@ -125,6 +166,19 @@ int sblib_func_getname(int index, char *func_name);
  */
 int sblib_func_exec(int index, int param_count, slib_par_t *params, var_t *retval);
 
+/**
+ * @ingroup modlib
+ *
+ * optional, declares the function 'index' as a fast-call function with
+ * a fixed number of integer or number arguments. the arguments are then
+ * passed without creating variables and the function is called in place
+ * of sblib_func_exec()
+ *
+ * @param index the function's index
+ * @return the declaration, or NULL to use sblib_func_exec()
+ */
+const slib_fast_t *sblib_func_fast(int index);
+
 /**
  * @ingroup modlib
  *
@@ -42,6 +42,14 @@ typedef long int var_int_t;
 #define V_FUNC      7 /**< variable type, object method                @ingroup var */
 #define V_NIL       8 /**< variable type, null value                   @ingroup var */
 
+/**
+ * @ingroup var
+ *
+ * string owner value marking a buffer sized by v_strappend(), which may grow
+ * in place until the length reaches the next power of two
+ */
+#define STR_GROWABLE 2
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -85,6 +93,7 @@ typedef struct var_s {
     struct {
       char *ptr;
       uint32_t length;
+      // non-zero when ptr is freed with the variable, see STR_GROWABLE
       uint8_t owner;
     } p;
 
@@ -270,6 +279,37 @@ void v_tostr(var_t *arg);
  */
 var_t *v_clone(const var_t *source);
 
+/**
+ * @ingroup var
+ *
+ * arrays and maps are shared by the variables they are assigned to. gives
+ * the variable its own copy before the contents are written in place
+ *
+ * @param var the variable
+ */
+void v_unshare(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * detaches the array or map and stops it being shared by later assignments,
+ * since a reference to one of its elements is being kept
+ *
+ * @param var the variable
+ */
+void v_pin(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * gives the variable and each of the arrays and maps it holds their own copy.
+ * used when storing into an element, since the value could otherwise come
+ * to contain the array or map holding the element
+ *
+ * @param var the variable
+ */
+void v_unshare_all(var_t *var);
+
 /**
  * @ingroup var
  *
@@ -352,6 +392,29 @@ void v_setstrn(var_t *var, const char *string, int len);
  */
 void v_strcat(var_t *var, const char *string);
 
+/**
+ * @ingroup var
+ *
+ * appends len bytes to the string variable 'var'. the buffer grows
+ * geometrically so that repeated appends take amortized constant time
+ *
+ * @param var is the string variable
+ * @param string is the data to append, which may lie within var
+ * @param len is the number of bytes
+ */
+void v_strappend(var_t *var, const char *string, int len);
+
+/**
+ * @ingroup var
+ *
+ * appends b to the string 'a' when v_add() would concatenate them
+ *
+ * @param a is the string variable
+ * @param b is the value to append
+ * @return non-zero when b was appended, otherwise a is unchanged
+ */
+int v_add_inplace(var_t *a, const var_t *b);
+
 /**
  * @ingroup var
  *
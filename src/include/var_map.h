@@ -33,6 +33,11 @@ void map_init(var_p_t map);
 void map_free(var_p_t var_p);
 void map_get_value(var_p_t base, var_p_t key, var_p_t *result);
 void map_set(var_p_t dest, const var_p_t src);
+void map_share(var_p_t var_p);
+void map_unshare(var_p_t var_p);
+void map_pin(var_p_t var_p);
+int map_is_pinned(const var_p_t var_p);
+void map_unshare_all(var_p_t var_p);
 void map_set_int(var_p_t base, const char *name, var_int_t n);
 char *map_to_str(const var_p_t var_p);
 void map_write(const var_p_t var_p, int method, intptr_t handle);
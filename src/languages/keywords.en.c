@@ -310,6 +310,7 @@ struct func_keyword_s func_table[] = {
 { "FILES",                      kwFILES },
 { "INVERSE",                    kwINVERSE },
 { "DETERM",                     kwDETERM },
+{ "TRANSPOSE",                  kwTRANSPOSE },
 { "JULIAN",                     kwJULIAN },
 { "DATEFMT",                    kwDATEFMT },
 { "WEEKDAY",                    kwWDAY },
@@ -347,6 +348,7 @@ struct func_keyword_s func_table[] = {
 { "FORM",                       kwFORM },
 { "WINDOW",                     kwWINDOW },
 { "TIMESTAMP",                  kwTIMESTAMP },
+{ "CAPTURE",                    kwCAPTURE },
 { "", 0 }
 };
 
@@ -476,6 +478,7 @@ struct proc_keyword_s proc_table[] = {
 #define LCN_ANTIALIAS           "ANTIALIAS"
 #define LCN_LOAD_MODULES        "LOAD MODULES"
 #define LCN_AUTOLOCAL           "AUTOLOCAL"
+#define LCN_OPTIMIZE            "OPTIMIZE"
 #define LCN_AS_WRS              "AS "
 
 /* system variables */
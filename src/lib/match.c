@@ -48,316 +48,505 @@
 #define OVECCOUNT 30            /* should be a multiple of 3 */
 #endif
 
-int reg_match_after_star(const char *p, char *t);
-int reg_match_jk(const char *p, char *t);
-
-int reg_match_jk(const char *p, char *t) {
-  char range_start, range_end; /* start and end in range */
-  int invert; /* is this [..] or [!..] */
-  int member_match; /* have I matched the [..] construct? */
-  int loop; /* should I terminate? */
-
-  for (; *p; p++, t++) {
-    /*
-     * if this is the end of the text then this is the end of the reg_match 
-     */
-    if (*t == '\0')
-      return (*p == '*' && *++p == '\0') ? reg_match_valid : reg_match_abort;
-
-    /*
-     * determine and react to pattern type 
-     */
-    switch (*p) {
-    case '?': /* single any character RegMatch */
-      break;
-    case '*': /* multiple any character RegMatch */
-      return reg_match_after_star(p, t);
-    case '[': /* [..] construct, single member/exclusion *
-     * character RegMatch */
-    {
-      /*
-       * move to beginning of range 
-       */
-      p++;
+#define MATCH_CACHE_SIZE 16
 
-      /*
-       * check if this is a member reg_match or exclusion reg_match 
-       */
-      invert = 0;             // false
-      if (*p == '!' || *p == '^') {
-        invert = -1;          // true
-        p++;
-      }
+/*
+ * the pattern compiled to a list of tokens, matched with the same rules
+ * and return codes as the original character walk
+ */
+#define TOK_CHAR 0              /* literal or quoted character */
+#define TOK_ANY  1              /* ? */
+#define TOK_STAR 2              /* * */
+#define TOK_SET  3              /* [..] or [!..] */
+#define TOK_BAD  4              /* \ at the end of the pattern */
+
+typedef struct jk_range_t {
+  char lo, hi;
+} jk_range_t;
+
+typedef struct jk_token_t {
+  byte type;
+  char ch;                      /* the literal character */
+  byte invert;                  /* [!..] or [^..] */
+  byte bad;                     /* malformed after the listed ranges */
+  byte closed;                  /* the closing bracket exists */
+  int group;                    /* the capture index of ?, * and [..] */
+  int range;                    /* the first range of the set */
+  int range_count;
+} jk_token_t;
+
+typedef struct jk_pattern_t {
+  jk_token_t *tokens;
+  jk_range_t *ranges;
+  int count;
+  int group_count;
+} jk_pattern_t;
 
-      /*
-       * if closing bracket here or at range start then we have a malformed
-       * pattern 
-       */
-      if (*p == ']')
-        return reg_match_bad_pattern;
+/*
+ * the positions of the groups while the text is matched
+ */
+typedef struct jk_capture_t {
+  const char *text;
+  int *groups;
+} jk_capture_t;
+
+#define MATCH_JK             0
+#define MATCH_PCRE           1
+#define MATCH_PCRE_CASELESS  2
+
+typedef struct match_cache_t {
+  char *pattern;
+  int type;
+  jk_pattern_t *jk;
+#ifdef USE_PCRE
+  pcre *re;
+  pcre_extra *extra;
+#endif
+} match_cache_t;
 
-      member_match = 0;       // false
-      loop = -1;              // true
+// the most recently used pattern first
+static SB_THREAD_LOCAL match_cache_t match_cache[MATCH_CACHE_SIZE];
+static SB_THREAD_LOCAL int match_cache_count;
 
-      while (loop) { /* if end of construct then loop is done */
-        if (*p == ']') {
-          loop = 0;           // false
-          continue;
-        }
+static int jk_match(const jk_pattern_t *pat, int i, const char *t, jk_capture_t *cap);
 
-        /*
-         * RegMatching a '!', '^', '-', '\' or a ']' 
-         */
-        if (*p == '\\')
-          range_start = range_end = *++p;
-        else
-          range_start = range_end = *p;
-
-        /*
-         * if end of pattern then bad pattern (Missing ']') 
-         */
-        if (*p == '\0')
-          return reg_match_bad_pattern;
-
-        /*
-         * check for range bar 
-         */
-        if (*++p == '-') {
-          /*
-           * get the range end 
-           */
-          range_end = *++p;
-
-          /*
-           * if end of pattern or construct then bad pattern 
-           */
-          if (range_end == '\0' || range_end == ']')
-            return reg_match_bad_pattern;
-
-          /*
-           * special character range end 
-           */
-          if (range_end == '\\') {
-            range_end = *++p;
-
-            /*
-             * if end of text then we have a bad pattern 
-             */
-            if (!range_end)
-              return reg_match_bad_pattern;
-          }
-
-          /*
-           * move just beyond this range 
-           */
-          p++;
-        }
+/*
+ * adds a token to the pattern
+ */
+static jk_token_t *jk_add_token(jk_pattern_t *pat, int type, int *size) {
+  if (pat->count == *size) {
+    *size += 16;
+    pat->tokens = (jk_token_t *)realloc(pat->tokens, *size * sizeof(jk_token_t));
+  }
+  jk_token_t *tok = &pat->tokens[pat->count++];
+  memset(tok, 0, sizeof(jk_token_t));
+  tok->type = type;
+  tok->group = (type == TOK_ANY || type == TOK_STAR || type == TOK_SET) ? pat->group_count++ : -1;
+  return tok;
+}
 
-        /*
-         * if the text character is in range then RegMatch found. make sure
-         * the range letters have the proper relationship to one another
-         * before comparison 
-         */
-
-        if (range_start < range_end) {
-          if (*t >= range_start && *t <= range_end) {
-            member_match = -1;  // true
-            loop = 0;         // false
-          }
-        } else {
-          if (*t >= range_end && *t <= range_start) {
-            member_match = -1;  // true
-            loop = 0;         // false
-          }
+/*
+ * compiles the [..] construct, p is after the opening bracket. returns the
+ * position after the construct or NULL when the rest of the pattern can never
+ * be reached
+ */
+static const char *jk_compile_set(jk_pattern_t *pat, jk_token_t *tok, const char *p, int *size) {
+  char range_start, range_end;
+  const char *start;
+
+  if (*p == '!' || *p == '^') {
+    tok->invert = 1;
+    p++;
+  }
+  tok->range = *size;
+  start = p;
+  if (*p == ']') {
+    // empty set
+    tok->bad = 1;
+  }
+  while (!tok->bad && *p != ']') {
+    start = p;
+    if (*p == '\\') {
+      range_start = range_end = *++p;
+    } else {
+      range_start = range_end = *p;
+    }
+    if (*p == '\0') {
+      // missing ']'
+      tok->bad = 1;
+      break;
+    }
+    if (*++p == '-') {
+      range_end = *++p;
+      if (range_end == '\0' || range_end == ']') {
+        tok->bad = 1;
+        break;
+      }
+      if (range_end == '\\') {
+        range_end = *++p;
+        if (!range_end) {
+          tok->bad = 1;
+          break;
         }
-      }                       // while ?
-
-      /*
-       * if there was a match in an exclusion set then no match 
-       */
-      /*
-       * if there was no match in a member set then no match 
-       */
-
-      if ((invert && member_match) || !(invert || member_match))
-        return reg_match_range_failure;
-
-      /*
-       * if this is not an exclusion then skip the rest of the [...]
-       * construct that already RegMatched. 
-       */
-
-      if (member_match) {
-        while (*p != ']') {
-          /*
-           * bad pattern (Missing ']') 
-           */
-          if (*p == '\0')
-            return reg_match_bad_pattern;
-
-          /*
-           * skip exact RegMatch 
-           */
-          if (*p == '\\') {
-            p++;
-
-            /*
-             * if end of text then we have a bad pattern 
-             */
-            if (*p == '\0')
-              return reg_match_bad_pattern;
-          }
-
-          /*
-           * move to next pattern char 
-           */
-          p++;
-        }                     // while
       }
-      break;
+      p++;
     }
-    case '\\': /* next character is quoted and must match *
-     * exactly */
-      /*
-       * move pattern pointer to quoted char and fall through 
-       */
+    if (tok->range + tok->range_count == *size) {
+      *size += 8;
+      pat->ranges = (jk_range_t *)realloc(pat->ranges, *size * sizeof(jk_range_t));
+    }
+    jk_range_t *range = &pat->ranges[tok->range + tok->range_count++];
+    range->lo = range_start < range_end ? range_start : range_end;
+    range->hi = range_start < range_end ? range_end : range_start;
+  }
+  if (tok->bad) {
+    // a matched member skips to the closing bracket from the last good range
+    p = start;
+    while (*p != ']') {
+      if (*p == '\0' || (*p == '\\' && *++p == '\0')) {
+        return NULL;
+      }
       p++;
+    }
+  }
+  tok->closed = 1;
+  return p + 1;
+}
 
-      /*
-       * if end of text then we have a bad pattern 
-       */
-      if (*p == '\0')
-        return reg_match_bad_pattern;
+/*
+ * compiles the wildcard pattern
+ */
+static jk_pattern_t *jk_compile(const char *p) {
+  jk_pattern_t *pat = (jk_pattern_t *)calloc(1, sizeof(jk_pattern_t));
+  int token_size = 0;
+  int range_size = 0;
+  jk_token_t *tok;
 
-      /*
-       * must match this character exactly 
-       */
+  while (p != NULL && *p) {
+    switch (*p) {
+    case '?':
+      jk_add_token(pat, TOK_ANY, &token_size);
+      p++;
+      break;
+    case '*':
+      jk_add_token(pat, TOK_STAR, &token_size);
+      p++;
+      break;
+    case '[':
+      tok = jk_add_token(pat, TOK_SET, &token_size);
+      p = jk_compile_set(pat, tok, p + 1, &range_size);
+      break;
+    case '\\':
+      if (*++p == '\0') {
+        jk_add_token(pat, TOK_BAD, &token_size);
+        break;
+      }
+      // fall through
     default:
-      if (*p != *t)
-        return reg_match_literal_failure;
-    }                           // switch!
-  }                             // first for
+      tok = jk_add_token(pat, TOK_CHAR, &token_size);
+      tok->ch = *p++;
+      break;
+    }
+  }
+  return pat;
+}
 
-  /*
-   * if end of text not reached then the pattern fails 
-   */
-  if (*t)
-    return reg_match_premature_end;
-  return reg_match_valid;
+static void jk_free(jk_pattern_t *pat) {
+  free(pat->tokens);
+  free(pat->ranges);
+  free(pat);
+}
+
+static inline void jk_set_group(jk_capture_t *cap, int group, const char *t, int len) {
+  if (cap != NULL) {
+    cap->groups[group * 2] = t - cap->text;
+    cap->groups[group * 2 + 1] = len;
+  }
 }
 
 /*
+ * matches a character against the [..] construct
  */
-#ifdef USE_PCRE
-int reg_match_pcre(const char *p, char *t)
-{
-  pcre *re;
-  const char *error;
-  int errofs;
+static int jk_match_set(const jk_pattern_t *pat, const jk_token_t *tok, char c) {
+  int member_match = 0;
+  for (int i = 0; i < tok->range_count && !member_match; i++) {
+    const jk_range_t *range = &pat->ranges[tok->range + i];
+    member_match = (c >= range->lo && c <= range->hi);
+  }
+  if (tok->invert) {
+    if (member_match) {
+      return reg_match_range_failure;
+    }
+    return tok->bad ? reg_match_bad_pattern : reg_match_valid;
+  }
+  if (!member_match) {
+    return tok->bad ? reg_match_bad_pattern : reg_match_range_failure;
+  }
+  return tok->closed ? reg_match_valid : reg_match_bad_pattern;
+}
 
-  re =
-  pcre_compile(p, (opt_usepcre == 2) ? PCRE_CASELESS : 0, &error, &errofs, NULL);
-  if (!re) {
-    rt_raise("REGULAR EXPRESSION SYNTAX ERROR (offset %d) -> %s", error, errofs);
-    return reg_match_bad_pattern;
+/*
+ * stores the groups of the ? and * sequence that starts at token i and
+ * covers the text from t to end
+ */
+static void jk_set_star_groups(const jk_pattern_t *pat, int i, int last,
+                               const char *t, const char *end, jk_capture_t *cap) {
+  int any = 0;
+  int star = -1;
+  for (int j = i; j < last; j++) {
+    if (pat->tokens[j].type == TOK_ANY) {
+      any++;
+    } else {
+      star = j;
+    }
   }
-  else {
-    int rc;
-    int ovector[OVECCOUNT];
+  int len = (end - t) - any;
+  for (int j = i; j < last; j++) {
+    if (pat->tokens[j].type == TOK_ANY) {
+      jk_set_group(cap, pat->tokens[j].group, t++, 1);
+    } else if (j == star) {
+      jk_set_group(cap, pat->tokens[j].group, t, len);
+      t += len;
+    } else {
+      jk_set_group(cap, pat->tokens[j].group, t, 0);
+    }
+  }
+}
 
-    rc = pcre_exec(re, NULL, t, strlen(t), 0, 0, ovector, OVECCOUNT);
-    if (rc >= 0)
+/*
+ * recursively call jk_match() with final segment of PATTERN and of TEXT.
+ */
+static int jk_match_after_star(const jk_pattern_t *pat, int i, const char *t, jk_capture_t *cap) {
+  int RegMatch = 1;
+  int first = i;
+  const char *start = t;
+  const jk_token_t *tok;
+
+  // pass over existing ? and * in pattern, take one char for each ?
+  while (i < pat->count &&
+         (pat->tokens[i].type == TOK_ANY || pat->tokens[i].type == TOK_STAR)) {
+    if (pat->tokens[i].type == TOK_ANY && !*t++) {
+      return reg_match_abort;
+    }
+    i++;
+  }
+
+  // if end of pattern we have RegMatched regardless of text left
+  if (i == pat->count) {
+    if (cap != NULL) {
+      jk_set_star_groups(pat, first, i, start, t + strlen(t), cap);
+    }
     return reg_match_valid;
   }
 
-  return reg_match_literal_failure;
+  // the next token must be a literal or a [..] construct
+  tok = &pat->tokens[i];
+  if (tok->type == TOK_BAD) {
+    return reg_match_bad_pattern;
+  }
+  int any = (tok->type == TOK_SET || tok->ch == '[');
+
+  // continue until we run out of text or definite result seen
+  do {
+    if (any || tok->ch == *t) {
+      RegMatch = jk_match(pat, i, t, cap);
+      if (RegMatch == reg_match_valid && cap != NULL) {
+        jk_set_star_groups(pat, first, i, start, t, cap);
+      }
+    }
+    if (!*t++) {
+      RegMatch = reg_match_abort;
+    }
+  } while (RegMatch != reg_match_valid && RegMatch != reg_match_abort && RegMatch != reg_match_bad_pattern);
+
+  return RegMatch;
 }
-#endif
 
 /*
+ * matches the text from the token i
  */
-int reg_match(const char *p, char *t) {
-#ifdef USE_PCRE
-  if (opt_usepcre)
-  return reg_match_pcre(p, t);
-#endif
-  return reg_match_jk(p, t);
-}
-
-/*----------------------------------------------------------------------------
- *
- * recursively call RegMatche() with final segment of PATTERN and of TEXT.
- *
- ----------------------------------------------------------------------------*/
-int reg_match_after_star(const char *p, char *t) {
-  int RegMatch = 1;             // unused code
-  int nextp;
-
-  /*
-   * pass over existing ? and * in pattern 
-   */
-  while (*p == '?' || *p == '*') {
-    /*
-     * take one char for each ? and + 
-     */
-    if (*p == '?') {
-      /*
-       * if end of text then no RegMatch 
-       */
-      if (!*t++)
-        return reg_match_abort;
+static int jk_match(const jk_pattern_t *pat, int i, const char *t, jk_capture_t *cap) {
+  for (; i < pat->count; i++, t++) {
+    const jk_token_t *tok = &pat->tokens[i];
+
+    // if this is the end of the text then this is the end of the reg_match
+    if (*t == '\0') {
+      if (tok->type == TOK_STAR && i + 1 == pat->count) {
+        jk_set_group(cap, tok->group, t, 0);
+        return reg_match_valid;
+      }
+      return reg_match_abort;
     }
 
-    /*
-     * move to next char in pattern 
-     */
-    p++;
+    switch (tok->type) {
+    case TOK_ANY:
+      jk_set_group(cap, tok->group, t, 1);
+      break;
+    case TOK_STAR:
+      return jk_match_after_star(pat, i, t, cap);
+    case TOK_SET: {
+      int result = jk_match_set(pat, tok, *t);
+      if (result != reg_match_valid) {
+        return result;
+      }
+      jk_set_group(cap, tok->group, t, 1);
+      break;
+    }
+    case TOK_BAD:
+      return reg_match_bad_pattern;
+    default:
+      if (tok->ch != *t) {
+        return reg_match_literal_failure;
+      }
+    }
   }
 
-  /*
-   * if end of pattern we have RegMatched regardless of text left 
-   */
-  if (!*p)
-    return reg_match_valid;
+  // if end of text not reached then the pattern fails
+  if (*t) {
+    return reg_match_premature_end;
+  }
+  return reg_match_valid;
+}
 
-  /*
-   * get the next character to RegMatch which must be a literal or '[' 
-   */
-  nextp = *p;
-  if (nextp == '\\') {
-    nextp = p[1];
-
-    /*
-     * if end of text then we have a bad pattern 
-     */
-    if (!nextp)
-      return reg_match_bad_pattern;
+static void match_cache_free_entry(match_cache_t *entry) {
+#ifdef USE_PCRE
+  if (entry->re) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+    pcre_free_study(entry->extra);
+#else
+    pcre_free(entry->extra);
+#endif
+    pcre_free(entry->re);
+  }
+#endif
+  if (entry->jk) {
+    jk_free(entry->jk);
   }
+  free(entry->pattern);
+}
 
-  /*
-   * Continue until we run out of text or definite result seen 
-   */
-  do {
-    /*
-     * a precondition for RegMatching is that the next character in the pattern 
-     * RegMatch the next character in the text or that the next pattern char is 
-     * the beginning of a range.  Increment text pointer as we go here 
-     */
+/*
+ * returns the cached entry for the pattern, compiles the pattern
+ * when it's not found
+ */
+static match_cache_t *match_cache_get(const char *p, int type) {
+  match_cache_t entry;
+  int i;
 
-    if (nextp == *t || nextp == '[')
-      RegMatch = reg_match(p, t);
+  for (i = 0; i < match_cache_count; i++) {
+    if (match_cache[i].type == type && strcmp(match_cache[i].pattern, p) == 0) {
+      break;
+    }
+  }
+  if (i == 0 && match_cache_count) {
+    return &match_cache[0];
+  }
+  if (i < match_cache_count) {
+    entry = match_cache[i];
+  } else {
+    memset(&entry, 0, sizeof(entry));
+    entry.type = type;
+#ifdef USE_PCRE
+    if (type != MATCH_JK) {
+      const char *error;
+      int errofs;
+      entry.re = pcre_compile(p, type == MATCH_PCRE_CASELESS ? PCRE_CASELESS : 0,
+                              &error, &errofs, NULL);
+      if (!entry.re) {
+        rt_raise("REGULAR EXPRESSION SYNTAX ERROR (offset %d) -> %s", errofs, error);
+        return NULL;
+      }
+#ifdef PCRE_STUDY_JIT_COMPILE
+      entry.extra = pcre_study(entry.re, PCRE_STUDY_JIT_COMPILE, &error);
+#else
+      entry.extra = pcre_study(entry.re, 0, &error);
+#endif
+    } else {
+      entry.jk = jk_compile(p);
+    }
+#else
+    entry.jk = jk_compile(p);
+#endif
+    entry.pattern = strdup(p);
+    if (match_cache_count == MATCH_CACHE_SIZE) {
+      // discard the least recently used pattern
+      i = match_cache_count - 1;
+      match_cache_free_entry(&match_cache[i]);
+    } else {
+      i = match_cache_count++;
+    }
+  }
+  memmove(&match_cache[1], &match_cache[0], i * sizeof(match_cache_t));
+  match_cache[0] = entry;
+  return &match_cache[0];
+}
 
-    /*
-     * if the end of text is reached then no RegMatch 
-     */
+/*
+ * returns the type of matching selected with OPTION PREDEF
+ */
+static int match_type() {
+#ifdef USE_PCRE
+  if (opt_usepcre) {
+    return opt_usepcre == 2 ? MATCH_PCRE_CASELESS : MATCH_PCRE;
+  }
+#endif
+  return MATCH_JK;
+}
 
-    if (!*t++)
-      RegMatch = reg_match_abort;
+/*
+ */
+int reg_match(const char *p, char *t) {
+  match_cache_t *entry = match_cache_get(p, match_type());
+  if (entry == NULL) {
+    return reg_match_bad_pattern;
+  }
+#ifdef USE_PCRE
+  if (entry->re) {
+    int ovector[OVECCOUNT];
+    int rc = pcre_exec(entry->re, entry->extra, t, strlen(t), 0, 0, ovector, OVECCOUNT);
+    return rc >= 0 ? reg_match_valid : reg_match_literal_failure;
+  }
+#endif
+  return jk_match(entry->jk, 0, t, NULL);
+}
 
-  } while (RegMatch != reg_match_valid && RegMatch != reg_match_abort && RegMatch != reg_match_bad_pattern);
+/*
+ */
+int *reg_match_capture(const char *p, const char *t, int *count) {
+  match_cache_t *entry = match_cache_get(p, match_type());
+  int *groups = NULL;
 
-  /*
-   * return result 
-   */
-  return RegMatch;
+  *count = 0;
+  if (entry == NULL) {
+    return NULL;
+  }
+#ifdef USE_PCRE
+  if (entry->re) {
+    int n;
+    pcre_fullinfo(entry->re, entry->extra, PCRE_INFO_CAPTURECOUNT, &n);
+    int size = (n + 1) * 3;
+    int *ovector = (int *)malloc(size * sizeof(int));
+    int rc = pcre_exec(entry->re, entry->extra, t, strlen(t), 0, 0, ovector, size);
+    if (rc >= 0) {
+      groups = (int *)malloc((n + 1) * 2 * sizeof(int));
+      for (int i = 0; i <= n; i++) {
+        int start = ovector[i * 2];
+        int end = ovector[i * 2 + 1];
+        if (i < rc && start != -1) {
+          groups[i * 2] = start;
+          groups[i * 2 + 1] = end - start;
+        } else {
+          groups[i * 2] = -1;
+          groups[i * 2 + 1] = 0;
+        }
+      }
+      *count = n + 1;
+    }
+    free(ovector);
+    return groups;
+  }
+#endif
+  jk_capture_t cap;
+  int n = entry->jk->group_count + 1;
+  groups = (int *)malloc(n * 2 * sizeof(int));
+  cap.text = t;
+  cap.groups = groups + 2;
+  if (jk_match(entry->jk, 0, t, &cap) == reg_match_valid) {
+    // the group zero is the whole text
+    groups[0] = 0;
+    groups[1] = strlen(t);
+    *count = n;
+    return groups;
+  }
+  free(groups);
+  return NULL;
+}
+
+/*
+ */
+void reg_match_free() {
+  for (int i = 0; i < match_cache_count; i++) {
+    match_cache_free_entry(&match_cache[i]);
+  }
+  match_cache_count = 0;
 }
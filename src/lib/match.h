@@ -66,4 +66,29 @@
  */
 int reg_match(const char *p, char *t);
 
+/**
+ * @ingroup str
+ *
+ * matches the text like reg_match() and returns the position and length
+ * of each group. the group zero is the whole match, the other groups are
+ * the PCRE sub-patterns or else each ?, * and [..] of the pattern. an unset
+ * group has the position -1.
+ *
+ * the compiled patterns are kept in a small cache, the least recently
+ * used pattern is discarded first.
+ *
+ * @param p is the pattern
+ * @param t is the text
+ * @param count is the number of groups
+ * @return the position and length pairs, NULL when the text does not match
+ */
+int *reg_match_capture(const char *p, const char *t, int *count);
+
+/**
+ * @ingroup str
+ *
+ * frees the cached patterns
+ */
+void reg_match_free();
+
 #endif
@@ -26,33 +26,124 @@
 #include "common/sys.h"
 #include "common/blib_math.h"
 
-// creates a matrix of the given size
-var_num_t **mat_create(int row, int col) {
-  var_num_t **m = (var_num_t **)malloc(sizeof(var_num_t *) * row);
-  int i;
-  for (i = 0; i < row; i++) {
-    m[i] = (var_num_t *)malloc(sizeof(var_num_t) * col);
-  }
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
 
-  return m;
-}
+// the tile size of the blocked kernels, three tiles fit in the L1 cache
+#define MAT_BLOCK 64
+
+// multiply with threads when the product needs more operations
+#define MAT_THREAD_MIN (128 * 128 * 128)
+#define MAT_THREAD_MAX 8
+
+#define MAT_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+typedef struct mat_product_t {
+  const var_num_t *a;
+  const var_num_t *b;
+  var_num_t *c;
+  int row_start;
+  int row_end;
+  int m;
+  int p;
+} mat_product_t;
+
+/*
+ * multiplies the rows row_start..row_end of A with B. the loops are blocked
+ * so that the tiles stay in the cache, the inner loop runs over contiguous
+ * rows of B and C which the compiler can vectorise. each element of C adds
+ * the products in the same order as the textbook loop.
+ */
+static void *mat_product_rows(void *arg) {
+  mat_product_t *job = (mat_product_t *)arg;
+  const int m = job->m;
+  const int p = job->p;
 
-// free an allocated matrix
-void mat_free(var_num_t **m, int n) {
-  int i;
-  for (i = 0; i < n; i++) {
-    free(m[i]);
+  for (int i = job->row_start; i < job->row_end; i++) {
+    var_num_t *restrict c = job->c + (size_t)i * p;
+    for (int j = 0; j < p; j++) {
+      c[j] = 0.0;
+    }
+  }
+  for (int ii = job->row_start; ii < job->row_end; ii += MAT_BLOCK) {
+    int i_end = MAT_MIN(ii + MAT_BLOCK, job->row_end);
+    for (int kk = 0; kk < m; kk += MAT_BLOCK) {
+      int k_end = MAT_MIN(kk + MAT_BLOCK, m);
+      for (int jj = 0; jj < p; jj += MAT_BLOCK) {
+        int j_end = MAT_MIN(jj + MAT_BLOCK, p);
+        for (int i = ii; i < i_end; i++) {
+          var_num_t *restrict c = job->c + (size_t)i * p;
+          const var_num_t *a = job->a + (size_t)i * m;
+          for (int k = kk; k < k_end; k++) {
+            const var_num_t *restrict b = job->b + (size_t)k * p;
+            var_num_t aik = a[k];
+            for (int j = jj; j < j_end; j++) {
+              c[j] += aik * b[j];
+            }
+          }
+        }
+      }
+    }
   }
-  free(m);
+  return NULL;
 }
 
-// fill the matrix with zero values
-void mat_fill(var_num_t **A, int row, int col) {
-  int i, j;
+/*
+ * C[n,p] = A[n,m] * B[m,p]
+ */
+void mat_product(const var_num_t *a, const var_num_t *b, var_num_t *c, int n, int m, int p) {
+  mat_product_t job = { a, b, c, 0, n, m, p };
+#if defined(HAVE_PTHREAD)
+  long threads = 1;
+  if ((double)n * m * p >= MAT_THREAD_MIN) {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = MAT_MIN(threads, MAT_THREAD_MAX);
+    threads = MAT_MIN(threads, n / MAT_BLOCK);
+  }
+  if (threads > 1) {
+    pthread_t thread[MAT_THREAD_MAX];
+    mat_product_t jobs[MAT_THREAD_MAX];
+    int started = 0;
+    int rows = (n + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+      jobs[t] = job;
+      jobs[t].row_start = MAT_MIN(t * rows, n);
+      jobs[t].row_end = MAT_MIN(t * rows + rows, n);
+    }
+    // the current thread takes the first rows
+    for (int t = 1; t < threads; t++) {
+      if (pthread_create(&thread[t], NULL, mat_product_rows, &jobs[t]) != 0) {
+        mat_product_rows(&jobs[t]);
+      } else {
+        started |= (1 << t);
+      }
+    }
+    mat_product_rows(&jobs[0]);
+    for (int t = 1; t < threads; t++) {
+      if (started & (1 << t)) {
+        pthread_join(thread[t], NULL);
+      }
+    }
+    return;
+  }
+#endif
+  mat_product_rows(&job);
+}
 
-  for (i = 0; i < row; i++) {
-    for (j = 0; j < col; j++) {
-      A[i][j] = 0.0;
+/*
+ * T[cols,rows] = transpose of A[rows,cols], copied in tiles
+ */
+void mat_transpose(const var_num_t *a, var_num_t *t, int rows, int cols) {
+  for (int ii = 0; ii < rows; ii += MAT_BLOCK) {
+    int i_end = MAT_MIN(ii + MAT_BLOCK, rows);
+    for (int jj = 0; jj < cols; jj += MAT_BLOCK) {
+      int j_end = MAT_MIN(jj + MAT_BLOCK, cols);
+      for (int i = ii; i < i_end; i++) {
+        for (int j = jj; j < j_end; j++) {
+          t[(size_t)j * rows + i] = a[(size_t)i * cols + j];
+        }
+      }
     }
   }
 }
@@ -67,25 +158,27 @@ void mat_fill(var_num_t **A, int row, int col) {
  *               -1 means suspected singular matrix
  *       comen:  A will be overwritten to be a LU-composite matrix
  *
- *       note:   the LU decomposed may NOT be equal to the LU of
- *               the orignal matrix a. But equal to the LU of the
- *               rows interchanged matrix.
+ *       note:   the rows of A are exchanged in place, the LU is the
+ *               LU of the rows interchanged matrix. row i holds the
+ *               original row P[i].
  *-----------------------------------------------------------------------------
  */
-int mat_lu(var_num_t **A, var_num_t **P, int n) {
-  int i, j, k, maxi, tmp, p;
+static int mat_lu(var_num_t *A, int *P, int n, double toler) {
+  int i, j, k, maxi, p;
   var_num_t c, c1;
 
   for (p = 0, i = 0; i < n; i++) {
-    P[i][0] = i;
+    P[i] = i;
   }
 
   for (k = 0; k < n; k++) {
+    var_num_t *restrict row_k = A + (size_t)k * n;
+
     /*
      * --- partial pivoting ---
      */
     for (i = k, maxi = k, c = 0.0; i < n; i++) {
-      c1 = fabsl(A[(int) P[i][0]][k]);
+      c1 = fabs(A[(size_t)i * n + k]);
       if (c1 > c) {
         c = c1;
         maxi = i;
@@ -96,30 +189,36 @@ int mat_lu(var_num_t **A, var_num_t **P, int n) {
      * row exchange, update permutation vector
      */
     if (k != maxi) {
+      var_num_t *row_max = A + (size_t)maxi * n;
+      var_num_t swp;
+      int tmp;
       p++;
-      tmp = P[k][0];
-      P[k][0] = P[maxi][0];
-      P[maxi][0] = tmp;
+      for (j = 0; j < n; j++) {
+        SWAP(row_k[j], row_max[j], swp);
+      }
+      SWAP(P[k], P[maxi], tmp);
     }
 
     /*
      * suspected singular matrix
      */
-    if (A[(int) P[k][0]][k] == 0.0) {
+    if (c <= toler) {
       return -1;
     }
 
     for (i = k + 1; i < n; i++) {
+      var_num_t *restrict row_i = A + (size_t)i * n;
+
       /*
        * --- calculate m(i,j) ---
        */
-      A[(int) P[i][0]][k] = A[(int) P[i][0]][k] / A[(int) P[k][0]][k];
+      var_num_t f = row_i[k] = row_i[k] / row_k[k];
 
       /*
        * --- elimination ---
        */
       for (j = k + 1; j < n; j++) {
-        A[(int) P[i][0]][j] -= A[(int) P[i][0]][k] * A[(int) P[k][0]][j];
+        row_i[j] -= f * row_k[j];
       }
     }
   }
@@ -132,34 +231,34 @@ int mat_lu(var_num_t **A, var_num_t **P, int n) {
  *       funct:  mat_backsubs1
  *       desct:  back substitution
  *       given:  A = square matrix A (LU composite)
- *               !! B = column matrix B (attention!, see comen)
+ *               !! B = column matrix B, in the order of the rows of A
  *               !! X = place to put the result of X
- *               P = Permutation vector (after calling mat_lu)
- *               xcol = column of x to put the result
  *       retrn:  column matrix X (of AX = B)
- *       comen:  B will be overwritten
+ *       comen:  B will be overwritten. both passes walk the rows of A
  *-----------------------------------------------------------------------------
  */
-var_num_t **mat_backsubs1(var_num_t **A, var_num_t **B, var_num_t **X, var_num_t **P, int xcol, int n) {
+static void mat_backsubs1(const var_num_t *A, var_num_t *B, var_num_t *X, int n) {
   int i, j, k;
   var_num_t sum;
 
-  for (k = 0; k < n; k++) {
-    for (i = k + 1; i < n; i++) {
-      B[(int) P[i][0]][0] -= A[(int) P[i][0]][k] * B[(int) P[k][0]][0];
+  for (i = 1; i < n; i++) {
+    const var_num_t *row_i = A + (size_t)i * n;
+    sum = B[i];
+    for (k = 0; k < i; k++) {
+      sum -= row_i[k] * B[k];
     }
+    B[i] = sum;
   }
 
-  X[n - 1][xcol] = B[(int) P[n - 1][0]][0] / A[(int) P[n - 1][0]][n - 1];
+  X[n - 1] = B[n - 1] / A[(size_t)(n - 1) * n + n - 1];
   for (k = n - 2; k >= 0; k--) {
+    const var_num_t *row_k = A + (size_t)k * n;
     sum = 0.0;
     for (j = k + 1; j < n; j++) {
-      sum += A[(int) P[k][0]][j] * X[j][xcol];
+      sum += row_k[j] * X[j];
     }
-    X[k][xcol] = (B[(int) P[k][0]][0] - sum) / A[(int) P[k][0]][k];
+    X[k] = (B[k] - sum) / row_k[k];
   }
-
-  return X;
 }
 
 /*
@@ -168,43 +267,121 @@ var_num_t **mat_backsubs1(var_num_t **A, var_num_t **B, var_num_t **X, var_num_t
  *      desct:  find inverse of a matrix
  *      given:  a = square matrix a
  *      retrn:  square matrix Inverse(A)
- *              NULL = fails, singular matrix, or malloc() fails
+ *              a is not changed when the matrix is singular
  *-----------------------------------------------------------------------------
  */
 void mat_inverse(var_num_t *a, const int n) {
-  var_num_t **A = mat_create(n, n);
-  var_num_t **B = mat_create(n, 1);
-  var_num_t **C = mat_create(n, n);
-  var_num_t **P = mat_create(n, 1);
-
-  int i, j;
+  var_num_t *A = (var_num_t *)malloc(sizeof(var_num_t) * n * n);
+  var_num_t *B = (var_num_t *)malloc(sizeof(var_num_t) * n);
+  var_num_t *X = (var_num_t *)malloc(sizeof(var_num_t) * n);
+  int *P = (int *)malloc(sizeof(int) * n);
 
-  // copy input matrix to working buffer
-  for (i = 0; i < n; i++) {
-    for (j = 0; j < n; j++) {
-      A[i][j] = a[i * n + j];
+  // LU-decomposition of a copy, also check for singular matrix
+  memcpy(A, a, sizeof(var_num_t) * n * n);
+  if (mat_lu(A, P, n, 0.0) != -1) {
+    for (int i = 0; i < n; i++) {
+      // the unit column i in the order of the exchanged rows
+      for (int j = 0; j < n; j++) {
+        B[j] = (P[j] == i) ? 1.0 : 0.0;
+      }
+      mat_backsubs1(A, B, X, n);
+      for (int j = 0; j < n; j++) {
+        a[(size_t)j * n + i] = X[j];
+      }
     }
   }
 
-  // LU-decomposition, also check for singular matrix
-  if (mat_lu(A, P, n) != -1) {
-    for (i = 0; i < n; i++) {
-      mat_fill(B, n, 1);
-      B[i][0] = 1.0;
-      mat_backsubs1(A, B, C, P, i, n);
+  // release memory
+  free(P);
+  free(X);
+  free(B);
+  free(A);
+}
+
+/*
+ * Whether the fraction-free elimination of the integer matrix A is exact in
+ * doubles. Each intermediate value is a minor of A, bounded by the product of
+ * the row norms (Hadamard), and the update multiplies two of them
+ */
+static int mat_bareiss_exact(const var_num_t *a, int n) {
+  double log2_bound = 0;
+  for (int i = 0; i < n; i++) {
+    double norm2 = 0;
+    for (int j = 0; j < n; j++) {
+      double v = a[(size_t)i * n + j];
+      if (v != floor(v)) {
+        return 0;
+      }
+      norm2 += v * v;
     }
+    if (norm2 > 1) {
+      log2_bound += log2(norm2) / 2;
+    }
+  }
+  // |x * y - f * z| < 2 * bound^2 must stay below 2^53
+  return log2_bound < 26;
+}
 
-    // copy the result in C back to a
-    for (i = 0; i < n; i++) {
-      for (j = 0; j < n; j++) {
-        a[i * n + j] = C[i][j];
+/*
+ * Determinant of an integer matrix with the fraction-free elimination
+ * (Bareiss), each division is exact so the result stays an integer
+ */
+static var_num_t mat_determ_bareiss(var_num_t *A, int n, double toler) {
+  var_num_t prev = 1;
+  var_num_t sign = 1;
+
+  for (int k = 0; k < n - 1; k++) {
+    var_num_t *restrict row_k = A + (size_t)k * n;
+    int maxi = k;
+    for (int i = k + 1; i < n; i++) {
+      if (fabs(A[(size_t)i * n + k]) > fabs(A[(size_t)maxi * n + k])) {
+        maxi = i;
+      }
+    }
+    if (fabs(A[(size_t)maxi * n + k]) <= toler) {
+      return 0;
+    }
+    if (maxi != k) {
+      var_num_t *row_max = A + (size_t)maxi * n;
+      var_num_t swp;
+      for (int j = k; j < n; j++) {
+        SWAP(row_k[j], row_max[j], swp);
+      }
+      sign = -sign;
+    }
+    for (int i = k + 1; i < n; i++) {
+      var_num_t *restrict row_i = A + (size_t)i * n;
+      var_num_t f = row_i[k];
+      for (int j = k + 1; j < n; j++) {
+        row_i[j] = (row_i[j] * row_k[k] - f * row_k[j]) / prev;
       }
     }
+    prev = row_k[k];
   }
+  return sign * A[(size_t)n * n - 1];
+}
 
-  // release memory
-  mat_free(P, n);
-  mat_free(C, n);
-  mat_free(B, n);
-  mat_free(A, n);
+/*
+ * Determinant of A from the LU decomposition
+ */
+var_num_t mat_determ_lu(const var_num_t *a, int n, double toler) {
+  var_num_t *A = (var_num_t *)malloc(sizeof(var_num_t) * n * n);
+  int *P = (int *)malloc(sizeof(int) * n);
+  var_num_t result = 0;
+
+  memcpy(A, a, sizeof(var_num_t) * n * n);
+  if (mat_bareiss_exact(A, n)) {
+    result = mat_determ_bareiss(A, n, toler);
+  } else {
+    int swaps = mat_lu(A, P, n, toler);
+    if (swaps != -1) {
+      result = (swaps % 2) ? -1 : 1;
+      for (int i = 0; i < n; i++) {
+        result *= A[(size_t)i * n + i];
+      }
+    }
+  }
+  free(P);
+  free(A);
+  return result;
 }
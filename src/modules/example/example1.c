@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include "var.h"
 #include "module.h"
 
@@ -68,6 +69,18 @@ int func_libtest(int param_count, slib_par_t *params, var_t *retval) {
   return 1; // success
 }
 
+/**
+ * a fast-call function
+ *
+ * this function returns the hypotenuse of its two number arguments
+ */
+int func_hypot(const slib_value_t *args, slib_value_t *retval) {
+  retval->n = sqrt(args[0].n * args[0].n + args[1].n * args[1].n);
+  return 1; // success
+}
+
+static const slib_fast_t fast_hypot = {SBLIB_FAST_VERSION, "nn", 'n', func_hypot};
+
 /**
  *
  * code that required by SB
@@ -85,7 +98,7 @@ int sblib_proc_count(void) {
  * returns the number of the functions
  */
 int sblib_func_count(void) {
-  return 1;
+  return 2;
 }
 
 /**
@@ -109,6 +122,9 @@ int sblib_func_getname(int index, char *proc_name) {
   case 0:
     strcpy(proc_name, "LIBFUNCTEST");
     return 1; // success
+  case 1:
+    strcpy(proc_name, "HYPOT");
+    return 1; // success
   }
   return 0; // error
 }
@@ -144,3 +160,10 @@ int sblib_func_exec(int index, int param_count, slib_par_t *params, var_t *retva
   }
   return success;
 }
+
+/**
+ * declare the fast-call functions
+ */
+const slib_fast_t *sblib_func_fast(int index) {
+  return index == 1 ? &fast_hypot : NULL;
+}
@@ -27,6 +27,7 @@ LOCAL_SRC_FILES  :=    \
     $(COMMON)/blib_math.c        \
     $(COMMON)/blib_sound.c       \
     $(COMMON)/brun.c             \
+    $(COMMON)/bc_cache.c         \
     $(COMMON)/ceval.c            \
     $(COMMON)/device.c           \
     $(COMMON)/screen.c           \
@@ -138,6 +138,9 @@ void dump_bytecode(FILE *output) {
     case kwTYPE_EVPOP:
       fprintf(output, "pop (l)eft");
       break;
+    case kwTYPE_FASTOPR:
+      fprintf(output, "fast (l)eft (opr) (r)ight");
+      break;
     case kwTYPE_EOC:
       fprintf(output, "end-of-command");
       break;
@@ -31,6 +31,10 @@ static struct option OPTIONS[] = {
   {"decompile",      optional_argument, NULL, 's'},
   {"option",         optional_argument, NULL, 'o'},
   {"cmd",            optional_argument, NULL, 'c'},
+  {"cache-dir",      required_argument, NULL, 'd'},
+  {"bc-cache",       required_argument, NULL, 'b'},
+  {"optimize",       no_argument,       NULL, 'O'},
+  {"profile",        required_argument, NULL, 'p'},
   {"stdin",          optional_argument, NULL, '-'},
   {"help",           optional_argument, NULL, 'h'},
   {0, 0, 0, 0}
@@ -235,7 +239,7 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile) {
   bool result = true;
   while (result) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "vkfxm::s::o:c:h::", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "vkfxm::s::o:c:d:b:Op:h::", OPTIONS, &option_index);
     if (c == -1 && !option_index) {
       // no more options
       for (int i = 1; i < argc; i++) {
@@ -296,6 +300,18 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile) {
     case 'o':
       strcpy(opt_command, optarg);
       break;
+    case 'd':
+      strlcpy(opt_cache_dir, optarg, sizeof(opt_cache_dir));
+      break;
+    case 'b':
+      opt_bc_cache = atoi(optarg);
+      break;
+    case 'O':
+      opt_optimize = 1;
+      break;
+    case 'p':
+      strlcpy(opt_profile, optarg, sizeof(opt_profile));
+      break;
     case 'c':
       if (setup_command_program(optarg, runFile)) {
         *tmpFile = true;
@@ -339,12 +355,17 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile) {
 int main(int argc, char *argv[]) {
   opt_autolocal = 0;
   opt_command[0] = '\0';
+  opt_event_budget = 0;
   opt_file_permitted = 1;
   opt_graphics = 0;
   opt_ide = 0;
   opt_loadmod = 0;
   opt_modpath[0] = 0;
+  opt_cache_dir[0] = 0;
+  opt_bc_cache = 16;
+  opt_profile[0] = 0;
   opt_nosave = 1;
+  opt_optimize = 0;
   opt_pref_height = 0;
   opt_pref_width = 0;
   opt_quiet = 1;
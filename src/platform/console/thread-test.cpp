@@ -0,0 +1,85 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2001-2018 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#include "config.h"
+#include <pthread.h>
+#include "common/sbapp.h"
+
+//
+// runs each of the given programs on its own thread, several times over,
+// to check the interpreter state is kept per thread (--enable-reentrant)
+//
+
+#define THREAD_TEST_ROUNDS 8
+
+void console_init();
+
+struct ThreadTest {
+  const char *file;
+  int errors;
+};
+
+static void *run_test(void *arg) {
+  ThreadTest *test = (ThreadTest *)arg;
+  for (int i = 0; i < THREAD_TEST_ROUNDS; i++) {
+    sbasic_main(test->file);
+    if (gsb_last_error) {
+      test->errors++;
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  opt_autolocal = 0;
+  opt_command[0] = '\0';
+  opt_event_budget = 0;
+  opt_file_permitted = 1;
+  opt_graphics = 0;
+  opt_ide = 0;
+  opt_loadmod = 0;
+  opt_modpath[0] = 0;
+  opt_cache_dir[0] = 0;
+  opt_bc_cache = 16;
+  opt_profile[0] = 0;
+  opt_nosave = 1;
+  opt_optimize = 0;
+  opt_pref_height = 0;
+  opt_pref_width = 0;
+  opt_quiet = 1;
+  opt_verbose = 0;
+
+  console_init();
+
+  int count = argc - 1;
+  if (count < 2) {
+    fprintf(stderr, "usage: thread-test file.bas file.bas...\n");
+    return 1;
+  }
+
+  ThreadTest *tests = new ThreadTest[count];
+  pthread_t *threads = new pthread_t[count];
+  for (int i = 0; i < count; i++) {
+    tests[i].file = argv[i + 1];
+    tests[i].errors = 0;
+    pthread_create(&threads[i], NULL, run_test, &tests[i]);
+  }
+
+  int result = 0;
+  for (int i = 0; i < count; i++) {
+    pthread_join(threads[i], NULL);
+    if (tests[i].errors) {
+      fprintf(stdout, "%s failed %d of %d runs\n", tests[i].file, tests[i].errors, THREAD_TEST_ROUNDS);
+      result = 1;
+    }
+  }
+
+  delete [] tests;
+  delete [] threads;
+  return result;
+}
@@ -0,0 +1,69 @@
+#!/bin/sh
+# SmallBASIC web server load test
+# Copyright(C) 2001-2018 Chris Warren-Smith.
+#
+# This program is distributed under the terms of the GPL v2.0 or later
+# Download the GNU Public License (GPL) from www.gnu.org
+#
+# usage: load-test.sh [url] [clients] [requests]
+#
+# each client sends its requests one after the other, all clients run at
+# the same time. reports the latency of the requests and the throughput
+# of the server, eg:
+#
+#   sbasicw --workers=4 --port=8080 &
+#   ./load-test.sh http://localhost:8080/index.bas 8 100
+#
+
+url=${1:-http://localhost:8080/}
+clients=${2:-4}
+requests=${3:-50}
+
+if ! command -v curl >/dev/null 2>&1; then
+  echo "curl is required"
+  exit 1
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+client() {
+  i=0
+  while [ $i -lt $requests ]; do
+    curl -s -o /dev/null -w "%{http_code} %{time_total}\n" "$url"
+    i=$((i + 1))
+  done > "$tmp/client.$1"
+}
+
+start=$(date +%s.%N)
+n=1
+while [ $n -le $clients ]; do
+  client $n &
+  n=$((n + 1))
+done
+wait
+finish=$(date +%s.%N)
+
+cat "$tmp"/client.* | awk -v url="$url" -v clients=$clients -v start=$start -v finish=$finish '
+  $1 == 200 { ms[ok++] = $2 * 1000; total += $2 * 1000 }
+  $1 != 200 { failed++ }
+  END {
+    elapsed = finish - start
+    printf "URL:        %s\n", url
+    printf "CLIENTS:    %d\n", clients
+    printf "REQUESTS:   %d ok, %d failed\n", ok, failed
+    if (ok == 0) {
+      exit 1
+    }
+    # insertion sort, the sample is small
+    for (i = 1; i < ok; i++) {
+      v = ms[i]
+      for (j = i - 1; j >= 0 && ms[j] > v; j--) {
+        ms[j + 1] = ms[j]
+      }
+      ms[j + 1] = v
+    }
+    printf "LATENCY:    min %.1fms, avg %.1fms, p50 %.1fms, p95 %.1fms, max %.1fms\n",
+           ms[0], total / ok, ms[int(ok * 0.5)], ms[int(ok * 0.95)], ms[ok - 1]
+    printf "THROUGHPUT: %.1f requests/sec in %.2fs\n", ok / elapsed, elapsed
+  }'
@@ -14,12 +14,22 @@
 #include <string.h>
 #include <stdio.h>
 #include <string.h>
+#if !defined(_Win32)
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "include/osd.h"
 #include "common/sbapp.h"
 #include "common/device.h"
 #include "platform/web/canvas.h"
 
+#define MAX_WORKERS 64
+
 Canvas g_canvas;
 uint32_t g_start = 0;
 uint32_t g_maxTime = 2000;
@@ -41,15 +51,20 @@ static struct option OPTIONS[] = {
   {"graphic-text",   optional_argument, NULL, 'g'},
   {"max-time",       optional_argument, NULL, 't'},
   {"module",         optional_argument, NULL, 'm'},
+  {"workers",        required_argument, NULL, 'n'},
+  {"cache-dir",      required_argument, NULL, 'd'},
   {0, 0, 0, 0}
 };
 
 void init() {
   opt_command[0] = '\0';
+  opt_event_budget = 0;
+  opt_bc_cache = 64;
   opt_file_permitted = 0;
   opt_graphics = 1;
   opt_ide = 0;
   opt_modpath[0] = '\0';
+  opt_cache_dir[0] = '\0';
   opt_nosave = 1;
   opt_pref_height = 0;
   opt_pref_width = 0;
@@ -141,6 +156,7 @@ MHD_Response *execute(struct MHD_Connection *connection, const char *bas) {
   g_cookies.removeAll();
   sbasic_main(bas);
   g_connection = NULL;
+  log("%s done in %dms", bas, dev_get_millisecond_count() - g_start);
   String page = g_canvas.getPage();
   MHD_Response *response =
     MHD_create_response_from_buffer(page.length(), (void *)page.c_str(),
@@ -233,14 +249,124 @@ int access_cb(void *cls,
   return result;
 }
 
+#if !defined(_Win32)
+// creates the listening socket shared by the worker processes
+int open_listener(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd != -1) {
+    int on = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, SOMAXCONN) == -1) {
+      close(fd);
+      fd = -1;
+    } else {
+      // idle workers must not block in accept()
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+  }
+  return fd;
+}
+
+// forks a worker process serving requests from the shared socket
+pid_t start_worker(int fd) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    MHD_Daemon *d =
+      MHD_start_daemon(MHD_USE_SELECT_INTERNALLY, 0,
+                       &accept_cb, NULL,
+                       &access_cb, NULL,
+                       MHD_OPTION_LISTEN_SOCKET, fd,
+                       MHD_OPTION_END);
+    if (d == NULL) {
+      fprintf(stderr, "worker startup failed\n");
+      _exit(1);
+    }
+    while (1) {
+      pause();
+    }
+  }
+  return pid;
+}
+
+// serves requests from a pool of forked worker processes, each
+// keeping its own cache of compiled programs. a worker that exits
+// is started again, at most once per second
+int start_workers(int port, int workers) {
+  int fd = open_listener(port);
+  if (fd == -1) {
+    fprintf(stderr, "startup failed\n");
+    return 1;
+  }
+  pid_t *pids = (pid_t *)calloc(workers, sizeof(pid_t));
+  for (int i = 0; i < workers; i++) {
+    pids[i] = start_worker(fd);
+    if (pids[i] == -1) {
+      fprintf(stderr, "failed to start worker %d\n", i + 1);
+    }
+  }
+
+  // wait for input on stdin, as with a single server
+  bool running = true;
+  while (running) {
+    fd_set fds;
+    struct timeval tv;
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO, &fds);
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    if (select(STDIN_FILENO + 1, &fds, NULL, NULL, &tv) > 0) {
+      getc(stdin);
+      running = false;
+    }
+
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (int i = 0; i < workers; i++) {
+        if (pids[i] == pid) {
+          pids[i] = -1;
+        }
+      }
+    }
+    for (int i = 0; i < workers && running; i++) {
+      if (pids[i] == -1) {
+        pids[i] = start_worker(fd);
+        if (pids[i] != -1) {
+          log("restarted worker %d", i + 1);
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < workers; i++) {
+    if (pids[i] > 0) {
+      kill(pids[i], SIGTERM);
+      waitpid(pids[i], NULL, 0);
+    }
+  }
+  free(pids);
+  close(fd);
+  return 0;
+}
+#endif
+
 int main(int argc, char **argv) {
   init();
   int port = 8080;
+  int workers = 1;
   char *runBas = NULL;
+  char *end;
+  long count;
 
   while (1) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "hvfxp:t:m::r:w:e:c:g:", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "hvfxp:t:m::r:w:e:c:g:n:d:", OPTIONS, &option_index);
     if (c == -1) {
       break;
     }
@@ -290,6 +416,20 @@ int main(int argc, char **argv) {
     case 'x':
       g_noExecute = true;
       break;
+    case 'n':
+      count = strtol(optarg, &end, 10);
+      if (*end != '\0' || count < 1) {
+        fprintf(stderr, "workers must be between 1 and %d\n", MAX_WORKERS);
+        exit(1);
+      } else if (count > MAX_WORKERS) {
+        fprintf(stderr, "workers limited to %d\n", MAX_WORKERS);
+        count = MAX_WORKERS;
+      }
+      workers = count;
+      break;
+    case 'd':
+      strlcpy(opt_cache_dir, optarg, sizeof(opt_cache_dir));
+      break;
     default:
       show_help();
       exit(1);
@@ -302,6 +442,14 @@ int main(int argc, char **argv) {
     g_start = dev_get_millisecond_count();
     sbasic_main(runBas);
     puts(g_canvas.getPage().c_str());
+  } else if (workers > 1) {
+#if !defined(_Win32)
+    fprintf(stdout, "Starting SmallBASIC web server on port:%d with %d workers\n", port, workers);
+    return start_workers(port, workers);
+#else
+    fprintf(stderr, "workers are not supported on this platform\n");
+    return 1;
+#endif
   } else {
     fprintf(stdout, "Starting SmallBASIC web server on port:%d\n", port);
     MHD_Daemon *d =
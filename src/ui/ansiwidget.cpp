@@ -187,8 +187,6 @@ int AnsiWidget::getScreenId(bool back) {
 void AnsiWidget::print(const char *str) {
   int len = (str == NULL ? 0 : strlen(str));
   if (len) {
-    _back->drawInto();
-
     int lineHeight = textHeight();
     const char *p = (char *)str;
 
@@ -385,7 +383,7 @@ void AnsiWidget::insetMenuScreen(int x, int y, int w, int h) {
   menuScreen->_height = h;
   menuScreen->setOver(_front);
   _front = _back = menuScreen;
-  _front->_dirty = true;
+  _front->invalidate();
 }
 
 void AnsiWidget::insetTextScreen(int x, int y, int w, int h) {
@@ -395,7 +393,7 @@ void AnsiWidget::insetTextScreen(int x, int y, int w, int h) {
   TextScreen *textScreen = (TextScreen *)createScreen(TEXT_SCREEN);
   textScreen->inset(x, y, w, h, _front);
   _front = _back = textScreen;
-  _front->_dirty = true;
+  _front->invalidate();
   flush(true);
 }
 
@@ -505,7 +503,7 @@ void AnsiWidget::pointerReleaseEvent(MAEvent &event) {
         _front->_scrollY = maxScroll;
       }
       // ensure the scrollbar is removed
-      _front->_dirty = true;
+      _front->invalidate();
       flush(true);
       _touchTime = 0;
     }
@@ -576,7 +574,7 @@ void AnsiWidget::doSwipe(int start, bool moveDown, int distance, int maxScroll)
       vscroll = maxScroll;
     }
     if (vscroll != _front->_scrollY) {
-      _front->_dirty = true; // forced
+      _front->invalidate(); // forced
       _front->_scrollY = vscroll;
       flush(true, true);
     } else {
@@ -713,7 +711,7 @@ bool AnsiWidget::setActiveButton(MAEvent &event, Screen *screen) {
         break;
       }
       if (redraw) {
-        _front->_dirty = true;
+        _front->invalidate();
         flush(true);
       }
     }
@@ -731,7 +729,7 @@ void AnsiWidget::selectBackScreen(int screenId) {
 
 void AnsiWidget::selectFrontScreen(int screenId) {
   _front = createScreen(screenId);
-  _front->_dirty = true;
+  _front->invalidate();
   flush(true);
 }
 
@@ -739,7 +737,7 @@ int AnsiWidget::selectScreen(int screenId, bool forceFlush) {
   int result = getScreenId(true);
   selectBackScreen(screenId);
   _front = _back;
-  _front->_dirty = true;
+  _front->invalidate();
   flush(forceFlush);
   return result;
 }
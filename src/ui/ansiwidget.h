@@ -54,6 +54,7 @@ struct AnsiWidget {
   int  getFontSize() { return _fontSize; }
   FormInput *getNextField(FormInput *field) { return _back->getNextField(field); }
   int  getPixel(int x, int y) { return _back->getPixel(x, y); }
+  int  getPixelsPushed() { return _front->_pushed; }
   int  getScreenId(bool back);
   int  getScreenWidth()  { return _back->_width; }
   void getScroll(int &x, int &y) { _back->getScroll(x, y); }
@@ -287,6 +287,10 @@ extern "C" void v_create_form(var_p_t var) {
     var_p_t v_focus = map_get(var, FORM_FOCUS);
     unsigned i_focus = v_focus != NULL ? v_getint(v_focus) : -1;
     var_p_t inputs = map_get(var, FORM_INPUTS);
+    if (inputs != NULL) {
+      // the inputs are shared with the source map
+      v_unshare(inputs);
+    }
     for (unsigned i = 0; inputs != NULL && i < v_asize(inputs); i++) {
       var_p_t elem = v_elem(inputs, i);
       if (elem->type == V_MAP) {
@@ -33,47 +33,154 @@ inline double fpart(double x) {
 #define _SWAP(a, b) \
   { __typeof__(a) tmp; tmp = a; a = b; b = tmp; }
 
+// blends the color into the pixels by the coverage of each pixel. the red and
+// blue then the alpha and green channels are blended as pairs of 16 bit lanes
+// with x / 255 rounded as (x + 128 + ((x + 128) >> 8)) >> 8, there are no
+// branches so the loop can be vectorised by the compiler
+static void blendSpan(pixel_t *line, const uint8_t *alpha, int n, pixel_t color) {
+  uint32_t srcRB = color & 0x00ff00ff;
+  uint32_t srcAG = (color >> 8) & 0x00ff00ff;
+  for (int i = 0; i < n; i++) {
+    uint32_t a = alpha[i];
+    uint32_t dst = line[i];
+    uint32_t rb = srcRB * a + (dst & 0x00ff00ff) * (255 - a) + 0x00800080;
+    uint32_t ag = srcAG * a + ((dst >> 8) & 0x00ff00ff) * (255 - a) + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+    line[i] = rb | ag;
+  }
+}
+
 Font::Font(FT_Face face, int size, bool italic) :
-  _face(face) {
+  _face(face),
+  _table(NULL),
+  _tableSize(0),
+  _tableCount(0),
+  _size(size),
+  _italic(italic) {
   FT_Set_Pixel_Sizes(face, 0, size);
   _spacing = 1 + (FT_MulFix(_face->height, _face->size->metrics.x_scale) / 64);
   _h = (FT_MulFix(_face->ascender, _face->size->metrics.x_scale) / 64) +
        (FT_MulFix(_face->descender, _face->size->metrics.x_scale) / 64);
-  FT_Matrix  matrix;
-  if (italic) {
+}
+
+Font::~Font() {
+  for (int i = 0; i < MAX_GLYPHS; i++) {
+    freeGlyph(&_glyph[i]);
+  }
+  for (int i = 0; i < _tableSize; i++) {
+    freeGlyph(&_table[i]);
+  }
+  delete [] _table;
+}
+
+void Font::freeGlyph(Glyph *glyph) {
+  if (glyph->_slot) {
+    FT_Done_Glyph(glyph->_slot);
+  }
+  delete [] glyph->_spans;
+}
+
+Glyph *Font::getGlyph(unsigned code) {
+  Glyph *result = code < MAX_GLYPHS ? &_glyph[code] : lookup(code);
+  if (!result->_loaded) {
+    loadGlyph(result, code);
+  }
+  return result;
+}
+
+// returns the slot for the codepoint in the open addressed table
+Glyph *Font::find(unsigned code) {
+  int mask = _tableSize - 1;
+  int i = (code * 2654435761u) & mask;
+  while (_table[i]._loaded && _table[i]._code != code) {
+    i = (i + 1) & mask;
+  }
+  return &_table[i];
+}
+
+// returns the table slot for the codepoint, the table is doubled in size
+// before a new glyph would make it more than three quarters full
+Glyph *Font::lookup(unsigned code) {
+  Glyph *result = _table ? find(code) : NULL;
+  if (!result || (!result->_loaded && 4 * (_tableCount + 1) > 3 * _tableSize)) {
+    Glyph *table = _table;
+    int size = _tableSize;
+    _tableSize = size ? size * 2 : GLYPH_TABLE_SIZE;
+    _table = new Glyph[_tableSize];
+    for (int i = 0; i < size; i++) {
+      if (table[i]._loaded) {
+        *find(table[i]._code) = table[i];
+      }
+    }
+    delete [] table;
+    result = find(code);
+  }
+  return result;
+}
+
+void Font::loadGlyph(Glyph *glyph, unsigned code) {
+  if (code >= MAX_GLYPHS) {
+    _tableCount++;
+  }
+  glyph->_code = code;
+  glyph->_loaded = true;
+
+  // the face is shared with the other fonts of the same style
+  if (_face->size->metrics.y_ppem != _size) {
+    FT_Set_Pixel_Sizes(_face, 0, _size);
+  }
+
+  FT_UInt slot = FT_Get_Char_Index(_face, code);
+  FT_Error error = FT_Load_Glyph(_face, slot, FT_LOAD_TARGET_LIGHT);
+  if (error) {
+    trace("Failed to load %d", code);
+  }
+  glyph->_w = (int)(_face->glyph->metrics.horiAdvance / 64);
+  error = FT_Get_Glyph(_face->glyph, &glyph->_slot);
+  if (error) {
+    trace("Failed to get glyph %d", code);
+    glyph->_slot = NULL;
+    return;
+  }
+  if (_italic) {
+    FT_Matrix matrix;
     matrix.xx = 0x10000L;
     matrix.xy = 0.12 * 0x10000L;
     matrix.yx = 0;
     matrix.yy = 0x10000L;
-  }
-
-  for (int i = 0; i < MAX_GLYPHS; i++) {
-    FT_UInt slot = FT_Get_Char_Index(face, i);
-    FT_Error error = FT_Load_Glyph(face, slot, FT_LOAD_TARGET_LIGHT);
-    if (error) {
-      trace("Failed to load %d", i);
-    }
-    error = FT_Get_Glyph(face->glyph, &_glyph[i]._slot);
-    if (error) {
-      trace("Failed to get glyph %d", i);
+    FT_Glyph_Transform(glyph->_slot, &matrix, 0);
+  }
+  FT_Vector origin;
+  origin.x = 0;
+  origin.y = 0;
+  error = FT_Glyph_To_Bitmap(&glyph->_slot, FT_RENDER_MODE_LIGHT, &origin, 1);
+  if (error) {
+    trace("Failed to get bitmap %d", code);
+    FT_Done_Glyph(glyph->_slot);
+    glyph->_slot = NULL;
+    return;
+  }
+
+  // find the covered part of each row, and whether it can be drawn without blending
+  FT_Bitmap *bitmap = &((FT_BitmapGlyph)glyph->_slot)->bitmap;
+  int width = bitmap->width;
+  glyph->_spans = new GlyphSpan[bitmap->rows];
+  for (int y = 0; y < (int)bitmap->rows; y++) {
+    const uint8_t *row = bitmap->buffer + y * bitmap->pitch;
+    GlyphSpan *span = &glyph->_spans[y];
+    span->_start = 0;
+    span->_end = width;
+    while (span->_start < span->_end && !row[span->_start]) {
+      span->_start++;
     }
-    if (italic) {
-      FT_Glyph_Transform(_glyph[i]._slot, &matrix, 0 );
+    while (span->_end > span->_start && !row[span->_end - 1]) {
+      span->_end--;
     }
-    FT_Vector origin;
-    origin.x = 0;
-    origin.y = 0;
-    error = FT_Glyph_To_Bitmap(&_glyph[i]._slot, FT_RENDER_MODE_LIGHT, &origin, 1);
-    if (error) {
-      trace("Failed to get bitmap %d", i);
+    span->_opaque = true;
+    for (int x = span->_start; x < span->_end && span->_opaque; x++) {
+      span->_opaque = (row[x] == 255);
     }
-    _glyph[i]._w = (int)(face->glyph->metrics.horiAdvance / 64);
-  }
-}
-
-Font::~Font() {
-  for (int i = 0; i < MAX_GLYPHS; i++) {
-    FT_Done_Glyph(_glyph[i]._slot);
   }
 }
 
@@ -272,8 +379,11 @@ void Graphics::drawLine(int startX, int startY, int endX, int endY) {
 }
 
 void Graphics::drawPixel(int posX, int posY) {
-  pixel_t *line = _drawTarget->getLine(posY);
-  line[posX] = _drawColor;
+  if (posX >= _drawTarget->x() && posX < _drawTarget->w() &&
+      posY >= _drawTarget->y() && posY < _drawTarget->h()) {
+    pixel_t *line = _drawTarget->getLine(posY);
+    line[posX] = _drawColor;
+  }
 }
 
 void Graphics::drawRGB(const MAPoint2d *dstPoint, const void *src,
@@ -327,36 +437,36 @@ void Graphics::drawRGB(const MAPoint2d *dstPoint, const void *src,
   }
 }
 
-void Graphics::drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y) {
-  FT_Int xMax = x + bitmap->width;
-  FT_Int yMax = y + bitmap->rows;
-
-  uint8_t sR, sG, sB;
-  GET_RGB(_drawColor, sR, sG, sB);
+void Graphics::drawChar(Glyph *glyph, int x, int y) {
+  FT_BitmapGlyph bitmapGlyph = (FT_BitmapGlyph)glyph->_slot;
+  FT_Bitmap *bitmap = &bitmapGlyph->bitmap;
+  x += bitmapGlyph->left;
+  y -= bitmapGlyph->top;
 
   int dtX = _drawTarget->x();
   int dtY = _drawTarget->y();
   int dtW = _drawTarget->w();
   int dtH = _drawTarget->h();
 
-  for (FT_Int j = y, q = 0; j < yMax; j++, q++) {
-    if (j >= dtY && j < dtH) {
-      pixel_t *line = _drawTarget->getLine(j);
-      for (FT_Int i = x, p = 0; i < xMax; i++, p++) {
-        if (i >= dtX && i < dtW) {
-          uint8_t a = bitmap->buffer[q * bitmap->width + p];
-          if (a == 255) {
-            line[i] = _drawColor;
-          } else {
-            // blend drawColor to the background
-            uint8_t dR, dG, dB;
-            GET_RGB(line[i], dR, dG, dB);
-            dR = dR + ((sR - dR) * a / 255);
-            dG = dG + ((sG - dG) * a / 255);
-            dB = dB + ((sB - dB) * a / 255);
-            line[i] = SET_RGB(dR, dG, dB);
-          }
+  // the visible columns and rows of the bitmap
+  int left = MAX(dtX - x, 0);
+  int right = MIN(dtW - x, (int)bitmap->width);
+  int top = MAX(dtY - y, 0);
+  int bottom = MIN(dtH - y, (int)bitmap->rows);
+
+  for (int q = top; q < bottom; q++) {
+    const GlyphSpan &span = glyph->_spans[q];
+    int start = MAX(span._start, left);
+    int end = MIN(span._end, right);
+    if (start < end) {
+      pixel_t *line = _drawTarget->getLine(y + q) + x;
+      if (span._opaque) {
+        for (int i = start; i < end; i++) {
+          line[i] = _drawColor;
         }
+      } else {
+        const uint8_t *alpha = bitmap->buffer + q * bitmap->pitch;
+        blendSpan(line + start, alpha + start, end - start, _drawColor);
       }
     }
   }
@@ -364,16 +474,16 @@ void Graphics::drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y) {
 
 void Graphics::drawText(int left, int top, const char *str, int len) {
   if (_drawTarget && _font) {
-    FT_Vector pen;
-    pen.x = left;
-    pen.y = top + _font->_h + ((_font->_spacing - _font->_h) / 2);
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      FT_BitmapGlyph glyph = (FT_BitmapGlyph)_font->_glyph[ch]._slot;
-      drawChar(&glyph->bitmap,
-               pen.x + glyph->left,
-               pen.y - glyph->top);
-      pen.x += _font->_glyph[ch]._w;
+    int x = left;
+    int y = top + _font->_h + ((_font->_spacing - _font->_h) / 2);
+    for (int i = 0; i < len;) {
+      unsigned code;
+      i += utf8_decode(str + i, len - i, code);
+      Glyph *glyph = _font->getGlyph(code);
+      if (glyph->_slot) {
+        drawChar(glyph, x, y);
+      }
+      x += glyph->_w;
     }
   }
 }
@@ -430,9 +540,10 @@ MAExtent Graphics::getTextSize(const char *str, int len) {
   int width = 0;
   int height = 0;
   if (_font) {
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      width += _font->_glyph[ch]._w;
+    for (int i = 0; i < len;) {
+      unsigned code;
+      i += utf8_decode(str + i, len - i, code);
+      width += _font->getGlyph(code)->_w;
     }
     height = _font->_spacing;
   }
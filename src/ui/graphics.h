@@ -18,24 +18,51 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 
+// codepoints below MAX_GLYPHS are held in a direct table, others are hashed
 #define MAX_GLYPHS 256
+#define GLYPH_TABLE_SIZE 64
 
 using namespace strlib;
 
 namespace ui {
 
+// the covered part of a glyph bitmap row
+struct GlyphSpan {
+  int _start;
+  int _end;
+  bool _opaque;
+};
+
 struct Glyph {
+  Glyph() : _slot(NULL), _spans(NULL), _code(0), _w(0), _loaded(false) {}
   FT_Glyph _slot;
+  GlyphSpan *_spans;
+  unsigned _code;
   int _w;
+  bool _loaded;
 };
 
+// glyphs are rendered into the font when they are first drawn or measured
 struct Font {
   Font(FT_Face face, int size, bool italic);
   virtual ~Font();
+  Glyph *getGlyph(unsigned code);
   int _h;
   int _spacing;
   FT_Face _face;
+
+private:
+  Glyph *find(unsigned code);
+  void freeGlyph(Glyph *glyph);
+  Glyph *lookup(unsigned code);
+  void loadGlyph(Glyph *glyph, unsigned code);
+
   Glyph _glyph[MAX_GLYPHS];
+  Glyph *_table;
+  int _tableSize;
+  int _tableCount;
+  int _size;
+  bool _italic;
 };
 
 struct Graphics {
@@ -68,7 +95,7 @@ struct Graphics {
   MAHandle setDrawTarget(MAHandle maHandle);
 
 protected:
-  void drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y);
+  void drawChar(Glyph *glyph, int x, int y);
   void aaLine(int x0, int y0, int x1, int y1);
   void aaPlot(int x, int y, double c);
   void aaPlotX8(int xc, int yc, int x, int y, double c, bool fill);
@@ -284,11 +284,15 @@ void FormInput::setHelpTextColor() {
 var_p_t FormInput::getField(var_p_t form) {
   var_p_t result = NULL;
   if (form->type == V_MAP) {
+    // the widget state is written into the field
+    v_unshare(form);
     var_p_t inputs = map_get(form, FORM_INPUTS);
     if (inputs != NULL && inputs->type == V_ARRAY) {
+      v_unshare(inputs);
       for (unsigned i = 0; i < v_asize(inputs) && !result; i++) {
         var_p_t elem = v_elem(inputs, i);
         if (elem->type == V_MAP && (_id == map_get_int(elem, FORM_INPUT_ID, -1))) {
+          v_unshare(elem);
           result = elem;
         }
       }
@@ -933,6 +937,7 @@ void FormList::updateForm(var_p_t form) {
   const char *selected = getText();
 
   // set the form value
+  v_unshare(form);
   var_p_t value = map_get(form, FORM_VALUE);
   if (value == NULL) {
     value = map_add_var(form, FORM_VALUE, 0);
@@ -7,6 +7,8 @@
 //
 
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 #include "ui/screen.h"
 
@@ -27,6 +29,12 @@ int compareZIndex(const void *p1, const void *p2) {
   return (*i1)->_zIndex < (*i2)->_zIndex ? -1 : (*i1)->_zIndex == (*i2)->_zIndex ? 0 : 1;
 }
 
+// whether the rectangle overlaps the given region
+inline bool intersects(const MARect &rect, int x, int y, int w, int h) {
+  return (x < rect.left + rect.width && x + w > rect.left &&
+          y < rect.top + rect.height && y + h > rect.top);
+}
+
 bool Shape::isFullScreen() const {
   MAExtent screenSize = maGetScrSize();
   return _width == EXTENT_X(screenSize) && _height == EXTENT_Y(screenSize);
@@ -46,7 +54,9 @@ Screen::Screen(int x, int y, int width, int height, int fontSize) :
   _curX(INITXY),
   _curY(INITXY),
   _dirty(0),
-  _linePadding(0) {
+  _linePadding(0),
+  _pushed(0),
+  _redraw(true) {
 }
 
 Screen::~Screen() {
@@ -346,17 +356,18 @@ bool Screen::overlaps(int px, int py) {
 }
 
 int Screen::print(const char *p, int lineHeight, bool allChars) {
-  // print minimum of one character
-  int numChars = 1;
+  // print minimum of one character, a UTF-8 sequence is kept whole
+  unsigned code;
+  int numChars = utf8_decode(p, 4, code);
   int cx = _charWidth;
   int w = _width - 1;
 
   // print further non-control, non-null characters
   // up to the width of the line
-  while (p[numChars] > 31) {
+  while ((uint8_t)p[numChars] > 31) {
     cx += _charWidth;
     if (allChars || _curX + cx < w) {
-      numChars++;
+      numChars += utf8_decode(p + numChars, 4, code);
     } else {
       break;
     }
@@ -516,7 +527,10 @@ GraphicScreen::GraphicScreen(int width, int height, int fontSize) :
   _imageHeight(height),
   _curYSaved(0),
   _curXSaved(0),
-  _tabSize(40) {  // tab size in pixels (160/32 = 5)
+  _tabSize(40),  // tab size in pixels (160/32 = 5)
+  _damageCount(0),
+  _drawnScrollY(0),
+  _imageTop(0) {
 }
 
 GraphicScreen::~GraphicScreen() {
@@ -551,27 +565,224 @@ void GraphicScreen::clear() {
   drawInto(true);
   maSetColor(_bg);
   maFillRect(0, 0, _imageWidth, _imageHeight);
+  _imageTop = 0;
   Screen::clear();
 }
 
-void GraphicScreen::drawArc(int xc, int yc, double r, double start, double end, double aspect) {
-  drawInto();
-  maArc(xc, yc, r, start, end, aspect);
+// selects the image for drawing into the given region, only the changed
+// regions are copied to the screen by the next drawBase()
+void GraphicScreen::damage(int x, int y, int w, int h) {
+  maSetDrawTarget(_image);
+  maSetColor(_fg);
+  if (!_dirty) {
+    _dirty = maGetMilliSecondCount();
+  }
+  if (w < 0) {
+    x += w;
+    w = -w;
+  }
+  if (h < 0) {
+    y += h;
+    h = -h;
+  }
+  int x2 = MIN(x + w, _imageWidth);
+  int y2 = MIN(y + h, _imageHeight);
+  x = MAX(x, 0);
+  y = MAX(y, 0);
+  if (_redraw || x >= x2 || y >= y2) {
+    return;
+  }
+
+  // join with an overlapping or adjoining region, otherwise with the region
+  // that grows the least when the list is full
+  int join = -1;
+  int growth = 0;
+  for (int i = 0; i < _damageCount; i++) {
+    MARect &next = _damage[i];
+    int left = MIN(x, next.left);
+    int top = MIN(y, next.top);
+    int right = MAX(x2, next.left + next.width);
+    int bottom = MAX(y2, next.top + next.height);
+    int extra = ((right - left) * (bottom - top)) - (next.width * next.height);
+    if (intersects(next, x - 1, y - 1, x2 - x + 2, y2 - y + 2)) {
+      join = i;
+      break;
+    }
+    if (_damageCount == MAX_DAMAGE && (join == -1 || extra < growth)) {
+      join = i;
+      growth = extra;
+    }
+  }
+  if (join == -1) {
+    MARect &next = _damage[_damageCount++];
+    next.left = x;
+    next.top = y;
+    next.width = x2 - x;
+    next.height = y2 - y;
+  } else {
+    MARect &next = _damage[join];
+    int right = MAX(x2, next.left + next.width);
+    int bottom = MAX(y2, next.top + next.height);
+    next.left = MIN(x, next.left);
+    next.top = MIN(y, next.top);
+    next.width = right - next.left;
+    next.height = bottom - next.top;
+  }
 }
 
-void GraphicScreen::drawBase(bool vscroll, bool update) {
+// copies the changed regions to the screen, returns false when the whole
+// screen must be drawn since the regions cover part of the overlay
+bool GraphicScreen::drawDamage() {
+  MARect rects[MAX_DAMAGE];
+  int count = 0;
+  for (int i = 0; i < _damageCount; i++) {
+    // the visible part in screen coordinates
+    MARect &next = _damage[i];
+    int top = MAX(next.top, _scrollY);
+    int bottom = MIN(next.top + next.height, _scrollY + _height);
+    int right = MIN(next.left + next.width, _width);
+    if (top < bottom && next.left < right) {
+      MARect &rect = rects[count++];
+      rect.left = next.left;
+      rect.top = top - _scrollY;
+      rect.width = right - next.left;
+      rect.height = bottom - top;
+      if (overlapsOverlay(rect)) {
+        return false;
+      }
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    MARect &rect = rects[i];
+    drawImage(rect.left, rect.top + _scrollY, rect.width, rect.height,
+              _x + rect.left, _y + rect.top);
+    _pushed += rect.width * rect.height;
+  }
+  return true;
+}
+
+// copies the rows y..y+h of the ring buffer to the draw target, the rows
+// below the end of the image continue from the top
+void GraphicScreen::drawImage(int x, int y, int w, int h, int dstX, int dstY) {
   MARect srcRect;
   MAPoint2d dstPoint;
-  srcRect.left = 0;
-  srcRect.top = _scrollY;
-  srcRect.width = _width;
-  srcRect.height = _height;
-  dstPoint.x = _x;
-  dstPoint.y = _y;
-  MAHandle currentHandle = maSetDrawTarget(HANDLE_SCREEN);
-  maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  int split = _imageHeight - _imageTop;
+  int bottom = MIN(y + h, _imageHeight);
+
+  srcRect.left = x;
+  srcRect.width = w;
+  dstPoint.x = dstX;
+  if (y < split) {
+    srcRect.top = y + _imageTop;
+    srcRect.height = MIN(bottom, split) - y;
+    dstPoint.y = dstY;
+    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  }
+  if (bottom > split) {
+    int top = MAX(y, split);
+    srcRect.top = top - split;
+    srcRect.height = bottom - top;
+    dstPoint.y = dstY + top - y;
+    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  }
+}
 
-  drawOverlay(vscroll);
+// fills the rows y..y+h of the ring buffer
+void GraphicScreen::fillRect(int x, int y, int w, int h) {
+  int split = _imageHeight - _imageTop;
+  int top = MAX(y, 0);
+  int bottom = MIN(y + h, _imageHeight);
+  if (top < MIN(bottom, split)) {
+    maFillRect(x, top + _imageTop, w, MIN(bottom, split) - top);
+  }
+  if (bottom > split) {
+    top = MAX(top, split);
+    maFillRect(x, top - split, w, bottom - top);
+  }
+}
+
+// selects the next band of the ring buffer holding the rows top..bottom.
+// dy moves the rows into the band, which is clipped to the part of the
+// image it covers. returns false after the last band.
+bool GraphicScreen::nextBand(int &band, int top, int bottom, int &dy) {
+  int split = _imageHeight - _imageTop;
+  while (++band < 2) {
+    if (band == 0 && top < split) {
+      // the rows from the top of the ring to the end of the image
+      dy = _imageTop;
+      if (_imageTop) {
+        maSetClipRect(0, _imageTop, _imageWidth, split);
+      }
+      return true;
+    }
+    if (band == 1 && _imageTop && bottom >= split) {
+      // the rows which continue at the start of the image
+      dy = -split;
+      maSetClipRect(0, 0, _imageWidth, _imageTop);
+      return true;
+    }
+  }
+  if (_imageTop) {
+    maSetClipRect(0, 0, _imageWidth, _imageHeight);
+  }
+  return false;
+}
+
+// whether the region in screen coordinates is covered by the overlay
+bool GraphicScreen::overlapsOverlay(const MARect &rect) {
+  List_each(ImageDisplay *, it, _images) {
+    ImageDisplay *image = (*it);
+    if (intersects(rect, image->_x, image->_y - _scrollY, image->_width, image->_height)) {
+      return true;
+    }
+  }
+  List_each(FormInput *, it, _inputs) {
+    FormInput *input = (*it);
+    if (input->isVisible() &&
+        intersects(rect, input->_x, input->_y - _scrollY, input->_width, input->_height)) {
+      return true;
+    }
+  }
+  if (!_shapes.empty()) {
+    return true;
+  }
+  if (!_label.empty()) {
+    int w = _charWidth * (_label.length() + 2);
+    int h = _charHeight + 2;
+    if (intersects(rect, (_width - w) / 2, _height - h, w, h)) {
+      return true;
+    }
+  }
+#if defined(_FLTK)
+  bool menu = true;
+#else
+  bool menu = (!_inputs.empty() || !_label.empty()) && isFullScreen();
+#endif
+  return menu && intersects(rect, _width - _charWidth * 3, _height - _charHeight * 2,
+                          _charWidth * 3, _charHeight * 2);
+}
+
+void GraphicScreen::drawArc(int xc, int yc, double r, double start, double end, double aspect) {
+  int rx = (int)fabs(r) + 2;
+  int ry = (int)fabs(r * aspect) + 2;
+  damage(xc - rx, yc - ry, rx * 2 + 1, ry * 2 + 1);
+  for (int band = -1, dy = 0; nextBand(band, yc - ry, yc + ry, dy);) {
+    maArc(xc, yc + dy, r, start, end, aspect);
+  }
+}
+
+void GraphicScreen::drawBase(bool vscroll, bool update) {
+  MAHandle currentHandle = maSetDrawTarget(HANDLE_SCREEN);
+  _pushed = 0;
+  if (_redraw || vscroll || _scrollY != _drawnScrollY || !drawDamage()) {
+    drawImage(0, _scrollY, _width, _height, _x, _y);
+    drawOverlay(vscroll);
+    _pushed = _width * _height;
+  }
+  _damageCount = 0;
+  _drawnScrollY = _scrollY;
+  _redraw = false;
   _dirty = 0;
   if (update) {
     maUpdateScreen();
@@ -580,8 +791,12 @@ void GraphicScreen::drawBase(bool vscroll, bool update) {
 }
 
 void GraphicScreen::drawEllipse(int xc, int yc, int rx, int ry, int fill) {
-  drawInto();
-  maEllipse(xc, yc, rx, ry, fill);
+  int dx = abs(rx) + 2;
+  int dy = abs(ry) + 2;
+  damage(xc - dx, yc - dy, dx * 2 + 1, dy * 2 + 1);
+  for (int band = -1, offset = 0; nextBand(band, yc - dy, yc + dy, offset);) {
+    maEllipse(xc, yc + offset, rx, ry, fill);
+  }
 }
 
 void GraphicScreen::drawInto(bool background) {
@@ -590,21 +805,25 @@ void GraphicScreen::drawInto(bool background) {
 }
 
 void GraphicScreen::drawLine(int x1, int y1, int x2, int y2) {
-  drawInto();
-  maLine(x1, y1, x2, y2);
+  damage(MIN(x1, x2) - 1, MIN(y1, y2) - 1, abs(x2 - x1) + 3, abs(y2 - y1) + 3);
+  for (int band = -1, dy = 0; nextBand(band, MIN(y1, y2), MAX(y1, y2), dy);) {
+    maLine(x1, y1 + dy, x2, y2 + dy);
+  }
 }
 
 void GraphicScreen::drawRect(int x1, int y1, int x2, int y2) {
-  drawInto();
-  maLine(x1, y1, x2, y1); // top
-  maLine(x1, y2, x2, y2); // bottom
-  maLine(x1, y1, x1, y2); // left
-  maLine(x2, y1, x2, y2); // right
+  damage(MIN(x1, x2) - 1, MIN(y1, y2) - 1, abs(x2 - x1) + 3, abs(y2 - y1) + 3);
+  for (int band = -1, dy = 0; nextBand(band, MIN(y1, y2), MAX(y1, y2), dy);) {
+    maLine(x1, y1 + dy, x2, y1 + dy); // top
+    maLine(x1, y2 + dy, x2, y2 + dy); // bottom
+    maLine(x1, y1 + dy, x1, y2 + dy); // left
+    maLine(x2, y1 + dy, x2, y2 + dy); // right
+  }
 }
 
 void GraphicScreen::drawRectFilled(int x1, int y1, int x2, int y2) {
-  drawInto();
-  maFillRect(x1, y1, x2 - x1, y2 - y1);
+  damage(x1, y1, x2 - x1, y2 - y1);
+  fillRect(x1, y1, x2 - x1, y2 - y1);
 }
 
 // returns the color of the pixel at the given xy location
@@ -623,6 +842,7 @@ int GraphicScreen::getPixel(int x, int y) {
     drawBase(false);
     maGetImageData(HANDLE_SCREEN, &data, &rc, 1);
   } else {
+    rc.top = (y + _imageTop) % _imageHeight;
     maGetImageData(_image, &data, &rc, 1);
   }
   result = -(data[0] & 0x00FFFFFF);
@@ -631,18 +851,9 @@ int GraphicScreen::getPixel(int x, int y) {
 
 // extend the image to allow for additional content on the newline
 void GraphicScreen::imageAppend(MAHandle newImage) {
-  MARect srcRect;
-  MAPoint2d dstPoint;
-
-  srcRect.left = 0;
-  srcRect.top = 0;
-  srcRect.width = _imageWidth;
-  srcRect.height = _imageHeight;
-  dstPoint.x = 0;
-  dstPoint.y = 0;
-
   maSetDrawTarget(newImage);
-  maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  drawImage(0, 0, _imageWidth, _imageHeight, 0, 0);
+  _imageTop = 0;
 
   // clear the new segment
   maSetColor(_bg);
@@ -654,40 +865,18 @@ void GraphicScreen::imageAppend(MAHandle newImage) {
   _image = newImage;
 }
 
-// scroll back the image to allow for additioal content on the newline
+// scroll back the image to allow for additional content on the newline.
+// the top of the ring buffer moves down, the rows which scrolled off are
+// cleared for the new content.
 void GraphicScreen::imageScroll() {
-  MAHandle newImage = maCreatePlaceholder();
-  int newHeight = _imageHeight;
-  if (maCreateDrawableImage(newImage, _imageWidth, newHeight) == RES_OK) {
-    MARect srcRect;
-    MAPoint2d dstPoint;
-    int scrollBack = _height;
-    int copiedHeight = _imageHeight - scrollBack;
-
-    srcRect.left = 0;
-    srcRect.top = scrollBack;
-    srcRect.width = _imageWidth;
-    srcRect.height = copiedHeight;
-    dstPoint.x = 0;
-    dstPoint.y = 0;
-
-    maSetDrawTarget(newImage);
-    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
-
-    // clear the new segment
-    maSetColor(_bg);
-    maFillRect(0, copiedHeight, _imageWidth, scrollBack);
-
-    // cleanup the old image
-    maDestroyPlaceholder(_image);
-    _image = newImage;
-    _scrollY -= scrollBack;
-    _curY -= scrollBack;
-  } else {
-    // unable to create duplicate
-    maDestroyPlaceholder(newImage);
-    clear();
-  }
+  int scrollBack = _height;
+  _imageTop = (_imageTop + scrollBack) % _imageHeight;
+  maSetDrawTarget(_image);
+  maSetColor(_bg);
+  fillRect(0, _imageHeight - scrollBack, _imageWidth, scrollBack);
+  _redraw = true;
+  _scrollY -= scrollBack;
+  _curY -= scrollBack;
 }
 
 // handles the \n character
@@ -727,17 +916,19 @@ int GraphicScreen::print(const char *p, int lineHeight, bool allChars) {
 
   int cx = _curX;
   int numChars = Screen::print(p, lineHeight);
+  damage(cx - _charWidth, _curY, _width, lineHeight);
 
   // erase the background
   maSetColor(_invert ? _fg : _bg);
-  maFillRect(cx, _curY, _curX-cx, lineHeight);
+  fillRect(cx, _curY, _curX-cx, lineHeight);
 
   // draw the text buffer
   maSetColor(_invert ? _bg : _fg);
-  maDrawText(cx, _curY, p, numChars);
-
-  if (_underline) {
-    maLine(cx, _curY + lineHeight - 2, _curX, _curY + lineHeight - 2);
+  for (int band = -1, dy = 0; nextBand(band, _curY, _curY + lineHeight, dy);) {
+    maDrawText(cx, _curY + dy, p, numChars);
+    if (_underline) {
+      maLine(cx, _curY + lineHeight - 2 + dy, _curX, _curY + lineHeight - 2 + dy);
+    }
   }
 
   return numChars;
@@ -761,24 +952,15 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
   bool fullscreen = ((_width - _x) == oldWidth && (_height - _y) == oldHeight);
   if (fullscreen && (newWidth > _imageWidth || newHeight > _imageHeight)) {
     // screen is larger than existing virtual size
-    MARect srcRect;
-    MAPoint2d dstPoint;
     MAHandle newImage = maCreatePlaceholder();
     int newImageWidth = MAX(newWidth, _imageWidth);
     int newImageHeight = MAX(newHeight, _imageHeight);
 
-    srcRect.left = 0;
-    srcRect.top = 0;
-    srcRect.width = MIN(_imageWidth, newImageWidth);
-    srcRect.height = MIN(_imageHeight, newImageHeight);
-    dstPoint.x = 0;
-    dstPoint.y = 0;
-
     if (maCreateDrawableImage(newImage, newImageWidth, newImageHeight) == RES_OK) {
       maSetDrawTarget(newImage);
       maSetColor(_bg);
       maFillRect(0, 0, newImageWidth, newImageHeight);
-      maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+      drawImage(0, 0, _imageWidth, _imageHeight, 0, 0);
       maDestroyPlaceholder(_image);
     } else {
       // cannot resize - alert and abort
@@ -789,6 +971,7 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
     _image = newImage;
     _imageWidth = newImageWidth;
     _imageHeight = newImageHeight;
+    _imageTop = 0;
 
     if (_curY >= _imageHeight) {
       _curY = _height - lineHeight;
@@ -800,6 +983,7 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
   _scrollY = 0;
   _width = newWidth;
   _height = newHeight;
+  _redraw = true;
   if (!fullscreen) {
     drawBase(false);
   }
@@ -814,8 +998,9 @@ void GraphicScreen::updateFont(int size) {
 bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHeight) {
   switch (c) {
   case 'K':
+    damage(_curX, _curY, _width - _curX, lineHeight);
     maSetColor(_bg);            // \e[K - clear to eol
-    maFillRect(_curX, _curY, _width - _curX, lineHeight);
+    fillRect(_curX, _curY, _width - _curX, lineHeight);
     break;
   case 'G':                    // move to column
     _curX = escValue * _charWidth;
@@ -925,9 +1110,11 @@ bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHei
 }
 
 void GraphicScreen::setPixel(int x, int y, int c) {
-  drawInto();
+  damage(x, y, 1, 1);
   maSetColor(ansiToMosync(c));
-  maPlot(x, y);
+  for (int band = -1, dy = 0; nextBand(band, y, y, dy);) {
+    maPlot(x, y + dy);
+  }
 }
 
 struct LineShape : Shape {
@@ -979,6 +1166,7 @@ TextScreen::~TextScreen() {
 void TextScreen::calcTab() {
   Row *line = getLine(_head);  // pointer to current line
   line->tab();
+  setDirty();
 }
 
 bool TextScreen::construct() {
@@ -1139,6 +1327,7 @@ void TextScreen::newLine(int lineHeight) {
 
   _curX = INITXY;
   _curY += lineHeight;
+  setDirty();
 }
 
 void TextScreen::resize(int newWidth, int newHeight, int, int, int) {
@@ -1172,6 +1361,7 @@ int TextScreen::print(const char *p, int lineHeight, bool allChars) {
     _cols = numChars;
   }
 
+  setDirty();
   return numChars;
 }
 
@@ -23,6 +23,7 @@ using namespace strlib;
 #define LINE_SPACING 0
 #define INITXY 2
 #define NO_COLOR -1
+#define MAX_DAMAGE 16
 
 struct Screen : public Shape {
   Screen(int x, int y, int width, int height, int fontSize);
@@ -61,6 +62,7 @@ struct Screen : public Shape {
   FormInput *getNextMenu(FormInput *prev, bool up);
   FormInput *getNextField(FormInput *field);
   void getScroll(int &x, int &y) { x = _scrollX; y = _scrollY; }
+  void invalidate() { _dirty = 1; _redraw = true; }
   void layoutInputs(int newWidth, int newHeight);
   bool overLabel(int px, int py);
   bool overMenu(int px, int py);
@@ -72,7 +74,7 @@ struct Screen : public Shape {
   void replaceFont(int type = FONT_TYPE_MONOSPACE);
   void resetScroll() { _scrollX = 0; _scrollY = 0; }
   void setColor(long color);
-  void setDirty() { if (!_dirty) { _dirty = maGetMilliSecondCount(); } }
+  void setDirty() { if (!_dirty) { _dirty = maGetMilliSecondCount(); } _redraw = true; }
   void setFont(bool bold, bool italic, int size);
   void selectFont() { if (_font != -1) maFontSetCurrent(_font); }
   void setScroll(int x, int y) { _scrollX = x; _scrollY = y; }
@@ -91,6 +93,8 @@ struct Screen : public Shape {
   int _curY;
   int _dirty;
   int _linePadding;
+  int _pushed;       // pixels copied to the screen by the last drawBase()
+  bool _redraw;      // the next drawBase() copies the whole screen
   String _label;
   strlib::List<Shape *> _shapes;
   strlib::List<FormInput *> _inputs;
@@ -134,6 +138,19 @@ struct GraphicScreen : public Screen {
   int _curYSaved;
   int _curXSaved;
   int _tabSize;
+
+private:
+  void damage(int x, int y, int w, int h);
+  bool drawDamage();
+  void drawImage(int x, int y, int w, int h, int dstX, int dstY);
+  void fillRect(int x, int y, int w, int h);
+  bool nextBand(int &band, int top, int bottom, int &dy);
+  bool overlapsOverlay(const MARect &rect);
+
+  MARect _damage[MAX_DAMAGE]; // changed regions of the image since the last drawBase()
+  int _damageCount;
+  int _drawnScrollY;          // scroll position of the last drawBase()
+  int _imageTop;              // the image row holding the top of the ring buffer
 };
 
 struct TextSeg {
@@ -152,6 +152,10 @@ bool System::execute(const char *bas) {
   opt_usepcre = 0;
   opt_autolocal = 0;
 
+  // read the clock at least every 64 commands, a quarter of the console
+  // ceiling, so that input and redraws are not held up by a long budget
+  opt_event_budget = 64;
+
   _state = kRunState;
   setWindowTitle(bas);
   showCursor(kArrow);
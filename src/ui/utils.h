@@ -44,6 +44,42 @@
 #define logLeaving() trace("%s leaving (%s %d)", \
                            __FUNCTION__, __FILE__, __LINE__);
 
+// decodes the UTF-8 character at str into code and returns its length in bytes,
+// a byte which does not begin a valid sequence is read as a latin-1 character
+inline int utf8_decode(const char *str, int len, unsigned &code) {
+  const unsigned char *s = (const unsigned char *)str;
+  int n;
+  unsigned min;
+  code = s[0];
+  if (code < 0xc2 || code > 0xf4) {
+    return 1;
+  } else if (code < 0xe0) {
+    n = 2;
+    min = 0x80;
+  } else if (code < 0xf0) {
+    n = 3;
+    min = 0x800;
+  } else {
+    n = 4;
+    min = 0x10000;
+  }
+  if (n > len) {
+    return 1;
+  }
+  unsigned result = code & (0x7f >> n);
+  for (int i = 1; i < n; i++) {
+    if ((s[i] & 0xc0) != 0x80) {
+      return 1;
+    }
+    result = (result << 6) | (s[i] & 0x3f);
+  }
+  if (result < min || result > 0x10ffff || (result >= 0xd800 && result <= 0xdfff)) {
+    return 1;
+  }
+  code = result;
+  return n;
+}
+
 #define C_LINKAGE_BEGIN extern "C" {
 #define C_LINKAGE_END }
 